@@ -23,35 +23,47 @@ def extract_weights(checkpoint_path, output_path):
     
     print(f"Found {len(state_dict)} parameters")
     
-    # Binary 파일로 저장
-    with open(output_path, 'wb') as f:
-        # 매직 넘버와 버전 정보
-        f.write(b'LCNN')  # Magic number
-        f.write(struct.pack('I', 1))  # Version
+    # LCNN v2: 헤더 + 목차(TOC) + 64바이트 정렬된 float32 데이터 (mmap 로딩용)
+    ALIGN = 64
+    entries = []
+    for name, param in state_dict.items():
+        print(f"  {name}: {param.shape}")
         
-        # 파라미터 개수
-        f.write(struct.pack('I', len(state_dict)))
+        # 파라미터 이름 (최대 256 bytes)
+        name_bytes = name.encode('utf-8')[:256]
+        # 텐서 데이터 (C-contiguous, little-endian float32)
+        data = np.ascontiguousarray(param.cpu().numpy(), dtype='<f4')
+        entries.append((name_bytes, data))
+    
+    def align(x):
+        return (x + ALIGN - 1) // ALIGN * ALIGN
+    
+    toc_size = sum(4 + len(n) + 4 + 4 * d.ndim + 16 for n, d in entries)
+    offsets = []
+    offset = align(24 + toc_size)
+    for _, data in entries:
+        offsets.append(offset)
+        offset = align(offset + data.nbytes)
+    
+    with open(output_path, 'wb') as f:
+        # 매직 넘버, 버전, 개수, 정렬, TOC 크기
+        f.write(b'LCNN')
+        f.write(struct.pack('<III', 2, len(entries), ALIGN))
+        f.write(struct.pack('<Q', toc_size))
         
-        for name, param in state_dict.items():
-            print(f"  {name}: {param.shape}")
-            
-            # 파라미터 이름 (최대 256 bytes)
-            name_bytes = name.encode('utf-8')[:256]
-            f.write(struct.pack('I', len(name_bytes)))
+        # TOC: 이름, shape, 데이터 오프셋, 원소 개수
+        for (name_bytes, data), off in zip(entries, offsets):
+            f.write(struct.pack('<I', len(name_bytes)))
             f.write(name_bytes)
-            
-            # 텐서 데이터
-            data = param.cpu().numpy().astype(np.float32)
-            
-            # Shape 정보
-            ndim = len(data.shape)
-            f.write(struct.pack('I', ndim))
+            f.write(struct.pack('<I', data.ndim))
             for dim in data.shape:
-                f.write(struct.pack('I', dim))
-            
-            # 데이터 (C-contiguous order)
-            data_flat = data.flatten('C')
-            f.write(struct.pack(f'{len(data_flat)}f', *data_flat))
+                f.write(struct.pack('<I', dim))
+            f.write(struct.pack('<QQ', off, data.size))
+        
+        # 데이터 (각각 64바이트 경계에서 시작)
+        for (_, data), off in zip(entries, offsets):
+            f.write(b'\0' * (off - f.tell()))
+            f.write(data.tobytes())
     
     print(f"\nWeights saved to: {output_path}")
     print(f"File size: {Path(output_path).stat().st_size / 1024 / 1024:.2f} MB")
@@ -0,0 +1,106 @@
+#pragma once
+#include "model.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct BatchOptions {
+    // Largest batch handed to one forward(); 1 disables batching
+    int max_batch = 8;
+    // How long the oldest queued request may wait for others to join
+    int max_wait_us = 2000;
+    // Threads forming and running batches
+    int workers = 1;
+};
+
+// Where a batched request spent its time inside predict()
+struct BatchTimings {
+    std::chrono::nanoseconds queue{0};   // waiting for the batch to form
+    std::chrono::nanoseconds forward{0}; // the batch's forward()
+    int batch_size = 0;
+};
+
+// Dynamic micro-batching
+//
+// Request threads queue single-image inputs and block until their logits
+// are ready. Workers take the queue as soon as it holds max_batch requests
+// or its oldest request has waited max_wait_us, stack the inputs into one
+// [N, C, H, W] tensor, run a single forward() and scatter the rows back.
+//
+// Inputs can also be given as a writer. It runs on the request's own
+// thread into a reused per-thread buffer, so concurrent requests preprocess
+// in parallel (and while the previous batch runs); the worker only copies
+// each finished sample into its slot of the batch tensor.
+//
+// The model can be replaced while requests run (set_model). Each request
+// keeps the model that was current when it arrived, batches never mix
+// models, and a replaced model is freed with the last request using it.
+class Batcher {
+public:
+    Batcher(std::shared_ptr<const LiteCNNPro> model, const BatchOptions& options);
+    ~Batcher();
+
+    Batcher(const Batcher&) = delete;
+    Batcher& operator=(const Batcher&) = delete;
+
+    // Fills one [C, H, W] sample at slot
+    using InputWriter = std::function<void(float* slot)>;
+
+    // input: [1, C, H, W]; returns its logits (rethrows model errors)
+    std::vector<float> predict(const Tensor& input);
+    // shape: [1, C, H, W]; write runs on the calling thread before the
+    // request is queued, and any exception it throws propagates from here
+    // trace: receives the queue wait, the batch's forward() and its
+    // per-layer spans (see ExecutionContext::set_trace)
+    std::vector<float> predict(const std::vector<int>& shape, const InputWriter& write,
+                               BatchTimings* timings = nullptr, trace::Recorder* trace = nullptr);
+    // A ready [1, C, H, W] sample, read by the worker while predict() blocks
+    std::vector<float> predict(const std::vector<int>& shape, const float* sample,
+                               BatchTimings* timings = nullptr, trace::Recorder* trace = nullptr);
+
+    // Requests waiting for a worker
+    size_t queue_depth();
+
+    // Requests arriving from now on run on `model`
+    void set_model(std::shared_ptr<const LiteCNNPro> model);
+    std::shared_ptr<const LiteCNNPro> model() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Request {
+        std::shared_ptr<const LiteCNNPro> model;
+        const std::vector<int>* shape;
+        const float* sample;
+        Clock::time_point arrival;
+        BatchTimings* timings;
+        trace::Recorder* trace;
+        std::promise<std::vector<float>> result;
+    };
+
+    // Read and replaced with std::atomic_load / atomic_store
+    std::shared_ptr<const LiteCNNPro> model_;
+    BatchOptions options_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Request*> queue_;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+
+    // max_batch == 1: runs the request on the calling thread
+    std::vector<float> run_inline(const std::vector<int>& shape, const InputWriter& write,
+                                  BatchTimings* timings, trace::Recorder* trace);
+    void worker_loop();
+    // Requests of the same model and input shape as the queue head, up to
+    // max_batch
+    std::vector<Request*> take_batch();
+    void run_batch(const std::vector<Request*>& batch, Tensor& input, Tensor& output,
+                   ExecutionContext& context);
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include "model.h"
+#include "server.h"
+#include <map>
+#include <string>
+
+struct BulkOptions {
+    std::string dir;      // classified recursively
+    std::string out_path; // JSON lines; also the checkpoint
+    int top_k = 5;
+    // Largest batch of preprocessed images per forward()
+    int max_batch = 8;
+    // Threads per stage; 0 picks a default from the hardware thread count
+    int read_threads = 2;
+    int decode_threads = 0;
+    int forward_threads = 0;
+};
+
+// Offline classification of a whole directory tree
+//
+// file read -> decode + resize/normalize -> batched forward() -> writer,
+// each stage with its own threads, joined by bounded queues so a slow
+// stage holds the others back instead of buffering the archive in memory.
+// Every file becomes one line of out_path:
+//   {"file": "<path relative to dir>", "predictions": [...]}   (as /predict)
+//   {"file": "...", "error": "..."}                            (unreadable)
+// Lines are flushed at least once a second. On restart, files with
+// predictions in out_path are skipped, while error lines and a torn last
+// line are removed and those files redone, so an interrupted run resumes
+// where it stopped and transient failures are retried. Returns the process
+// exit code.
+int classify_directory(const LiteCNNPro& model, const std::map<int, BreedInfo>& breeds,
+                       const BulkOptions& options);
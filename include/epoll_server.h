@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace httplib {
+struct Request;
+struct Response;
+}
+
+struct EpollOptions {
+    // Event loops, each with its own SO_REUSEPORT listener and epoll set
+    int io_threads = 2;
+    // Threads running handlers; they block in inference, so as many as
+    // requests that should be in flight at once (0: httplib's pool size)
+    int workers = 0;
+    // Parsed requests waiting for a worker; beyond this new ones get 503
+    size_t queue_capacity = 4096;
+    size_t max_header_bytes = 16 << 10;
+    size_t max_body_bytes = 64 << 20;
+    // Idle keep-alive connections and stalled uploads are closed after this
+    int idle_timeout_s = 60;
+};
+
+// Event-driven HTTP/1.1 front-end (Linux epoll)
+//
+// A few I/O threads own all sockets: they accept, read whatever has
+// arrived, parse headers and bodies incrementally into buffers taken from
+// a per-thread pool, and write responses, never blocking on a client. A
+// complete request goes through a lock-free queue to the worker threads,
+// which run the handler and post the response back to the connection's
+// I/O thread (eventfd wake-up). A connection costs a socket and a small
+// struct, not a thread, so slow uploads and idle keep-alive clients do not
+// hold inference capacity.
+//
+// Requests are handed over as httplib::Request (method, path, params,
+// headers, body, multipart form parsed on the worker; start_time_ is the
+// arrival of the first byte), so the handlers of the httplib front-end run
+// unchanged. Bodies need Content-Length (no chunked uploads); one request
+// per connection is in flight at a time and pipelined ones wait for it.
+class EpollServer {
+public:
+    using Handler = std::function<void(const httplib::Request&, httplib::Response&)>;
+
+    EpollServer(const EpollOptions& options, Handler handler);
+    ~EpollServer();
+
+    EpollServer(const EpollServer&) = delete;
+    EpollServer& operator=(const EpollServer&) = delete;
+
+    // Binds, then serves until stop(); throws if the port cannot be bound
+    void listen(const std::string& host, int port);
+    void stop();
+
+private:
+    struct Loop;
+    struct Shared;
+    struct Pending;
+
+    EpollOptions options_;
+    Handler handler_;
+    std::unique_ptr<Shared> shared_;
+    std::vector<std::unique_ptr<Loop>> loops_;
+    std::vector<std::thread> workers_;
+
+    void worker_loop();
+};
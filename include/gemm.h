@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Cache-blocked, register-tiled SGEMM
+//
+//   C[M x N] = A[M x K] * B[K x N]   (C += ... when accumulate is set)
+//
+// All matrices are row-major with explicit leading dimensions.
+// A is the weight operand: it is packed once into MR-row panels per
+// KC-deep block so the micro-kernel streams it with unit stride.
+
+namespace gemm {
+
+// Register tile of the micro-kernel
+constexpr int kMR = 6;
+int kernel_nr();
+// Depth of the K blocks A is packed in
+constexpr int kKC = 256;
+
+// Weight matrix packed into MR x KC panels
+class PackedMatrix {
+public:
+    PackedMatrix() = default;
+    PackedMatrix(const float* a, int rows, int cols, int lda);
+
+    // Panels packed earlier with this kMR / kKC (see packed_size), e.g.
+    // mapped from a compiled plan artifact; `storage` keeps them alive
+    static PackedMatrix view_of(const float* panels, int rows, int cols,
+                                std::shared_ptr<const void> storage);
+    static size_t packed_size(int rows, int cols);
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    bool empty() const { return rows_ == 0; }
+
+    const float* data() const { return view_ ? view_ : data_.data(); }
+    size_t size() const { return packed_size(rows_, cols_); }
+
+    // Panel holding rows [row, row + MR) of the K block starting at k0
+    const float* panel(int k0, int row) const;
+
+private:
+    int rows_ = 0;
+    int cols_ = 0;
+    int padded_rows_ = 0;
+    std::vector<float> data_;
+    const float* view_ = nullptr;
+    std::shared_ptr<const void> storage_;
+};
+
+// Applied to C after the last K block: per-row bias, then optional ReLU6.
+// Rows of C are output channels for convolutions, so this fuses the
+// folded BatchNorm shift and activation into the GEMM store.
+struct Epilogue {
+    const float* bias = nullptr;
+    bool relu6 = false;
+};
+
+void sgemm(int M, int N, int K,
+           const float* A, int lda,
+           const float* B, int ldb,
+           float* C, int ldc, bool accumulate = false);
+
+void sgemm_packed(const PackedMatrix& A, int N,
+                  const float* B, int ldb,
+                  float* C, int ldc, bool accumulate = false,
+                  const Epilogue* epilogue = nullptr);
+
+} // namespace gemm
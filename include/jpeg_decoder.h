@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Baseline JPEG decoding with DCT-domain downscaling
+//
+// Only the low-frequency corner of each 8x8 coefficient block is inverse
+// transformed: a 4x4, 2x2 or 1x1 IDCT yields the block at 1/2, 1/4 or 1/8
+// resolution directly, so a phone photo is never materialized at full
+// size. Entropy decoding still visits every coefficient.
+namespace jpeg {
+
+struct Header {
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    // Sequential Huffman coded, 8-bit samples, 1 or 3 components:
+    // the streams decode() handles
+    bool supported = false;
+};
+
+struct Image {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> rgb; // interleaved, width * height * 3
+};
+
+// Parses the markers up to the frame header without touching the
+// entropy-coded data; false if the data is not a JPEG
+bool read_header(const uint8_t* data, size_t size, Header& header);
+
+// Largest reduction (1, 2, 4 or 8) that keeps both sides >= min_side
+int scale_for(const Header& header, int min_side);
+
+// Size of the image decode() produces for `scale`
+inline int scaled_size(int size, int scale) {
+    return (size + scale - 1) / scale;
+}
+
+// Decodes a supported stream reduced by `scale` (1, 2, 4 or 8). Returns
+// false for unsupported or corrupt streams so the caller can fall back to
+// a general decoder. Chroma is upsampled by replication and scale 1 uses a
+// plain separable IDCT, so full-size decodes are better left to stb_image.
+bool decode(const uint8_t* data, size_t size, int scale, Image& image);
+
+} // namespace jpeg
@@ -1,12 +1,161 @@
 #pragma once
 #include "tensor.h"
+#include "gemm.h"
+#include "simd.h"
 #include <cmath>
+#include <cstdint>
 #include <algorithm>
+#include <vector>
+
+// Output extent of a conv / pooling window along one axis
+inline int conv_out_size(int in, int kernel, int stride, int padding) {
+    return (in + 2 * padding - kernel) / stride + 1;
+}
 
 // Conv2D operation
 Tensor conv2d(const Tensor& input, const Tensor& weight, 
               int stride = 1, int padding = 0, int groups = 1);
 
+// Dense conv (groups == 1) with pre-packed [C_out, C_in * kH * kW] weights.
+// bias / relu6 are fused into the GEMM store.
+Tensor conv2d_packed(const Tensor& input, const gemm::PackedMatrix& weight,
+                     int kH, int kW, int stride, int padding,
+                     const float* bias = nullptr, bool relu6 = false);
+
+// Depthwise 3x3 conv with padding 1 (stride 1 or 2), optional fused bias / ReLU6
+Tensor depthwise_conv3x3(const Tensor& input, const Tensor& weight, int stride,
+                         const float* bias = nullptr, bool relu6 = false);
+
+// Raw-buffer kernels used by the compiled plan. They write into caller
+// provided memory and never allocate; the Tensor versions above wrap them.
+
+// col: im2col scratch of conv2d_col_size() floats (unused for direct 1x1)
+void conv2d_packed_into(const float* input, int N, int C_in, int H_in, int W_in,
+                        const gemm::PackedMatrix& weight, int kH, int kW,
+                        int stride, int padding, const float* bias, bool relu6,
+                        float* output, float* col);
+size_t conv2d_col_size(int C_in, int H_in, int W_in, int kH, int kW,
+                       int stride, int padding);
+
+void grouped_conv2d_into(const float* input, int N, int C_in, int H_in, int W_in,
+                         const Tensor& weight, int stride, int padding, int groups,
+                         float* output);
+
+void depthwise_conv3x3_into(const float* input, int N, int C, int H, int W,
+                            const float* weight, int stride,
+                            const float* bias, bool relu6, float* output);
+
+// [N, C, HW] -> [N, C]
+void global_avg_pool_into(const float* input, int N, int C, int HW, float* output);
+
+void linear_into(const float* input, int N, int in_features,
+                 const Tensor& weight, const float* bias, bool relu6, float* output);
+// Weight [out_features, in_features] stored as float, simd::fp16 or simd::bf16
+template <class T>
+void linear_into(const float* input, int N, int in_features, const T* weight,
+                 int out_features, const float* bias, bool relu6, float* output);
+
+// scratch: se_block_scratch_size() floats
+void se_block_inplace(float* x, int N, int C, int HW,
+                      const Tensor& fc1_weight, const Tensor& fc2_weight, float* scratch);
+size_t se_block_scratch_size(int N, int C, const Tensor& fc1_weight);
+
+// NCHWc kernels (see Layout::NCHWc). Activations are [N][C / B][H][W][B]
+// with B = kChannelBlock; weights are packed with the helpers below.
+// Activations and weights are stored as T = float, simd::fp16 or simd::bf16
+// (explicitly instantiated in layers_nchwc.cpp); bias, pooled vectors and
+// accumulation are always float.
+
+// Channel block: one AVX-512 vector, or 8 channels on narrower ISAs
+constexpr int kChannelBlock = simd::kWidth >= 16 ? 16 : 8;
+
+// Weight packers take the block so an ahead-of-time compile can target
+// another ISA (see LiteCNNPro::set_channel_block)
+// [C_out, C_in, 1, 1] -> [C_out / B][C_in_pad][B]
+Tensor pack_pointwise_weight_nchwc(const Tensor& weight, int block = kChannelBlock);
+// [C, 1, k, k] -> [C / B][k * k][B]
+Tensor pack_depthwise_weight_nchwc(const Tensor& weight, int block = kChannelBlock);
+// 1-D per-channel vector zero-padded to a multiple of block
+Tensor pad_channels(const Tensor& vec, int block);
+
+// Converts float values (e.g. packed weights) to a storage type
+template <class T>
+inline void convert_storage(const float* src, size_t count, T* dst) {
+    for (size_t i = 0; i < count; ++i) dst[i] = simd::from_float<T>(src[i]);
+}
+
+// Float NCHW -> NCHWc in storage type T, block kChannelBlock
+template <class T>
+void nchw_to_nchwc_into(const float* src, int N, int C, int HW, T* dst);
+
+template <class T>
+void depthwise_conv_nchwc_into(const T* input, int N, int C, int H, int W,
+                               const T* weight, int kernel, int stride, int padding,
+                               const float* bias, bool relu6, T* output);
+
+template <class T>
+void pointwise_conv_nchwc_into(const T* input, int N, int C_in, int C_out, int HW,
+                               const T* weight, const float* bias, bool relu6,
+                               T* output);
+
+// Pools straight out of the blocked layout into a plain [N, C] vector
+template <class T>
+void global_avg_pool_nchwc_into(const T* input, int N, int C, int HW, float* output);
+
+template <class T>
+void se_block_nchwc_inplace(T* x, int N, int C, int HW,
+                            const Tensor& fc1_weight, const Tensor& fc2_weight, float* scratch);
+size_t se_block_nchwc_scratch_size(int N, int C, const Tensor& fc1_weight);
+// Squeeze + excitation only: returns the sigmoid gates as [N][C_pad] inside
+// scratch (zero in the padded channels)
+template <class T>
+const float* se_block_nchwc_gates(const T* x, int N, int C, int HW,
+                                  const Tensor& fc1_weight, const Tensor& fc2_weight,
+                                  float* scratch);
+
+// INT8 kernels (src/layers_int8.cpp). Activations are u8 in the NCHWc
+// layout with one scale per tensor and no zero point (they all follow
+// ReLU6); weights are s8 with one symmetric scale per output channel.
+// requant[c] = input_scale * weight_scale[c] maps int32 sums back to float.
+
+// Symmetric per-row quantization of a [rows, cols] matrix
+void quantize_per_channel(const float* weight, int rows, int cols,
+                          std::vector<int8_t>& q, std::vector<float>& scales);
+// [C_out, C_in] -> [C_out / B][C_in_pad / 4][B][4]
+std::vector<int8_t> pack_pointwise_weight_nchwc_s8(const int8_t* q, int C_out, int C_in,
+                                                   int block = kChannelBlock);
+// [C, taps] -> [C / B][taps][B]
+std::vector<int8_t> pack_depthwise_weight_nchwc_s8(const int8_t* q, int C, int taps,
+                                                   int block = kChannelBlock);
+
+void quantize_nchw_to_nchwc_u8(const float* src, int N, int C, int HW,
+                               float inv_scale, uint8_t* dst);
+
+// u8 in, u8 out (next layer is an INT8 pointwise conv); 3x3 only
+void depthwise_conv_nchwc_u8_into(const uint8_t* input, int N, int C, int H, int W,
+                                  const int8_t* weight, int kernel, int stride, int padding,
+                                  const float* requant, const float* bias, bool relu6,
+                                  float out_inv_scale, uint8_t* output);
+
+// u8 in, float out
+void pointwise_conv_nchwc_u8_into(const uint8_t* input, int N, int C_in, int C_out, int HW,
+                                  const int8_t* weight, const float* requant,
+                                  const float* bias, bool relu6, float* output);
+
+// SE on float activations whose scaled output is written as u8 for an
+// INT8 consumer (out_inv_scale = 1 / consumer input scale)
+void se_block_nchwc_quantize(const float* x, int N, int C, int HW,
+                             const Tensor& fc1_weight, const Tensor& fc2_weight,
+                             float* scratch, float out_inv_scale, uint8_t* output);
+
+// Float [N, in_features] in, quantized to u8 in scratch, float out; runs
+// the pointwise kernel with the batch rows as pixels. weight is packed
+// like a pointwise conv's, requant padded to the channel block
+size_t linear_u8_scratch_size(int N, int in_features, int out_features);
+void linear_u8_into(const float* input, int N, int in_features, const int8_t* weight,
+                    int out_features, float input_scale, const float* requant,
+                    const float* bias, bool relu6, float* output, float* scratch);
+
 // BatchNorm2D
 Tensor batchnorm2d(const Tensor& input, const Tensor& weight, 
                    const Tensor& bias, const Tensor& running_mean, 
@@ -25,6 +174,9 @@ Tensor adaptive_avg_pool2d(const Tensor& input, int output_h, int output_w);
 // Linear (fully connected)
 Tensor linear(const Tensor& input, const Tensor& weight, const Tensor* bias = nullptr);
 
+// Squeeze-Excitation block (fc weights without bias)
+Tensor se_block(const Tensor& x, const Tensor& fc1_weight, const Tensor& fc2_weight);
+
 // Sigmoid
 inline void sigmoid_inplace(Tensor& x) {
     for (auto& v : x.data) {
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Client for the server's Unix domain socket (--unix-socket), for colocated
+// callers that want predictions without HTTP. One connection, reused for
+// every call; not thread-safe, use one client per thread. Link
+// litecnn_client.
+//
+//   LiteCNNClient client("/run/litecnn.sock");
+//   for (const Prediction& p : client.classify(jpeg.data(), jpeg.size())) ...
+struct Prediction {
+    int class_id;
+    float score; // softmax over the returned top_k, as in /predict
+};
+
+class LiteCNNClient {
+public:
+    // Connects; throws std::runtime_error if the socket is not there
+    explicit LiteCNNClient(const std::string& socket_path);
+    ~LiteCNNClient();
+
+    LiteCNNClient(const LiteCNNClient&) = delete;
+    LiteCNNClient& operator=(const LiteCNNClient&) = delete;
+
+    // Top-k classes of an encoded image (JPEG or anything /predict takes),
+    // best first. Throws std::runtime_error with the server's message if it
+    // rejects the image, or if the connection fails (the client is then
+    // unusable)
+    std::vector<Prediction> classify(const void* image, size_t size, int top_k = 5);
+
+private:
+    int fd_ = -1;
+};
+
+namespace shm_protocol {
+struct Header;
+}
+
+// Producer side of the shared-memory interface (--shm NAME, Linux), for
+// same-host sources such as frame grabbers. Frames are written straight
+// into a slot of the server's region, so pixel data is never copied through
+// the kernel. Safe to use from several threads and processes at once; each
+// slot is owned by one caller from acquire() to wait().
+//
+//   LiteCNNShmClient shm("/litecnn");
+//   int slot = shm.acquire();
+//   grab_frame_rgb(shm.input(slot));                // 224x224x3 uint8
+//   shm.submit(slot, LiteCNNShmClient::RGB8);
+//   std::vector<Prediction> top = shm.wait(slot);   // frees the slot
+class LiteCNNShmClient {
+public:
+    enum InputType {
+        RGB8 = 0,    // 224x224x3 interleaved uint8 (150,528 bytes)
+        Float32 = 1, // normalized NCHW [1, 3, 224, 224] (602,112 bytes)
+    };
+
+    // Maps the region; throws std::runtime_error if the server has not
+    // created it
+    explicit LiteCNNShmClient(const std::string& name);
+    ~LiteCNNShmClient();
+
+    LiteCNNShmClient(const LiteCNNShmClient&) = delete;
+    LiteCNNShmClient& operator=(const LiteCNNShmClient&) = delete;
+
+    // Claims a free slot, waiting while all are in use
+    int acquire();
+    // Where to write the input of a claimed slot
+    void* input(int slot);
+    // Hands the slot to the server; top_k at most 32
+    void submit(int slot, InputType type, int top_k = 5);
+    // Blocks until the result is in, then frees the slot. Throws
+    // std::runtime_error with the server's message if it rejected the input,
+    // or if the server shut down
+    std::vector<Prediction> wait(int slot);
+
+    // acquire + copy + submit + wait, for inputs that already live elsewhere
+    std::vector<Prediction> classify(const void* data, InputType type, int top_k = 5);
+
+private:
+    shm_protocol::Header* header_ = nullptr;
+    size_t size_ = 0;
+    uint32_t slot_count_ = 0; // as mapped; other producers can write the header
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Static activation memory planner
+//
+// Every intermediate buffer is described by its size and the range of plan
+// steps during which it is live. plan() assigns each buffer an offset in a
+// single arena so that buffers with overlapping lifetimes never overlap in
+// memory, which for a sequential network degenerates into ping-pong buffers.
+class MemoryPlanner {
+public:
+    // Offsets are aligned to this many floats (64 bytes)
+    static constexpr size_t kAlignment = 16;
+
+    // Registers a buffer of `size` floats live during steps
+    // [first_use, last_use]; returns its id
+    int add(size_t size, int first_use, int last_use);
+
+    // Assigns offsets (greedy by size) and returns the arena size in floats
+    size_t plan();
+
+    size_t offset(int id) const { return buffers_[id].offset; }
+    size_t arena_size() const { return arena_size_; }
+
+private:
+    struct Buffer {
+        size_t size;
+        int first_use;
+        int last_use;
+        size_t offset;
+    };
+
+    std::vector<Buffer> buffers_;
+    size_t arena_size_ = 0;
+};
+
+// Arena memory with 64-byte aligned base
+class Arena {
+public:
+    // Grows the arena to at least `floats`; never shrinks
+    void reserve(size_t floats);
+    float* data() { return base_; }
+    size_t capacity() const { return capacity_; }
+
+private:
+    std::vector<float> storage_;
+    float* base_ = nullptr;
+    size_t capacity_ = 0;
+};
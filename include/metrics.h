@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Server telemetry in the Prometheus text format
+namespace metrics {
+
+// Latency histogram with fixed exponential buckets: le = 1 us * 2^i for
+// i < kBuckets, plus +Inf. Every thread records into its own shard with
+// plain relaxed stores (one writer per shard, no locks, no contended cache
+// lines); a scrape sums the shards. Shards live as long as the histogram.
+class Histogram {
+public:
+    static constexpr int kBuckets = 25; // 1 us .. ~16.8 s
+
+    struct Snapshot {
+        uint64_t buckets[kBuckets + 1] = {}; // per bucket, not cumulative; last is +Inf
+        uint64_t sum_ns = 0;
+    };
+
+    Histogram();
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+    void observe(std::chrono::nanoseconds duration);
+    Snapshot snapshot() const;
+
+    // Upper bound of bucket i in seconds
+    static double bound(int i);
+
+private:
+    struct Shard {
+        std::atomic<uint64_t> buckets[kBuckets + 1] = {};
+        std::atomic<uint64_t> sum_ns{0};
+    };
+
+    // Index of this histogram in every thread's shard table; never reused
+    size_t id_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    Shard& local();
+};
+
+// Measures from construction to destruction into a histogram
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { histogram_.observe(std::chrono::steady_clock::now() - start_); }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Histogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Text exposition helpers; each writes the # HELP / # TYPE header too
+void write_counter(std::string& out, const std::string& name, const std::string& help, double value);
+void write_gauge(std::string& out, const std::string& name, const std::string& help, double value);
+// One histogram family with a label distinguishing its series
+void write_histograms(std::string& out, const std::string& name, const std::string& help,
+                      const std::string& label,
+                      const std::vector<std::pair<std::string, const Histogram*>>& series);
+
+// Resident set size of this process in bytes, 0 if unavailable
+size_t resident_memory_bytes();
+
+} // namespace metrics
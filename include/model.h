@@ -1,27 +1,280 @@
 #pragma once
 #include "tensor.h"
 #include "layers.h"
+#include "gemm.h"
+#include "memory_planner.h"
+#include "trace.h"
+#include <atomic>
 #include <map>
+#include <memory>
+#include <cstdint>
 #include <string>
+#include <vector>
+
+// One step of the compiled execution plan.
+// Activations between steps use the blocked NCHWc layout: the stem reads
+// the NCHW input and emits NCHWc, global pooling reads NCHWc and emits a
+// plain [N, C] vector for the classifier.
+enum class OpType {
+    Conv,          // dense conv via GEMM (stem), BN folded in, NCHW -> NCHWc
+    PointwiseConv, // 1x1 conv in NCHWc, BN folded in
+    DepthwiseConv, // depthwise conv in NCHWc, BN folded in
+    SqueezeExcite,
+    GlobalAvgPool,
+    Linear
+};
+
+// Arithmetic used by the compiled plan.
+// FP16 / BF16 store conv and classifier weights and all NCHWc activations in
+// 16 bits and compute in float. INT8 runs the depthwise, pointwise and
+// classifier layers on u8 x s8 integer kernels using the calibrated
+// activation scales stored with the weights (see LiteCNNPro::calibrate).
+enum class Precision {
+    FP32,
+    FP16,
+    BF16,
+    INT8
+};
+
+inline const char* precision_name(Precision precision) {
+    switch (precision) {
+    case Precision::FP16: return "fp16";
+    case Precision::BF16: return "bf16";
+    case Precision::INT8: return "int8";
+    default: return "fp32";
+    }
+}
+
+// Packed weights of a plan step: owned when compile() made them, or a
+// read-only view into a mapped LCNP artifact that holds the mapping alive
+template <class T>
+class PlanWeights {
+public:
+    PlanWeights() = default;
+    PlanWeights(std::vector<T> owned) : owned_(std::move(owned)) {}
+
+    static PlanWeights view_of(const T* data, size_t size, std::shared_ptr<const void> storage) {
+        PlanWeights w;
+        w.view_ = data;
+        w.view_size_ = size;
+        w.storage_ = std::move(storage);
+        return w;
+    }
+
+    const T* data() const { return view_ ? view_ : owned_.data(); }
+    size_t size() const { return view_ ? view_size_ : owned_.size(); }
+    bool empty() const { return size() == 0; }
+
+private:
+    std::vector<T> owned_;
+    const T* view_ = nullptr;
+    size_t view_size_ = 0;
+    std::shared_ptr<const void> storage_;
+};
+
+struct PlanStep {
+    OpType op;
+    std::string name;
+    int stride = 1;
+    int padding = 0;
+    int kernel_h = 1;
+    int kernel_w = 1;
+    int out_channels = 0;
+    bool relu6 = false;
+
+    // Conv steps own their BN-folded parameters, packed for their kernel;
+    // bias is zero-padded to a multiple of kChannelBlock
+    Tensor weight;
+    Tensor bias;
+    gemm::PackedMatrix packed;
+
+    // SE / Linear steps point straight into the loaded weights
+    const Tensor* fc1 = nullptr;
+    const Tensor* fc2 = nullptr;
+    const Tensor* linear_weight = nullptr;
+    const Tensor* linear_bias = nullptr;
+
+    // FP16 / BF16 plans: packed conv or linear weights (simd::fp16 / bf16 bits)
+    PlanWeights<uint16_t> weight16;
+
+    // INT8 steps: s8 weights packed for the u8 kernels and per-channel
+    // requantization factors (input scale * weight scale, padded)
+    PlanWeights<int8_t> qweight;
+    Tensor requant;
+    float input_scale = 0.0f;  // > 0: consumes u8 activations (Linear quantizes its own input)
+    float output_scale = 0.0f; // > 0: emits u8 activations for an INT8 consumer
+};
+
+// Shapes (logical channel counts) and arena offsets of one plan step
+// for a given input shape
+struct StepIO {
+    int in_c = 0, in_h = 0, in_w = 0;
+    int out_c = 0, out_h = 0, out_w = 0;
+    size_t input = 0;   // arena offset (unused for the first step)
+    size_t output = 0;  // arena offset (same as input for in-place steps)
+    size_t scratch = 0; // arena offset of step-local scratch
+};
+
+// Activation memory planned for one input shape.
+// Re-planned only when the input shape changes, so steady-state
+// inference runs without heap allocations.
+struct Workspace {
+    int batch = 0;
+    int channels = 0;
+    int height = 0;
+    int width = 0;
+    std::vector<StepIO> io;
+    Arena arena;
+};
+
+// Per-request mutable state of an inference: the activation memory planned
+// for the last model plan and input shape. Cheap to create (memory is
+// allocated on first use) and meant to be reused; it re-plans itself when
+// used with another plan or input shape. One context must not be used by
+// two threads at the same time.
+class ExecutionContext {
+public:
+    // While set, forward() records one span per plan step (with its op,
+    // precision and tensor shapes) into `recorder`; nullptr turns it off
+    void set_trace(trace::Recorder* recorder) { trace = recorder; }
+
+private:
+    friend class LiteCNNPro;
+    uint64_t plan_id = 0;
+    Workspace workspace;
+    trace::Recorder* trace = nullptr;
+};
+
+// Lock-free pool of reusable execution contexts. acquire() takes an idle
+// context (creating one only when all are in use) and the lease puts it
+// back, keeping at most `capacity` idle contexts.
+class ContextPool {
+public:
+    class Lease {
+    public:
+        Lease(Lease&& other) noexcept : pool_(other.pool_), context_(other.context_) {
+            other.context_ = nullptr;
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&) = delete;
+        ~Lease() {
+            if (context_) pool_->release(context_);
+        }
+
+        ExecutionContext& operator*() const { return *context_; }
+        ExecutionContext* operator->() const { return context_; }
+
+    private:
+        friend class ContextPool;
+        Lease(ContextPool* pool, ExecutionContext* context) : pool_(pool), context_(context) {}
+
+        ContextPool* pool_;
+        ExecutionContext* context_;
+    };
+
+    explicit ContextPool(size_t capacity = 64);
+    ~ContextPool();
+
+    ContextPool(const ContextPool&) = delete;
+    ContextPool& operator=(const ContextPool&) = delete;
+
+    Lease acquire();
+
+private:
+    size_t capacity_;
+    std::unique_ptr<std::atomic<ExecutionContext*>[]> slots_;
+
+    void release(ExecutionContext* context);
+};
 
 class LiteCNNPro {
 public:
     LiteCNNPro();
-    
-    bool load_weights(const std::string& weights_path);
-    
-    Tensor forward(const Tensor& input);
-    
+
+    // Loads the weights and compiles the execution plan. Tensors of LCNN v2
+    // files stay in the read-only mapping; only folded / packed copies made
+    // by compile() are owned by the model.
+    // An LCNP plan artifact (see save_plan) is mapped and used as is: its
+    // precision and channel block replace the configured ones and the
+    // model cannot be recompiled.
+    bool load_weights(const std::string& weights_path,
+                      const WeightLoadOptions& options = WeightLoadOptions());
+
+    // Takes effect on the next compile(); recompiles if weights are loaded
+    void set_precision(Precision precision);
+    Precision precision() const { return precision_; }
+
+    // NCHWc block the weights are packed for, kChannelBlock by default.
+    // Another block compiles a plan for a different ISA that can only be
+    // written with save_plan(), not run. Takes effect on the next compile().
+    void set_channel_block(int block);
+    int channel_block() const { return channel_block_; }
+
+    // Resolves every layer into plan_; throws if a weight is missing
+    void compile();
+
+    // Writes the compiled plan (folded and packed weights plus the step
+    // list) as an LCNP artifact that load_weights() maps without compiling
+    bool save_plan(const std::string& path) const;
+    bool precompiled() const { return precompiled_; }
+
+    // Inference never modifies the model, so one compiled model can serve
+    // any number of threads, each with its own ExecutionContext.
+    // Writes logits into `output`, reusing its storage when the shape matches
+    void forward(const Tensor& input, Tensor& output, ExecutionContext& context) const;
+
+    // Same, with a context borrowed from the model's internal pool
+    void forward(const Tensor& input, Tensor& output) const;
+    Tensor forward(const Tensor& input) const;
+
+    // Post-training calibration: run representative inputs through the
+    // FP32 plan, then write the weights together with one
+    // "<layer>.input_scale" tensor per INT8 layer
+    void calibrate(const Tensor& input);
+    bool save_calibrated_weights(const std::string& path) const;
+
 private:
     // Weights storage
     std::map<std::string, Tensor> weights_;
-    
+
+    // Compiled execution plan
+    Precision precision_ = Precision::FP32;
+    int channel_block_ = kChannelBlock;
+    bool precompiled_ = false; // plan_ was loaded from an artifact
+    std::vector<PlanStep> plan_;
+    // Unique per compile() / loaded plan; contexts planned for another id re-plan
+    uint64_t plan_id_ = 0;
+    static uint64_t next_plan_id();
+
+    // Largest activation seen at each step output during calibration
+    std::vector<float> calibration_max_;
+
+    // Contexts for callers that do not bring their own
+    mutable ContextPool contexts_;
+
+    bool load_plan(const std::string& path, const WeightLoadOptions& options);
+
+    void prepare_workspace(Workspace& ws, int N, int C, int H, int W) const;
+    void run(const Tensor& input, Tensor& output, ExecutionContext& context,
+             std::vector<float>* observed_max) const;
+    // observed_max: when set, receives the max of every step's output
+    void execute(const Tensor& input, Tensor& output, Workspace& ws,
+                 std::vector<float>* observed_max = nullptr, trace::Recorder* tracer = nullptr) const;
+    // T: storage type of the NCHWc activations
+    template <class T>
+    void execute_steps(const Tensor& input, Workspace& ws, std::vector<float>* observed_max,
+                       trace::Recorder* tracer) const;
+    void trace_step(trace::Recorder& tracer, const PlanStep& step, const StepIO& io,
+                    int N, uint64_t begin_ns) const;
+
     // Helper methods
-    Tensor depthwise_separable_conv(const Tensor& x, const std::string& prefix, 
-                                    int stride, bool use_se);
-    
-    Tensor se_block(const Tensor& x, const std::string& prefix);
-    
-    Tensor get_weight(const std::string& name) const;
+    PlanStep compile_conv(const std::string& conv_name, const std::string& bn_name,
+                          int stride, int padding, int groups, bool relu6) const;
+    void quantize_step(PlanStep& step, const float* weight, int rows, int cols) const;
+    void store_weights_16bit(PlanStep& step, const Tensor& weights) const;
+    float input_scale(const std::string& step_name) const;
+
+    const Tensor& get_weight(const std::string& name) const;
     bool has_weight(const std::string& name) const;
 };
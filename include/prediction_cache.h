@@ -0,0 +1,98 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct CacheOptions {
+    // Memory budget for cached logits (plus per-entry bookkeeping); 0 disables
+    size_t max_bytes = 64u << 20;
+    // Entries older than this are recomputed; 0 keeps them until evicted
+    int ttl_s = 3600;
+};
+
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // Requests that waited for an identical in-flight request
+    uint64_t coalesced = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+};
+
+// Content-addressed cache of model outputs
+//
+// Keyed by a 128-bit hash of the raw upload (two xxHash64 lanes under
+// independent random seeds drawn per process) plus its length, so
+// identical bytes map to the same logits without decoding anything, and
+// a client cannot precompute colliding uploads to read or poison another
+// upload's entry. Entries are
+// evicted least-recently-used once max_bytes is exceeded and ignored after
+// ttl_s. Concurrent requests for the same key are coalesced: the first one
+// computes, the others block on its result (or its exception). Failures
+// are not cached.
+class PredictionCache {
+public:
+    enum class Outcome { Hit, Miss, Coalesced };
+
+    explicit PredictionCache(const CacheOptions& options);
+
+    PredictionCache(const PredictionCache&) = delete;
+    PredictionCache& operator=(const PredictionCache&) = delete;
+
+    // Cached logits for data[0, size), or compute()'s result, which is then
+    // stored. compute runs on the calling thread; its exceptions propagate
+    // to the caller and every request coalesced onto it.
+    std::vector<float> get_or_compute(const uint8_t* data, size_t size,
+                                      const std::function<std::vector<float>()>& compute,
+                                      Outcome* outcome = nullptr);
+
+    CacheStats stats() const;
+
+    // Drops every entry, e.g. after the model changed. Computations already
+    // running still answer their callers but are not stored, and new
+    // requests do not coalesce onto them.
+    void clear();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Key {
+        uint64_t hash[2];
+        uint64_t size;
+        bool operator==(const Key& other) const {
+            return hash[0] == other.hash[0] && hash[1] == other.hash[1] && size == other.size;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const { return static_cast<size_t>(key.hash[0] ^ key.size); }
+    };
+    struct Entry {
+        Key key;
+        std::vector<float> logits;
+        Clock::time_point stored;
+    };
+
+    CacheOptions options_;
+    // Secret per-process seeds of the two hash lanes
+    uint64_t seeds_[2];
+
+    mutable std::mutex mutex_;
+    // Most recently used first
+    std::list<Entry> lru_;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> entries_;
+    std::unordered_map<Key, std::shared_future<std::vector<float>>, KeyHash> in_flight_;
+    CacheStats stats_;
+    // Bumped by clear(); a miss stores its result only if unchanged
+    uint64_t generation_ = 0;
+
+    static size_t entry_bytes(const Entry& entry);
+    void insert(const Key& key, const std::vector<float>& logits);
+    void erase(std::list<Entry>::iterator it);
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include "tensor.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Model input resolution
+constexpr int kInputSize = 224;
+
+// Largest decoded image accepted (after any JPEG DCT-domain reduction);
+// checked from the header before any pixel is decoded
+constexpr int64_t kMaxImagePixels = 40'000'000;
+// Largest JPEG accepted for reduced decoding, by its own (source) size;
+// bounds the entropy decoding done for a header-declared size
+constexpr int64_t kMaxSourcePixels = 200'000'000;
+
+// Decoded upload: 8-bit interleaved RGB
+struct DecodedImage {
+    int width = 0;
+    int height = 0;
+    const uint8_t* rgb = nullptr;
+    // Owns rgb (the reduced JPEG or stb_image's buffer)
+    std::shared_ptr<const void> storage;
+};
+
+// Decodes an encoded image (JPEG/PNG/...). Baseline JPEGs are decoded at
+// 1/2, 1/4 or 1/8 scale when that still leaves both sides >= 224 (see
+// jpeg_decoder.h). Throws std::runtime_error if the image cannot be
+// decoded or is too large.
+DecodedImage decode_image(const uint8_t* data, size_t size);
+
+// Resizes to 224x224 (triangle filter, widened when shrinking so every
+// source pixel contributes), applies ImageNet normalization and writes a
+// planar [3, 224, 224] float sample to `dst` in one pass. Rows are split
+// across the thread pool; scratch memory is reused per thread.
+void resize_normalize_into(const DecodedImage& image, float* dst);
+
+// ImageNet normalization and HWC -> CHW of an image that is already
+// 224x224 interleaved RGB
+void normalize_into(const uint8_t* rgb, float* dst);
+
+// decode_image + resize_normalize_into a new [1, 3, 224, 224] NCHW tensor
+Tensor preprocess_image(const uint8_t* data, size_t size);
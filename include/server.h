@@ -1,31 +1,162 @@
 #pragma once
 #include "model.h"
+#include "batcher.h"
+#include "prediction_cache.h"
+#include "metrics.h"
+#include "epoll_server.h"
+#include "unix_server.h"
+#include "shm_server.h"
+#include <atomic>
+#include <functional>
 #include <string>
 #include <memory>
 #include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace httplib {
+struct Request;
+struct Response;
+}
+
+struct TraceOptions {
+    // Writes the trace of every Nth /predict request to dir; 0 disables
+    int sample_every = 0;
+    std::string dir = "traces";
+};
 
 struct BreedInfo {
     std::string en;
     std::string ko;
 };
 
+// Class id -> names from breed_classes.json; throws if it cannot be read
+std::map<int, BreedInfo> load_breed_classes(const std::string& path);
+
+// The k highest logits as (class id, probability), the softmax taken over
+// those k as in /predict responses; k >= 1
+std::vector<std::pair<int, float>> top_predictions(const std::vector<float>& logits, int k);
+
 class InferenceServer {
 public:
-    InferenceServer(int port, const std::string& weights_path, const std::string& breeds_path);
+    InferenceServer(int port, const std::string& weights_path, const std::string& breeds_path,
+                    Precision precision = Precision::FP32,
+                    const BatchOptions& batching = BatchOptions(),
+                    const WeightLoadOptions& loading = WeightLoadOptions(),
+                    const CacheOptions& caching = CacheOptions(),
+                    const TraceOptions& tracing = TraceOptions());
     
+    // httplib's thread-per-connection server
     void run();
+    // Event-driven front-end (see epoll_server.h), same endpoints
+    void run_epoll(const EpollOptions& options);
+    // Also serves the binary protocol of unix_protocol.h on a Unix domain
+    // socket (same model, batcher, cache and metrics); call before run*()
+    void listen_unix(const std::string& path);
+    // Also takes submissions through shared memory (see shm_protocol.h);
+    // call before run*()
+    void listen_shm(const ShmOptions& options);
+    
+    // Hot reload (POST /admin/reload, SIGHUP): loads the weights path again,
+    // validates and warms the new model up while the current one keeps
+    // serving, then swaps it in and clears the prediction cache. Requests
+    // already running finish on the old model. Returns the new model
+    // generation; throws, leaving the current model in place, if the new
+    // weights fail to load or validate. Concurrent calls run one at a time.
+    uint64_t reload_model();
     
 private:
     int port_;
-    std::unique_ptr<LiteCNNPro> model_;
+    // Owns the current model (see Batcher::set_model)
+    std::unique_ptr<Batcher> batcher_;
+    // Answers re-uploads of identical bytes without decoding
+    std::unique_ptr<PredictionCache> cache_;
     std::map<int, BreedInfo> breeds_;
     
+    // What reload_model() loads again
+    std::string weights_path_;
+    Precision precision_;
+    WeightLoadOptions loading_;
+    int warmup_batch_;
+    size_t classes_ = 0; // a reloaded model must keep the class count
+    std::mutex reload_mutex_;
+    std::atomic<uint64_t> model_generation_{1};
+    std::atomic<uint64_t> reload_failures_{0};
+    
+    // Loads weights_path_ into a new model, checks its logits on a blank
+    // input and runs it once per batch size it will see first; throws
+    std::shared_ptr<const LiteCNNPro> load_model();
+    
+    // /predict telemetry, exported by /metrics
+    struct StageHistograms {
+        metrics::Histogram receive;   // headers + body, until the handler runs
+        metrics::Histogram decode;
+        metrics::Histogram resize;    // resize + normalize into the batch slot
+        metrics::Histogram queue;     // waiting for a batch to form
+        metrics::Histogram forward;
+        metrics::Histogram serialize;
+        metrics::Histogram total;
+        metrics::Histogram total_raw; // same for /predict_raw
+        metrics::Histogram total_unix; // same for Unix socket requests
+        metrics::Histogram total_shm;  // shared-memory slots, from submission
+    };
+    StageHistograms stages_;
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<uint64_t> errors_{0};
+    std::atomic<int> in_flight_{0};
+    TraceOptions tracing_;
+    
+    struct Endpoint {
+        std::string method;
+        std::string path;
+        std::function<void(const httplib::Request&, httplib::Response&)> handle;
+    };
+    // Every route, for whichever front-end serves them
+    std::vector<Endpoint> endpoints();
+    
     // Load breed classes
     void load_breeds(const std::string& breeds_path);
     
-    // Image preprocessing
-    Tensor preprocess_image(const std::vector<uint8_t>& image_data);
+    // Fills the response of one inference request. tracer records its
+    // stages and layers (or is nullptr); embed_trace adds it to the body
+    using Handler = std::function<void(const httplib::Request&, httplib::Response&,
+                                       trace::Recorder* tracer, bool embed_trace)>;
+    
+    // Bookkeeping shared by the inference endpoints: counters, receive and
+    // end-to-end (`total`) latency, tracing, exceptions -> 500
+    void serve(const httplib::Request& req, httplib::Response& res, metrics::Histogram& total,
+               const Handler& handler);
+    
+    // Cached or batched inference for one upload; returns the JSON body
+    std::string predict(const std::string& content, PredictionCache::Outcome& outcome,
+                        trace::Recorder* tracer, bool embed_trace);
+    
+    // The logits behind predict(), for front-ends with their own encoding
+    std::vector<float> infer(const std::string& content, PredictionCache::Outcome& outcome,
+                             trace::Recorder* tracer);
+    
+    // Batched inference on a body that already is the model input, either
+    // 224x224x3 uint8 RGB (normalized here) or a normalized float32
+    // [1, 3, 224, 224] tensor (copied as is); never cached
+    std::string predict_raw(const std::string& body, bool rgb8, trace::Recorder* tracer,
+                            bool embed_trace);
+    
+    // The logits behind predict_raw(); input is read while the batch fills
+    std::vector<float> infer_raw(const uint8_t* input, bool rgb8, trace::Recorder* tracer);
+    
+    // Top-5 JSON body, timed as the serialize stage
+    std::string serialize(const std::vector<float>& logits, trace::Recorder* tracer, bool embed_trace);
     
     // Response generation
-    std::string create_response(const std::vector<float>& logits);
+    std::string create_response(const std::vector<float>& logits,
+                                const trace::Recorder* trace = nullptr);
+    
+    // Prometheus text exposition
+    std::string render_metrics();
+    
+    // Declared last: destroyed first, while the batcher and cache they call
+    // into still exist
+    std::unique_ptr<UnixSocketServer> unix_server_;
+    std::unique_ptr<ShmServer> shm_server_;
 };
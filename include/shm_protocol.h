@@ -0,0 +1,191 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Layout of the shared-memory submission interface (--shm NAME), shared by
+// the server and litecnn_client. The region is created by the server:
+//
+//   Header | Cell[slot_count] (submission ring) | Slot[slot_count]
+//
+// A producer claims a free slot (CAS Free -> Writing), writes the frame
+// straight into slot.input, marks it Submitted and pushes its index into
+// the ring, a bounded lock-free MPMC queue (any number of producer threads
+// or processes, several server workers). A worker claims the slot (CAS
+// Submitted -> Processing), normalizes or copies the input into its batch
+// and writes the result back into the same slot (Done). The server trusts
+// nothing it reads from the region: the layout helpers take the slot count
+// as a parameter so that each side passes the value it validated when
+// mapping, not header->slot_count, and out-of-range indices and slots that
+// are not Submitted are dropped. Pixels never pass through the kernel; wake-ups are
+// futexes on words of the region, and only when someone sleeps on them.
+namespace shm_protocol {
+
+constexpr uint32_t kMagic = 0x48534e4c; // "LNSH"
+constexpr uint32_t kVersion = 2;
+constexpr int kImageSize = 224;
+// Largest input: float32 [1, 3, 224, 224]
+constexpr size_t kInputBytes = 3ull * kImageSize * kImageSize * sizeof(float);
+constexpr int kMaxTopK = 32;
+constexpr size_t kMaxError = 256;
+
+enum Dtype : uint32_t {
+    RGB8 = 0,    // 224x224x3 interleaved uint8, normalized by the server
+    Float32 = 1, // normalized NCHW [1, 3, 224, 224]
+};
+
+enum SlotState : uint32_t {
+    Free = 0,
+    Writing = 1,   // claimed by a producer
+    Submitted = 2,  // in the ring
+    Processing = 3, // taken by a server worker
+    Done = 4,       // result written, producer still to read it
+};
+
+enum Status : uint32_t {
+    Ok = 0,
+    BadRequest = 1,
+    ServerError = 2,
+};
+
+struct Prediction {
+    uint32_t class_id;
+    float score;
+};
+
+struct alignas(64) Slot {
+    std::atomic<uint32_t> state;   // SlotState, futex word for the producer
+    std::atomic<uint32_t> waiting; // producer asleep on state
+    // Request, written by the producer before Submitted
+    uint32_t dtype;
+    uint32_t top_k;
+    int64_t submit_ns; // CLOCK_MONOTONIC (steady_clock), for latency metrics
+    // Reply, written by the server before Done: count predictions, or an
+    // error message of count bytes
+    uint32_t status;
+    uint32_t count;
+    Prediction predictions[kMaxTopK];
+    char error[kMaxError];
+    alignas(64) uint8_t input[kInputBytes];
+};
+
+struct Cell {
+    std::atomic<uint64_t> sequence;
+    uint32_t slot;
+};
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count; // power of two; read once when mapping
+    std::atomic<uint32_t> closed; // set when the server shuts down
+    // Ring indices on separate cache lines (producers / workers)
+    alignas(64) std::atomic<uint64_t> tail;
+    alignas(64) std::atomic<uint64_t> head;
+    // Bumped after each push; futex word for idle workers
+    alignas(64) std::atomic<uint32_t> submitted;
+    std::atomic<uint32_t> sleepers;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+              std::atomic<uint64_t>::is_always_lock_free,
+              "shared-memory atomics must be lock-free");
+
+inline size_t region_size(uint32_t slot_count) {
+    size_t cells = (sizeof(Header) + sizeof(Cell) * slot_count + alignof(Slot) - 1) /
+                   alignof(Slot) * alignof(Slot);
+    return cells + sizeof(Slot) * slot_count;
+}
+
+inline Cell* cells(Header* header) {
+    return reinterpret_cast<Cell*>(header + 1);
+}
+
+inline Slot* slots(Header* header, uint32_t slot_count) {
+    size_t offset = region_size(slot_count) - sizeof(Slot) * slot_count;
+    return reinterpret_cast<Slot*>(reinterpret_cast<uint8_t*>(header) + offset);
+}
+
+// The ring holds at most slot_count entries and a slot is in it at most
+// once, so it only looks full while a consumer is between taking a cell
+// and releasing it; false then, and the caller retries. Like try_pop, the
+// tail only moves once its cell is known free.
+//
+// Limitation: a producer that dies between the tail CAS and the sequence
+// store leaves a cell that is never published. Workers stop at it, the ring
+// fills up and push keeps returning false until the server is restarted
+// (which recreates the region).
+inline bool try_push(Header* header, uint32_t slot_count, uint32_t slot) {
+    Cell* ring = cells(header);
+    uint64_t mask = slot_count - 1;
+    uint64_t pos = header->tail.load(std::memory_order_relaxed);
+    while (true) {
+        Cell& cell = ring[pos & mask];
+        uint64_t seq = cell.sequence.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+        if (diff == 0) {
+            if (header->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.slot = slot;
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false; // full
+        } else {
+            uint64_t moved = header->tail.load(std::memory_order_relaxed);
+            if (moved == pos) {
+                return false; // a lap ahead of an unmoved tail: corrupted
+            }
+            pos = moved;
+        }
+    }
+}
+
+inline bool try_pop(Header* header, uint32_t slot_count, uint32_t& slot) {
+    Cell* ring = cells(header);
+    uint64_t mask = slot_count - 1;
+    uint64_t pos = header->head.load(std::memory_order_relaxed);
+    while (true) {
+        Cell& cell = ring[pos & mask];
+        uint64_t seq = cell.sequence.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos + 1);
+        if (diff == 0) {
+            if (header->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot = cell.slot;
+                cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false; // empty
+        } else {
+            uint64_t moved = header->head.load(std::memory_order_relaxed);
+            if (moved == pos) {
+                return false; // a lap ahead of an unmoved head: corrupted
+            }
+            pos = moved;
+        }
+    }
+}
+
+#if defined(__linux__)
+// Process-shared futex (no FUTEX_PRIVATE_FLAG: the word lives in a shared
+// mapping); returns after a wake-up, a value change or timeout_ms
+inline void futex_wait(std::atomic<uint32_t>& word, uint32_t expected, int timeout_ms) {
+    timespec timeout{timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &timeout,
+            nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<uint32_t>& word, int count) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, count, nullptr, nullptr, 0);
+}
+#endif
+
+} // namespace shm_protocol
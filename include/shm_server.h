@@ -0,0 +1,56 @@
+#pragma once
+#include "shm_protocol.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct ShmOptions {
+    // POSIX shared memory name, e.g. "/litecnn"; empty disables
+    std::string name;
+    // Input / result slots, rounded up to a power of two (~600 KB each)
+    int slots = 32;
+    // Threads taking slots off the ring; each blocks in one inference, so
+    // about --max-batch of them let the batcher fill batches
+    int workers = 8;
+};
+
+// Server side of the shared-memory submission interface (see
+// shm_protocol.h). Creates the region, replacing one left by a previous run,
+// and runs workers that pop submitted slots, call the handler on the input
+// in place and write the reply into the slot. Linux only.
+class ShmServer {
+public:
+    // Throws for a bad dtype / top_k (reported as BadRequest) or a failed
+    // inference (ServerError); returns the top_k predictions otherwise
+    using Handler = std::function<std::vector<std::pair<int, float>>(
+        const uint8_t* input, shm_protocol::Dtype dtype, int top_k,
+        std::chrono::steady_clock::time_point submitted)>;
+
+    ShmServer(const ShmOptions& options, Handler handler);
+    // Marks the region closed (waking waiting producers), joins the workers
+    // and unlinks the name
+    ~ShmServer();
+
+    ShmServer(const ShmServer&) = delete;
+    ShmServer& operator=(const ShmServer&) = delete;
+
+private:
+    std::string name_;
+    Handler handler_;
+    shm_protocol::Header* header_ = nullptr;
+    size_t size_ = 0;
+    // Our copies; the header fields are writable by producers
+    uint32_t slot_count_ = 0;
+    shm_protocol::Slot* slots_ = nullptr;
+    std::atomic<bool> stopping_{false};
+    std::vector<std::thread> workers_;
+
+    void worker_loop();
+    // Claims and processes the slot a popped index names, if it is valid
+    void take(uint32_t index);
+    void process(shm_protocol::Slot& slot);
+};
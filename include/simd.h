@@ -0,0 +1,303 @@
+#pragma once
+// Thin SIMD abstraction used by the compute kernels.
+// Picks the widest float vector available at compile time
+// (AVX-512 > AVX2/FMA > NEON > scalar) behind one small API.
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#elif defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace simd {
+
+#if defined(__AVX512F__)
+
+constexpr int kWidth = 16;
+using vfloat = __m512;
+
+inline vfloat zero() { return _mm512_setzero_ps(); }
+inline vfloat set1(float v) { return _mm512_set1_ps(v); }
+inline vfloat load(const float* p) { return _mm512_loadu_ps(p); }
+inline void store(float* p, vfloat v) { _mm512_storeu_ps(p, v); }
+inline vfloat fmadd(vfloat a, vfloat b, vfloat c) { return _mm512_fmadd_ps(a, b, c); }
+inline vfloat add(vfloat a, vfloat b) { return _mm512_add_ps(a, b); }
+inline vfloat mul(vfloat a, vfloat b) { return _mm512_mul_ps(a, b); }
+inline vfloat max(vfloat a, vfloat b) { return _mm512_max_ps(a, b); }
+inline vfloat min(vfloat a, vfloat b) { return _mm512_min_ps(a, b); }
+
+inline vfloat load_partial(const float* p, int n) {
+    return _mm512_maskz_loadu_ps(static_cast<__mmask16>((1u << n) - 1), p);
+}
+inline void store_partial(float* p, vfloat v, int n) {
+    _mm512_mask_storeu_ps(p, static_cast<__mmask16>((1u << n) - 1), v);
+}
+
+// Load p[0], p[2], ..., p[2 * (kWidth - 1)] (reads 2 * kWidth floats)
+inline vfloat load_even(const float* p) {
+    const __m512i idx = _mm512_set_epi32(30, 28, 26, 24, 22, 20, 18, 16,
+                                         14, 12, 10, 8, 6, 4, 2, 0);
+    return _mm512_permutex2var_ps(_mm512_loadu_ps(p), idx, _mm512_loadu_ps(p + kWidth));
+}
+
+// kWidth bytes widened to float
+inline vfloat load_u8(const uint8_t* p) {
+    return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+}
+
+#elif defined(__AVX2__) && defined(__FMA__)
+
+constexpr int kWidth = 8;
+using vfloat = __m256;
+
+inline vfloat zero() { return _mm256_setzero_ps(); }
+inline vfloat set1(float v) { return _mm256_set1_ps(v); }
+inline vfloat load(const float* p) { return _mm256_loadu_ps(p); }
+inline void store(float* p, vfloat v) { _mm256_storeu_ps(p, v); }
+inline vfloat fmadd(vfloat a, vfloat b, vfloat c) { return _mm256_fmadd_ps(a, b, c); }
+inline vfloat add(vfloat a, vfloat b) { return _mm256_add_ps(a, b); }
+inline vfloat mul(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+inline vfloat max(vfloat a, vfloat b) { return _mm256_max_ps(a, b); }
+inline vfloat min(vfloat a, vfloat b) { return _mm256_min_ps(a, b); }
+
+inline __m256i tail_mask(int n) {
+    static const int32_t table[16] = {-1, -1, -1, -1, -1, -1, -1, -1,
+                                       0,  0,  0,  0,  0,  0,  0,  0};
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(table + 8 - n));
+}
+inline vfloat load_partial(const float* p, int n) { return _mm256_maskload_ps(p, tail_mask(n)); }
+inline void store_partial(float* p, vfloat v, int n) { _mm256_maskstore_ps(p, tail_mask(n), v); }
+
+// Load p[0], p[2], ..., p[2 * (kWidth - 1)] (reads 2 * kWidth floats)
+inline vfloat load_even(const float* p) {
+    __m256 lo = _mm256_loadu_ps(p);
+    __m256 hi = _mm256_loadu_ps(p + kWidth);
+    __m256 ev = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+    return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(ev), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+// kWidth bytes widened to float
+inline vfloat load_u8(const uint8_t* p) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))));
+}
+
+#elif defined(__ARM_NEON)
+
+constexpr int kWidth = 4;
+using vfloat = float32x4_t;
+
+inline vfloat zero() { return vdupq_n_f32(0.0f); }
+inline vfloat set1(float v) { return vdupq_n_f32(v); }
+inline vfloat load(const float* p) { return vld1q_f32(p); }
+inline void store(float* p, vfloat v) { vst1q_f32(p, v); }
+inline vfloat fmadd(vfloat a, vfloat b, vfloat c) { return vfmaq_f32(c, a, b); }
+inline vfloat add(vfloat a, vfloat b) { return vaddq_f32(a, b); }
+inline vfloat mul(vfloat a, vfloat b) { return vmulq_f32(a, b); }
+inline vfloat max(vfloat a, vfloat b) { return vmaxq_f32(a, b); }
+inline vfloat min(vfloat a, vfloat b) { return vminq_f32(a, b); }
+
+inline vfloat load_partial(const float* p, int n) {
+    float tmp[kWidth] = {};
+    std::memcpy(tmp, p, n * sizeof(float));
+    return vld1q_f32(tmp);
+}
+inline void store_partial(float* p, vfloat v, int n) {
+    float tmp[kWidth];
+    vst1q_f32(tmp, v);
+    std::memcpy(p, tmp, n * sizeof(float));
+}
+
+// Load p[0], p[2], ..., p[2 * (kWidth - 1)] (reads 2 * kWidth floats)
+inline vfloat load_even(const float* p) { return vld2q_f32(p).val[0]; }
+
+// kWidth bytes widened to float
+inline vfloat load_u8(const uint8_t* p) {
+    uint32_t bytes;
+    std::memcpy(&bytes, p, sizeof(bytes));
+    uint16x8_t wide = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(bytes)));
+    return vcvtq_f32_u32(vmovl_u16(vget_low_u16(wide)));
+}
+
+#else
+
+constexpr int kWidth = 1;
+using vfloat = float;
+
+inline vfloat zero() { return 0.0f; }
+inline vfloat set1(float v) { return v; }
+inline vfloat load(const float* p) { return *p; }
+inline void store(float* p, vfloat v) { *p = v; }
+inline vfloat fmadd(vfloat a, vfloat b, vfloat c) { return a * b + c; }
+inline vfloat add(vfloat a, vfloat b) { return a + b; }
+inline vfloat mul(vfloat a, vfloat b) { return a * b; }
+inline vfloat max(vfloat a, vfloat b) { return std::max(a, b); }
+inline vfloat min(vfloat a, vfloat b) { return std::min(a, b); }
+inline vfloat load_partial(const float* p, int n) { return n > 0 ? *p : 0.0f; }
+inline void store_partial(float* p, vfloat v, int n) { if (n > 0) *p = v; }
+inline vfloat load_even(const float* p) { return *p; }
+inline vfloat load_u8(const uint8_t* p) { return static_cast<float>(*p); }
+
+#endif
+
+// ---------------------------------------------------------------------------
+// 16-bit storage formats. Kernels templated on the storage type go through
+// the load / store overloads below and always compute in float.
+// ---------------------------------------------------------------------------
+
+struct fp16 { uint16_t bits; }; // IEEE half
+struct bf16 { uint16_t bits; }; // bfloat16: upper half of a float
+
+inline float to_float(float v) { return v; }
+
+inline float to_float(fp16 v) {
+#if defined(__F16C__)
+    return _cvtsh_ss(v.bits);
+#else
+    uint32_t sign = static_cast<uint32_t>(v.bits & 0x8000) << 16;
+    uint32_t exp = (v.bits >> 10) & 0x1F;
+    uint32_t mant = v.bits & 0x3FF;
+    if (exp == 0) {
+        float f = static_cast<float>(mant) * (1.0f / 16777216.0f); // subnormal: mant * 2^-24
+        return sign ? -f : f;
+    }
+    uint32_t bits = sign | (exp == 31 ? 0x7F800000 : (exp + 112) << 23) | (mant << 13);
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+#endif
+}
+
+inline float to_float(bf16 v) {
+    uint32_t bits = static_cast<uint32_t>(v.bits) << 16;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Round to nearest even
+template <class T> T from_float(float v);
+template <> inline float from_float<float>(float v) { return v; }
+
+template <> inline fp16 from_float<fp16>(float v) {
+#if defined(__F16C__)
+    return {static_cast<uint16_t>(_cvtss_sh(v, _MM_FROUND_TO_NEAREST_INT))};
+#else
+    uint32_t x;
+    std::memcpy(&x, &v, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t abs = x & 0x7FFFFFFF;
+    if (abs >= 0x7F800000) return {static_cast<uint16_t>(sign | (abs > 0x7F800000 ? 0x7E00 : 0x7C00))};
+    if (abs >= 0x477FF000) return {static_cast<uint16_t>(sign | 0x7C00)}; // rounds to infinity
+    if (abs < 0x38800000) {
+        // Half subnormal: count units of 2^-24
+        float a;
+        std::memcpy(&a, &abs, sizeof(a));
+        return {static_cast<uint16_t>(sign | static_cast<uint32_t>(std::nearbyint(a * 16777216.0f)))};
+    }
+    abs += 0xC8000FFF + ((abs >> 13) & 1); // rebias exponent by -112, round
+    return {static_cast<uint16_t>(sign | (abs >> 13))};
+#endif
+}
+
+template <> inline bf16 from_float<bf16>(float v) {
+    uint32_t x;
+    std::memcpy(&x, &v, sizeof(x));
+    if ((x & 0x7FFFFFFF) > 0x7F800000) return {static_cast<uint16_t>((x >> 16) | 0x40)}; // quiet NaN
+    x += 0x7FFF + ((x >> 16) & 1);
+    return {static_cast<uint16_t>(x >> 16)};
+}
+
+#if defined(__AVX512F__)
+
+inline vfloat load(const fp16* p) {
+    return _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+}
+inline void store(fp16* p, vfloat v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p),
+                        _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+}
+inline vfloat load(const bf16* p) {
+    __m512i w = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    return _mm512_castsi512_ps(_mm512_slli_epi32(w, 16));
+}
+inline void store(bf16* p, vfloat v) {
+#if defined(__AVX512BF16__)
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), (__m256i)_mm512_cvtneps_pbh(v));
+#else
+    __m512i x = _mm512_castps_si512(v);
+    __m512i lsb = _mm512_and_si512(_mm512_srli_epi32(x, 16), _mm512_set1_epi32(1));
+    x = _mm512_add_epi32(x, _mm512_add_epi32(lsb, _mm512_set1_epi32(0x7FFF)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_cvtepi32_epi16(_mm512_srli_epi32(x, 16)));
+#endif
+}
+
+#elif defined(__AVX2__) && defined(__FMA__)
+
+inline vfloat load(const fp16* p) {
+#if defined(__F16C__)
+    return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+#else
+    float tmp[kWidth];
+    for (int i = 0; i < kWidth; ++i) tmp[i] = to_float(p[i]);
+    return _mm256_loadu_ps(tmp);
+#endif
+}
+inline void store(fp16* p, vfloat v) {
+#if defined(__F16C__)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+#else
+    float tmp[kWidth];
+    _mm256_storeu_ps(tmp, v);
+    for (int i = 0; i < kWidth; ++i) p[i] = from_float<fp16>(tmp[i]);
+#endif
+}
+inline vfloat load(const bf16* p) {
+    __m256i w = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(w, 16));
+}
+inline void store(bf16* p, vfloat v) {
+    __m256i x = _mm256_castps_si256(v);
+    __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(x, 16), _mm256_set1_epi32(1));
+    x = _mm256_srli_epi32(_mm256_add_epi32(x, _mm256_add_epi32(lsb, _mm256_set1_epi32(0x7FFF))), 16);
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(x, x), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_castsi256_si128(packed));
+}
+
+#elif defined(__ARM_NEON)
+
+inline vfloat load(const fp16* p) {
+    return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(reinterpret_cast<const uint16_t*>(p))));
+}
+inline void store(fp16* p, vfloat v) {
+    vst1_u16(reinterpret_cast<uint16_t*>(p), vreinterpret_u16_f16(vcvt_f16_f32(v)));
+}
+inline vfloat load(const bf16* p) {
+    return vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(reinterpret_cast<const uint16_t*>(p)), 16));
+}
+inline void store(bf16* p, vfloat v) {
+    uint32x4_t x = vreinterpretq_u32_f32(v);
+    uint32x4_t lsb = vandq_u32(vshrq_n_u32(x, 16), vdupq_n_u32(1));
+    x = vaddq_u32(x, vaddq_u32(lsb, vdupq_n_u32(0x7FFF)));
+    vst1_u16(reinterpret_cast<uint16_t*>(p), vshrn_n_u32(x, 16));
+}
+
+#else
+
+inline vfloat load(const fp16* p) { return to_float(*p); }
+inline void store(fp16* p, vfloat v) { *p = from_float<fp16>(v); }
+inline vfloat load(const bf16* p) { return to_float(*p); }
+inline void store(bf16* p, vfloat v) { *p = from_float<bf16>(v); }
+
+#endif
+
+} // namespace simd
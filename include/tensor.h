@@ -6,11 +6,33 @@
 #include <stdexcept>
 #include <cstring>
 
+// Memory layout of a 4-D activation tensor
+//   NCHW  : plain planar layout
+//   NCHWc : channels split into blocks of `block`; each pixel stores the
+//           block contiguously -> [N][C / block][H][W][block].
+//           C is padded up to a multiple of block with zeros.
+enum class Layout {
+    NCHW,
+    NCHWc
+};
+
+inline int round_up_channels(int C, int block) {
+    return (C + block - 1) / block * block;
+}
+
 // Lightweight tensor class using raw memory
 class Tensor {
 public:
-    std::vector<int> shape;
+    std::vector<int> shape;     // logical [N, C, H, W] for both layouts
     std::vector<float> data;
+    Layout layout = Layout::NCHW;
+    int block = 1;
+
+    // Read-only view of memory owned by `storage` (e.g. a memory-mapped
+    // weight file) instead of `data`, which stays empty. Only the const
+    // ptr() sees it; the mutable one throws on a view.
+    const float* view = nullptr;
+    std::shared_ptr<const void> storage;
     
     Tensor() = default;
     
@@ -19,9 +41,28 @@ public:
         for (int s : shape) total *= s;
         data.resize(total);
     }
+
+    // Blocked NCHWc tensor with zero-initialized channel padding
+    Tensor(const std::vector<int>& shape_, Layout layout_, int block_)
+        : shape(shape_), layout(layout_), block(layout_ == Layout::NCHWc ? block_ : 1) {
+        size_t total = 1;
+        for (size_t i = 0; i < shape.size(); ++i) {
+            total *= (i == 1 && layout == Layout::NCHWc) ? round_up_channels(shape[i], block) : shape[i];
+        }
+        data.assign(total, 0.0f);
+    }
     
     Tensor(const std::vector<int>& shape_, const std::vector<float>& data_) 
         : shape(shape_), data(data_) {}
+
+    static Tensor view_of(const std::vector<int>& shape_, const float* data_,
+                          std::shared_ptr<const void> storage_) {
+        Tensor t;
+        t.shape = shape_;
+        t.view = data_;
+        t.storage = std::move(storage_);
+        return t;
+    }
     
     size_t size() const {
         size_t total = 1;
@@ -29,24 +70,114 @@ public:
         return total;
     }
     
-    float* ptr() { return data.data(); }
-    const float* ptr() const { return data.data(); }
+    float* ptr() {
+        if (view) {
+            throw std::logic_error("Tensor: a memory-mapped view is read-only");
+        }
+        return data.data();
+    }
+    const float* ptr() const { return view ? view : data.data(); }
     
     // Access helpers
+    size_t index(int n, int c, int h, int w) const {
+        if (layout == Layout::NCHWc) {
+            int blocks = round_up_channels(shape[1], block) / block;
+            return ((static_cast<size_t>(n * blocks + c / block) * shape[2] + h) * shape[3] + w) * block + c % block;
+        }
+        return ((static_cast<size_t>(n) * shape[1] + c) * shape[2] + h) * shape[3] + w;
+    }
+
+    // Throws on a view, like ptr()
     float& at(int n, int c, int h, int w) {
-        int idx = ((n * shape[1] + c) * shape[2] + h) * shape[3] + w;
-        return data[idx];
+        return ptr()[index(n, c, h, w)];
     }
     
     const float& at(int n, int c, int h, int w) const {
-        int idx = ((n * shape[1] + c) * shape[2] + h) * shape[3] + w;
-        return data[idx];
+        return ptr()[index(n, c, h, w)];
+    }
+};
+
+// Layout conversion. HW is H * W; the NCHWc side holds round_up(C, block)
+// channels and padding channels are written as zeros.
+void nchw_to_nchwc(const float* src, int N, int C, int HW, int block, float* dst);
+void nchwc_to_nchw(const float* src, int N, int C, int HW, int block, float* dst);
+
+Tensor to_nchwc(const Tensor& input, int block);
+Tensor to_nchw(const Tensor& input);
+
+// Weight files
+//
+// LCNN v1: "LCNN", u32 version = 1, u32 count, then per tensor
+//   u32 name_len, name, u32 ndim, u32 dims[ndim], float data[]
+//
+// LCNN v2 (all little-endian):
+//   "LCNN", u32 version = 2, u32 count, u32 alignment (64), u64 toc_size,
+//   toc: per tensor u32 name_len, name, u32 ndim, u32 dims[ndim],
+//        u64 offset (from file start), u64 element count
+//   float payloads, each starting at a multiple of alignment
+//
+// v2 files are memory-mapped and their tensors are views into the mapping,
+// so loading copies nothing and every process on a host shares one copy of
+// the weights in the page cache.
+struct WeightLoadOptions {
+    bool populate = false;   // fault the whole file in at load (MAP_POPULATE)
+    bool huge_pages = false; // ask for transparent huge pages (MADV_HUGEPAGE)
+};
+
+// Read-only mapping of a whole file. Views into it hold the shared_ptr as
+// their `storage`, so it is unmapped with the last tensor using it.
+class MappedFile {
+public:
+    // Logs and returns nullptr if the file cannot be opened or mapped
+    static std::shared_ptr<MappedFile> map(const std::string& path,
+                                           const WeightLoadOptions& options = WeightLoadOptions());
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return static_cast<const uint8_t*>(base_); }
+    size_t size() const { return size_; }
+
+private:
+    MappedFile() = default;
+    void* base_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Bounds-checked little-endian reader over mapped headers
+struct ByteReader {
+    const uint8_t* p;
+    const uint8_t* end;
+
+    size_t remaining() const { return static_cast<size_t>(end - p); }
+
+    template <class T>
+    bool read(T& v) {
+        if (remaining() < sizeof(T)) return false;
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+
+    bool read(std::string& s, size_t length) {
+        if (remaining() < length) return false;
+        s.assign(reinterpret_cast<const char*>(p), length);
+        p += length;
+        return true;
     }
 };
 
-// Weight loader
 class WeightLoader {
 public:
+    static constexpr uint32_t kAlignment = 64;
+
+    // Reads v1 into owned tensors, maps v2 as views
     static bool load(const std::string& path, 
-                    std::vector<std::pair<std::string, Tensor>>& weights);
+                    std::vector<std::pair<std::string, Tensor>>& weights,
+                    const WeightLoadOptions& options = WeightLoadOptions());
+
+    // Writes weights in the LCNN v2 format
+    static bool save(const std::string& path,
+                     const std::vector<std::pair<std::string, const Tensor*>>& weights);
 };
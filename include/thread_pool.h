@@ -0,0 +1,116 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Intra-op parallelism
+//
+// The layer kernels split their work into independent pieces (output
+// channel blocks x spatial tiles) and hand them to parallel_for(). The
+// process-wide pool deals the chunks of each call out to per-thread deques;
+// a thread drains its own deque from the back and, once empty, steals from
+// the front of the others, so uneven tiles (borders, edge blocks) balance
+// out. The calling thread always works too, which makes nested calls and
+// concurrent calls from several request threads safe.
+namespace parallel {
+
+class ThreadPool {
+public:
+    // threads: total participants including the caller; 1 runs inline
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int threads() const { return static_cast<int>(queues_.size()); }
+
+    // Calls fn(ctx, begin, end) over chunks of [0, count) and returns once
+    // all of them ran. fn must not throw.
+    void run(int count, int grain, void (*fn)(void*, int, int), void* ctx);
+
+private:
+    struct Job {
+        void (*fn)(void*, int, int);
+        void* ctx;
+        std::atomic<int> pending;
+    };
+    struct Task {
+        Job* job;
+        int begin;
+        int end;
+    };
+    // Growable ring buffer; only reallocates when a call deals out more
+    // chunks than it has ever held
+    struct Queue {
+        std::mutex mutex;
+        std::vector<Task> ring;
+        size_t head = 0;
+        size_t tail = 0;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<int> queued_{0};
+    std::atomic<unsigned> next_queue_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+
+    void worker_loop(int index);
+    void push(int queue, const Task& task);
+    // Runs one task: own queue first (newest), then steals (oldest)
+    bool run_one(int home);
+};
+
+// Process-wide pool used by the kernels; defaults to one thread.
+// Resize only while no inference is running (e.g. at startup).
+void set_num_threads(int threads);
+int num_threads();
+ThreadPool& pool();
+
+// Calls fn(begin, end) over chunks of [0, count) of at least `grain` items
+template <class F>
+void parallel_for(int count, F&& fn, int grain = 1) {
+    if (count <= 0) {
+        return;
+    }
+    ThreadPool& p = pool();
+    if (p.threads() == 1 || count <= grain) {
+        fn(0, count);
+        return;
+    }
+    using Fn = std::remove_reference_t<F>;
+    p.run(count, grain, [](void* ctx, int begin, int end) { (*static_cast<Fn*>(ctx))(begin, end); },
+          const_cast<void*>(static_cast<const void*>(&fn)));
+}
+
+// Runs fn(item, begin, end) over `items` independent work items of `extent`
+// rows or pixels each. Items are cut into tiles (multiples of `multiple`)
+// until every thread has a few pieces, so a layer with only a couple of
+// channel blocks still spreads across the pool.
+template <class F>
+void parallel_for_tiles(int items, int extent, int multiple, F&& fn) {
+    if (items <= 0 || extent <= 0) {
+        return;
+    }
+    int max_tiles = (extent + multiple - 1) / multiple;
+    int wanted = (4 * num_threads() + items - 1) / items;
+    int tiles = num_threads() == 1 ? 1 : std::min(max_tiles, std::max(1, wanted));
+    int tile = ((extent + tiles - 1) / tiles + multiple - 1) / multiple * multiple;
+    tiles = (extent + tile - 1) / tile;
+
+    parallel_for(items * tiles, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            int t = i % tiles;
+            fn(i / tiles, t * tile, std::min(extent, (t + 1) * tile));
+        }
+    });
+}
+
+} // namespace parallel
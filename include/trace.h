@@ -0,0 +1,71 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Execution tracing
+//
+// A Recorder collects timed spans (per plan step inside forward(), per
+// stage in the server) and exports them as Chrome trace-event JSON, which
+// chrome://tracing and ui.perfetto.dev open directly. Nothing is recorded
+// unless a recorder is attached: every instrumentation point is a single
+// null check when tracing is off.
+namespace trace {
+
+// Monotonic clock (steady_clock) in nanoseconds
+uint64_t now_ns();
+inline uint64_t to_ns(std::chrono::steady_clock::time_point t) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count());
+}
+// Small stable id of the calling thread (1, 2, ... in order of first use)
+int thread_id();
+
+struct Event {
+    std::string name;
+    const char* category;
+    uint64_t begin_ns;
+    uint64_t end_ns;
+    int tid;
+    std::string args; // JSON object members without braces, may be empty
+};
+
+// Not thread-safe: one recorder is written by one thread at a time
+class Recorder {
+public:
+    void add(const char* name, const char* category, uint64_t begin_ns, uint64_t end_ns,
+             std::string args = std::string(), int tid = thread_id());
+    void append(const Recorder& other);
+
+    const std::vector<Event>& events() const { return events_; }
+    bool empty() const { return events_.empty(); }
+
+    // {"traceEvents": [...]} with timestamps relative to the earliest event
+    std::string to_json() const;
+
+private:
+    std::vector<Event> events_;
+};
+
+// Records its lifetime as one span when recorder is set
+class Scope {
+public:
+    Scope(Recorder* recorder, const char* name, const char* category)
+        : recorder_(recorder), name_(name), category_(category),
+          begin_(recorder ? now_ns() : 0) {}
+    ~Scope() {
+        if (recorder_) recorder_->add(name_, category_, begin_, now_ns());
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    Recorder* recorder_;
+    const char* name_;
+    const char* category_;
+    uint64_t begin_;
+};
+
+} // namespace trace
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Binary protocol of the Unix domain socket listener, shared by the server
+// and the client library. Frames follow each other on one connection;
+// integers are little-endian.
+//
+//   request:  u32 image_size | u16 top_k | u16 reserved (0) | image bytes
+//   response: u32 status | u32 count | payload
+//             status Ok:   count x (u32 class_id, f32 score), best first
+//             otherwise:   count bytes of UTF-8 error message
+namespace unix_protocol {
+
+constexpr size_t kRequestHeaderSize = 8;
+constexpr size_t kResponseHeaderSize = 8;
+constexpr size_t kPredictionSize = 8;
+constexpr uint32_t kMaxImageSize = 64u << 20;
+constexpr int kMaxTopK = 1000;
+
+enum Status : uint32_t {
+    Ok = 0,
+    BadRequest = 1,  // empty or oversized image, top_k out of range
+    ServerError = 2, // undecodable image or inference failure
+};
+
+inline void put_u16(uint8_t* p, uint16_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+inline void put_u32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        p[i] = static_cast<uint8_t>(v >> (8 * i));
+    }
+}
+
+inline uint16_t get_u16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline uint32_t get_u32(const uint8_t* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) {
+        v |= static_cast<uint32_t>(p[i]) << (8 * i);
+    }
+    return v;
+}
+
+} // namespace unix_protocol
@@ -0,0 +1,56 @@
+#pragma once
+#include "unix_protocol.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Unix domain socket listener speaking unix_protocol.h. For colocated
+// clients: no HTTP framing, no multipart, no JSON. Each connection gets a
+// thread that reads request frames, calls the handler and writes the
+// packed reply; the handler does the actual (shared, batched) inference.
+// At most kMaxConnections are served at once; further clients wait in the
+// listen backlog until one hangs up.
+class UnixSocketServer {
+public:
+    static constexpr size_t kMaxConnections = 64;
+
+    struct Reply {
+        unix_protocol::Status status = unix_protocol::Ok;
+        std::vector<std::pair<int, float>> predictions;
+        std::string error;
+    };
+    // received: when the first byte of the frame arrived
+    using Handler = std::function<Reply(const std::string& image, int top_k,
+                                        std::chrono::steady_clock::time_point received)>;
+
+    // Binds `path` (replacing a stale socket file) and starts accepting;
+    // throws if it cannot
+    UnixSocketServer(const std::string& path, Handler handler);
+    // Stops accepting, closes every connection and removes the socket file
+    ~UnixSocketServer();
+
+    UnixSocketServer(const UnixSocketServer&) = delete;
+    UnixSocketServer& operator=(const UnixSocketServer&) = delete;
+
+private:
+    std::string path_;
+    Handler handler_;
+    int listener_ = -1;
+    std::atomic<bool> stopping_{false};
+    std::thread acceptor_;
+
+    std::mutex mutex_;
+    std::condition_variable closed_; // a connection ended, or stopping
+    std::vector<std::pair<int, std::thread>> connections_; // fd, its thread
+    size_t active_ = 0; // connections whose thread has not finished
+
+    void accept_loop();
+    void serve(int fd);
+};
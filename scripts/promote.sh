@@ -72,18 +72,19 @@ create_backup() {
 perform_promotion() {
     log "🚀 TO-BE → AS-IS 승격 수행 중..."
     
-    # TO-BE 모델을 AS-IS로 복사
+    # TO-BE 모델을 AS-IS로 복사 (서버가 mmap 중인 파일을 덮어쓰지 않도록 rename으로 교체)
     if [ -f "$WEIGHTS_DIR/model_8892.bin" ]; then
-        cp "$WEIGHTS_DIR/model_8892.bin" "$WEIGHTS_DIR/model_8891.bin"
+        cp "$WEIGHTS_DIR/model_8892.bin" "$WEIGHTS_DIR/model_8891.bin.tmp"
+        mv "$WEIGHTS_DIR/model_8891.bin.tmp" "$WEIGHTS_DIR/model_8891.bin"
         log "✅ 모델 파일 승격 완료"
     else
         error "TO-BE 모델 파일이 없습니다."
         return 1
     fi
     
-    # AS-IS 서버 재시작
-    log "🔄 AS-IS 서버 재시작 중..."
-    "$SCRIPT_DIR/server_manager.sh" restart 8891
+    # AS-IS 서버 핫 리로드 (무중단)
+    log "🔄 AS-IS 서버 모델 리로드 중..."
+    "$SCRIPT_DIR/server_manager.sh" reload 8891
     
     log "✅ 승격 완료!"
 }
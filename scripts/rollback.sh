@@ -65,13 +65,14 @@ perform_rollback() {
         info "현재 모델 임시 백업: $(basename "$temp_backup")"
     fi
     
-    # 백업 파일로 복원
-    cp "$backup_file" "$WEIGHTS_DIR/model_8891.bin"
+    # 백업 파일로 복원 (서버가 mmap 중인 파일을 덮어쓰지 않도록 rename으로 교체)
+    cp "$backup_file" "$WEIGHTS_DIR/model_8891.bin.tmp"
+    mv "$WEIGHTS_DIR/model_8891.bin.tmp" "$WEIGHTS_DIR/model_8891.bin"
     log "✅ 모델 파일 복원 완료"
     
-    # AS-IS 서버 재시작
-    log "🔄 AS-IS 서버 재시작 중..."
-    "$SCRIPT_DIR/server_manager.sh" restart 8891
+    # AS-IS 서버 핫 리로드 (무중단)
+    log "🔄 AS-IS 서버 모델 리로드 중..."
+    "$SCRIPT_DIR/server_manager.sh" reload 8891
     
     log "✅ 롤백 완료!"
 }
@@ -1,6 +1,6 @@
 #!/usr/bin/env bash
 # 듀얼 서버 관리 스크립트
-# 사용법: ./scripts/server_manager.sh [start|stop|restart|status] [8891|8892|all]
+# 사용법: ./scripts/server_manager.sh [start|stop|restart|reload|status] [8891|8892|all]
 
 set -e
 
@@ -108,6 +108,26 @@ stop_server() {
     fi
 }
 
+# 가중치 핫 리로드 (재시작 없이, 처리 중인 요청은 기존 모델로 완료)
+reload_server() {
+    local port=$1
+    
+    if ! check_server $port; then
+        warn "포트 $port 서버가 실행 중이 아닙니다. 시작합니다."
+        start_server $port
+        return
+    fi
+    
+    log "포트 $port 모델 리로드 중..."
+    # /admin/reload 는 루프백 클라이언트만 받으므로 서버와 같은 호스트에서 실행
+    local result=$(curl -s -X POST "http://127.0.0.1:$port/admin/reload")
+    if echo "$result" | grep -q '"status":"ok"'; then
+        log "✅ 포트 $port 리로드 완료: $result"
+    else
+        error "포트 $port 리로드 실패 (기존 모델 유지): $result"
+    fi
+}
+
 # 서버 상태 출력
 status_server() {
     local port=$1
@@ -169,6 +189,15 @@ case "$ACTION" in
         fi
         ;;
     
+    reload)
+        if [ "$TARGET" == "all" ]; then
+            reload_server 8891
+            reload_server 8892
+        else
+            reload_server $TARGET
+        fi
+        ;;
+    
     status)
         info "=== LiteCNN 서버 상태 ==="
         echo ""
@@ -185,12 +214,13 @@ case "$ACTION" in
         ;;
     
     *)
-        echo "사용법: $0 [start|stop|restart|status] [8891|8892|all]"
+        echo "사용법: $0 [start|stop|restart|reload|status] [8891|8892|all]"
         echo ""
         echo "예시:"
         echo "  $0 start all          # 모든 서버 시작"
         echo "  $0 stop 8892          # TO-BE 서버만 중지"
         echo "  $0 restart 8891       # AS-IS 서버 재시작"
+        echo "  $0 reload 8891        # AS-IS 가중치 핫 리로드 (무중단)"
         echo "  $0 status             # 모든 서버 상태 확인"
         exit 1
         ;;
@@ -0,0 +1,219 @@
+#include "batcher.h"
+#include <algorithm>
+
+Batcher::Batcher(std::shared_ptr<const LiteCNNPro> model, const BatchOptions& options)
+    : model_(std::move(model)), options_(options) {
+    options_.max_batch = std::max(options_.max_batch, 1);
+    options_.max_wait_us = std::max(options_.max_wait_us, 0);
+    if (options_.max_batch == 1) {
+        return; // requests run on their own thread
+    }
+    for (int i = 0; i < std::max(options_.workers, 1); ++i) {
+        workers_.emplace_back(&Batcher::worker_loop, this);
+    }
+}
+
+Batcher::~Batcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (std::thread& t : workers_) {
+        t.join();
+    }
+}
+
+namespace {
+
+// Elements of one [1, C, H, W] sample
+size_t sample_size(const std::vector<int>& shape) {
+    if (shape.size() != 4 || shape[0] != 1) {
+        throw std::runtime_error("Batcher expects a single [1, C, H, W] input");
+    }
+    return static_cast<size_t>(shape[1]) * shape[2] * shape[3];
+}
+
+} // namespace
+
+std::vector<float> Batcher::predict(const Tensor& input) {
+    return predict(input.shape, input.ptr());
+}
+
+std::vector<float> Batcher::predict(const std::vector<int>& shape, const InputWriter& write,
+                                    BatchTimings* timings, trace::Recorder* trace) {
+    size_t size = sample_size(shape);
+    if (workers_.empty()) {
+        return run_inline(shape, write, timings, trace);
+    }
+    thread_local std::vector<float> sample;
+    sample.resize(size);
+    write(sample.data());
+    return predict(shape, sample.data(), timings, trace);
+}
+
+std::vector<float> Batcher::predict(const std::vector<int>& shape, const float* sample,
+                                    BatchTimings* timings, trace::Recorder* trace) {
+    size_t size = sample_size(shape);
+    if (workers_.empty()) {
+        return run_inline(shape, [sample, size](float* slot) { std::copy(sample, sample + size, slot); },
+                          timings, trace);
+    }
+
+    Request request{std::atomic_load(&model_), &shape, sample, Clock::now(), timings, trace, {}};
+    std::future<std::vector<float>> result = request.result.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(&request);
+    }
+    cv_.notify_all();
+    return result.get();
+}
+
+std::vector<float> Batcher::run_inline(const std::vector<int>& shape, const InputWriter& write,
+                                       BatchTimings* timings, trace::Recorder* trace) {
+    std::shared_ptr<const LiteCNNPro> model = std::atomic_load(&model_);
+    thread_local Tensor input;
+    thread_local Tensor output;
+    thread_local ExecutionContext context;
+    if (input.shape != shape) {
+        input = Tensor(shape);
+    }
+    write(input.ptr());
+    uint64_t start = trace::now_ns();
+    context.set_trace(trace);
+    try {
+        model->forward(input, output, context);
+    } catch (...) {
+        context.set_trace(nullptr);
+        throw;
+    }
+    context.set_trace(nullptr);
+    uint64_t end = trace::now_ns();
+    if (timings) {
+        timings->forward = std::chrono::nanoseconds(end - start);
+        timings->batch_size = 1;
+    }
+    if (trace) {
+        trace->add("forward", "stage", start, end, "\"batch\":1");
+    }
+    return output.data;
+}
+
+size_t Batcher::queue_depth() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+void Batcher::set_model(std::shared_ptr<const LiteCNNPro> model) {
+    std::atomic_store(&model_, std::move(model));
+}
+
+std::shared_ptr<const LiteCNNPro> Batcher::model() const {
+    return std::atomic_load(&model_);
+}
+
+void Batcher::worker_loop() {
+    // Batch buffers and the execution context are reused, so steady-state
+    // batches of the same size do not allocate
+    Tensor input;
+    Tensor output;
+    ExecutionContext context;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            return; // stopping and drained
+        }
+
+        auto deadline = queue_.front()->arrival + std::chrono::microseconds(options_.max_wait_us);
+        cv_.wait_until(lock, deadline, [this] {
+            return stopping_ || queue_.empty() ||
+                   queue_.size() >= static_cast<size_t>(options_.max_batch);
+        });
+        if (queue_.empty()) {
+            continue; // another worker took it
+        }
+
+        std::vector<Request*> batch = take_batch();
+        lock.unlock();
+        run_batch(batch, input, output, context);
+        lock.lock();
+    }
+}
+
+std::vector<Batcher::Request*> Batcher::take_batch() {
+    const std::vector<int>& shape = *queue_.front()->shape;
+    const LiteCNNPro* model = queue_.front()->model.get();
+    std::vector<Request*> batch;
+    for (auto it = queue_.begin(); it != queue_.end() &&
+                                   batch.size() < static_cast<size_t>(options_.max_batch);) {
+        if ((*it)->model.get() == model && *(*it)->shape == shape) {
+            batch.push_back(*it);
+            it = queue_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return batch;
+}
+
+void Batcher::run_batch(const std::vector<Request*>& batch, Tensor& input, Tensor& output,
+                        ExecutionContext& context) {
+    Clock::time_point start = Clock::now();
+    // Layer spans of a traced request's batch are recorded once and
+    // copied to every traced request in it
+    bool traced = std::any_of(batch.begin(), batch.end(), [](Request* r) { return r->trace; });
+    trace::Recorder batch_trace;
+
+    size_t done = 0;
+    // Everything that can throw, allocating the batch input included, is in
+    // here: the requests get the error instead of the worker terminating
+    try {
+        std::vector<int> shape = *batch.front()->shape;
+        size_t image = 1;
+        for (size_t d = 1; d < shape.size(); ++d) {
+            image *= shape[d];
+        }
+        shape[0] = static_cast<int>(batch.size());
+        if (input.shape != shape) {
+            input = Tensor(shape);
+        }
+        for (size_t i = 0; i < batch.size(); ++i) {
+            std::copy(batch[i]->sample, batch[i]->sample + image, input.ptr() + i * image);
+        }
+
+        context.set_trace(traced ? &batch_trace : nullptr);
+        Clock::time_point forward_start = Clock::now();
+        batch.front()->model->forward(input, output, context);
+        Clock::time_point forward_end = Clock::now();
+        context.set_trace(nullptr);
+        if (traced) {
+            batch_trace.add("forward", "stage", trace::to_ns(forward_start), trace::to_ns(forward_end),
+                            "\"batch\":" + std::to_string(batch.size()));
+        }
+        for (Request* request : batch) {
+            if (request->timings) {
+                request->timings->queue = start - request->arrival;
+                request->timings->forward = forward_end - forward_start;
+                request->timings->batch_size = static_cast<int>(batch.size());
+            }
+            if (request->trace) {
+                request->trace->add("queue", "stage", trace::to_ns(request->arrival), trace::to_ns(start));
+                request->trace->append(batch_trace);
+            }
+        }
+
+        size_t classes = output.shape[1];
+        for (; done < batch.size(); ++done) {
+            auto row = output.data.begin() + done * classes;
+            batch[done]->result.set_value(std::vector<float>(row, row + classes));
+        }
+    } catch (...) {
+        context.set_trace(nullptr);
+        for (; done < batch.size(); ++done) {
+            batch[done]->result.set_exception(std::current_exception());
+        }
+    }
+}
@@ -0,0 +1,518 @@
+#include "model.h"
+#include "layers.h"
+#include "preprocess.h"
+#include "thread_pool.h"
+#include "../third_party/json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Per-layer microbenchmarks: every kernel of the compiled plan timed in
+// isolation at the real LiteCNN shapes, plus preprocessing and whole
+// forward() passes. Results can be written as JSON and compared against a
+// stored baseline to catch regressions.
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Case {
+    std::string name;
+    double flops; // per op, 0 if not meaningful
+    double bytes; // minimum memory traffic per op (inputs + weights + outputs)
+    std::function<void()> run;
+};
+
+struct Result {
+    std::string name;
+    double median_ns = 0.0;
+    double mean_ns = 0.0;
+    double stddev_ns = 0.0;
+    double min_ns = 0.0;
+    double gflops = 0.0;
+    double gbs = 0.0;
+    long iterations = 0;
+    int samples = 0;
+};
+
+struct Options {
+    int samples = 10;
+    double min_sample_ms = 20.0;
+    int threads = 1;
+    std::string filter;
+    std::string weights_path;
+    std::string json_path;
+    std::string baseline_path;
+    double threshold_pct = 10.0;
+};
+
+bool selected(const Options& options, const std::string& name) {
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+// Keeps buffers alive for the lifetime of the cases that use them; deques
+// so the references the cases hold stay valid as more are added
+struct Buffers {
+    std::deque<std::vector<float>> floats;
+    std::deque<Tensor> tensors;
+    std::deque<gemm::PackedMatrix> packed;
+
+    float* make(size_t count, std::mt19937& rng) {
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        floats.emplace_back(count);
+        for (float& v : floats.back()) v = dist(rng);
+        return floats.back().data();
+    }
+
+    Tensor& tensor(const std::vector<int>& shape, std::mt19937& rng, float lo = -1.0f, float hi = 1.0f) {
+        std::uniform_real_distribution<float> dist(lo, hi);
+        tensors.emplace_back(shape);
+        for (float& v : tensors.back().data) v = dist(rng);
+        return tensors.back();
+    }
+};
+
+Result measure(const Case& c, const Options& options) {
+    // Warm up, then size each sample to take at least min_sample_ms
+    c.run();
+    long iterations = 1;
+    while (true) {
+        auto start = Clock::now();
+        for (long i = 0; i < iterations; ++i) c.run();
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (ms >= options.min_sample_ms || iterations >= (1L << 30)) {
+            break;
+        }
+        iterations = ms <= 0.0 ? iterations * 10
+                               : std::max(iterations + 1, static_cast<long>(iterations * options.min_sample_ms / ms * 1.1));
+    }
+
+    std::vector<double> ns;
+    for (int s = 0; s < options.samples; ++s) {
+        auto start = Clock::now();
+        for (long i = 0; i < iterations; ++i) c.run();
+        ns.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations);
+    }
+
+    Result r;
+    r.name = c.name;
+    r.iterations = iterations;
+    r.samples = static_cast<int>(ns.size());
+    std::vector<double> sorted = ns;
+    std::sort(sorted.begin(), sorted.end());
+    size_t n = sorted.size();
+    r.median_ns = n % 2 ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+    r.min_ns = sorted.front();
+    for (double v : ns) r.mean_ns += v;
+    r.mean_ns /= n;
+    for (double v : ns) r.stddev_ns += (v - r.mean_ns) * (v - r.mean_ns);
+    r.stddev_ns = n > 1 ? std::sqrt(r.stddev_ns / (n - 1)) : 0.0;
+    r.gflops = c.flops / r.median_ns;
+    r.gbs = c.bytes / r.median_ns;
+    return r;
+}
+
+// LiteCNN layer shapes (see LiteCNNPro::compile)
+constexpr int kBlocks = 7;
+const int kBlockIn[kBlocks] = {32, 64, 128, 256, 256, 512, 512};
+const int kBlockOut[kBlocks] = {64, 128, 256, 256, 512, 512, 512};
+const int kBlockStride[kBlocks] = {2, 1, 2, 1, 2, 1, 2};
+constexpr int kStemChannels = 32;
+constexpr int kSeReduction = 16;
+constexpr int kHidden = 256;
+constexpr int kClasses = 120;
+
+// Random weights with the real tensor names and shapes, written as an LCNN
+// file so forward() can be timed without a trained model
+std::string write_synthetic_weights(std::mt19937& rng) {
+    std::vector<std::pair<std::string, Tensor>> weights;
+    auto add = [&](const std::string& name, const std::vector<int>& shape, float lo, float hi) {
+        std::uniform_real_distribution<float> dist(lo, hi);
+        Tensor t(shape);
+        for (float& v : t.data) v = dist(rng);
+        weights.emplace_back(name, std::move(t));
+    };
+    auto bn = [&](const std::string& prefix, int c) {
+        add(prefix + ".weight", {c}, 0.5f, 1.5f);
+        add(prefix + ".bias", {c}, -0.1f, 0.1f);
+        add(prefix + ".running_mean", {c}, -0.1f, 0.1f);
+        add(prefix + ".running_var", {c}, 0.5f, 1.5f);
+    };
+
+    add("stem.0.weight", {kStemChannels, 3, 3, 3}, -0.3f, 0.3f);
+    bn("stem.1", kStemChannels);
+    for (int i = 0; i < kBlocks; ++i) {
+        std::string p = "features." + std::to_string(i);
+        int cin = kBlockIn[i], cout = kBlockOut[i];
+        add(p + ".depthwise.weight", {cin, 1, 3, 3}, -0.5f, 0.5f);
+        bn(p + ".bn1", cin);
+        add(p + ".pointwise.weight", {cout, cin, 1, 1}, -0.1f, 0.1f);
+        bn(p + ".bn2", cout);
+        add(p + ".se.excitation.0.weight", {cout / kSeReduction, cout}, -0.1f, 0.1f);
+        add(p + ".se.excitation.2.weight", {cout, cout / kSeReduction}, -0.3f, 0.3f);
+    }
+    add("classifier.2.weight", {kHidden, kBlockOut[kBlocks - 1]}, -0.1f, 0.1f);
+    add("classifier.2.bias", {kHidden}, -0.1f, 0.1f);
+    add("classifier.5.weight", {kClasses, kHidden}, -0.1f, 0.1f);
+    add("classifier.5.bias", {kClasses}, -0.1f, 0.1f);
+
+    std::vector<std::pair<std::string, const Tensor*>> refs;
+    for (const auto& w : weights) refs.emplace_back(w.first, &w.second);
+    std::string path = (std::filesystem::temp_directory_path() / "litecnn_bench_weights.bin").string();
+    if (!WeightLoader::save(path, refs)) {
+        throw std::runtime_error("Failed to write synthetic weights to " + path);
+    }
+    return path;
+}
+
+int round_up(int c, int block) {
+    return (c + block - 1) / block * block;
+}
+
+void add_layer_cases(std::vector<Case>& cases, Buffers& buf, std::mt19937& rng, double& forward_flops) {
+    const int B = kChannelBlock;
+    const double f = sizeof(float);
+
+    // Stem: im2col + GEMM, as run by the plan (NCHW float output)
+    {
+        int H = conv_out_size(kInputSize, 3, 2, 1);
+        Tensor& w = buf.tensor({kStemChannels, 3 * 3 * 3}, rng);
+        buf.packed.emplace_back(w.ptr(), kStemChannels, 27, 27);
+        const gemm::PackedMatrix& packed = buf.packed.back();
+        const float* in = buf.make(3 * kInputSize * kInputSize, rng);
+        const float* bias = buf.make(kStemChannels, rng);
+        float* out = buf.make(static_cast<size_t>(kStemChannels) * H * H, rng);
+        float* col = buf.make(conv2d_col_size(3, kInputSize, kInputSize, 3, 3, 2, 1), rng);
+        double flops = 2.0 * kStemChannels * 27 * H * H;
+        forward_flops += flops;
+        cases.push_back({"conv.stem", flops,
+                         f * (3.0 * kInputSize * kInputSize + kStemChannels * 27 + kStemChannels * H * H),
+                         [=, &packed] {
+                             conv2d_packed_into(in, 1, 3, kInputSize, kInputSize, packed, 3, 3, 2, 1,
+                                                bias, true, out, col);
+                         }});
+
+        // The stem's BatchNorm as the unfused reference layer
+        Tensor& x = buf.tensor({1, kStemChannels, H, H}, rng);
+        Tensor& g = buf.tensor({kStemChannels}, rng, 0.5f, 1.5f);
+        Tensor& b = buf.tensor({kStemChannels}, rng);
+        Tensor& m = buf.tensor({kStemChannels}, rng);
+        Tensor& v = buf.tensor({kStemChannels}, rng, 0.5f, 1.5f);
+        double elems = static_cast<double>(x.data.size());
+        cases.push_back({"batchnorm2d.stem", 4.0 * elems, f * 2.0 * elems,
+                         [&] { batchnorm2d(x, g, b, m, v); }});
+    }
+
+    int H = conv_out_size(kInputSize, 3, 2, 1);
+    for (int i = 0; i < kBlocks; ++i) {
+        int cin = kBlockIn[i], cout = kBlockOut[i];
+        int Ho = conv_out_size(H, 3, kBlockStride[i], 1);
+        int HW_in = H * H, HW = Ho * Ho;
+        std::string idx = std::to_string(i);
+
+        // Depthwise 3x3, NCHWc
+        {
+            Tensor& w = buf.tensor({cin, 1, 3, 3}, rng);
+            buf.tensors.push_back(pack_depthwise_weight_nchwc(w));
+            const float* packed = buf.tensors.back().ptr();
+            const float* bias = buf.make(round_up(cin, B), rng);
+            const float* in = buf.make(static_cast<size_t>(round_up(cin, B)) * HW_in, rng);
+            float* out = buf.make(static_cast<size_t>(round_up(cin, B)) * HW, rng);
+            int stride = kBlockStride[i];
+            int h = H;
+            double flops = 2.0 * cin * 9 * HW;
+            forward_flops += flops;
+            cases.push_back({"conv.dw." + idx, flops, f * (cin * (HW_in + 9.0 + HW)),
+                             [=] {
+                                 depthwise_conv_nchwc_into(in, 1, cin, h, h, packed, 3, stride, 1,
+                                                           bias, true, out);
+                             }});
+        }
+
+        // Pointwise 1x1, NCHWc
+        {
+            Tensor& w = buf.tensor({cout, cin, 1, 1}, rng);
+            buf.tensors.push_back(pack_pointwise_weight_nchwc(w));
+            const float* packed = buf.tensors.back().ptr();
+            const float* bias = buf.make(round_up(cout, B), rng);
+            const float* in = buf.make(static_cast<size_t>(round_up(cin, B)) * HW, rng);
+            float* out = buf.make(static_cast<size_t>(round_up(cout, B)) * HW, rng);
+            double flops = 2.0 * cin * cout * HW;
+            forward_flops += flops;
+            cases.push_back({"conv.pw." + idx, flops,
+                             f * (static_cast<double>(cin) * HW + static_cast<double>(cin) * cout + cout * HW),
+                             [=] {
+                                 pointwise_conv_nchwc_into(in, 1, cin, cout, HW, packed, bias, true, out);
+                             }});
+        }
+
+        // Squeeze-excitation, in place on the NCHWc activation
+        {
+            int hidden = cout / kSeReduction;
+            Tensor& fc1 = buf.tensor({hidden, cout}, rng, -0.1f, 0.1f);
+            Tensor& fc2 = buf.tensor({cout, hidden}, rng, -0.3f, 0.3f);
+            float* x = buf.make(static_cast<size_t>(round_up(cout, B)) * HW, rng);
+            float* scratch = buf.make(se_block_nchwc_scratch_size(1, cout, fc1), rng);
+            double flops = 2.0 * cout * HW + 4.0 * cout * hidden;
+            forward_flops += flops;
+            cases.push_back({"se_block." + idx, flops, f * (2.0 * cout * HW + 2.0 * cout * hidden),
+                             [=, &fc1, &fc2] {
+                                 se_block_nchwc_inplace(x, 1, cout, HW, fc1, fc2, scratch);
+                             }});
+        }
+        H = Ho;
+    }
+
+    // Global pooling of the last feature map (reference NCHW layer)
+    {
+        int C = kBlockOut[kBlocks - 1];
+        Tensor& x = buf.tensor({1, C, H, H}, rng);
+        double elems = static_cast<double>(x.data.size());
+        forward_flops += elems;
+        cases.push_back({"adaptive_avg_pool2d", elems, f * (elems + C),
+                         [&] { adaptive_avg_pool2d(x, 1, 1); }});
+    }
+
+    // Classifier
+    const int fc_in[] = {kBlockOut[kBlocks - 1], kHidden};
+    const int fc_out[] = {kHidden, kClasses};
+    const char* fc_names[] = {"linear.classifier.2", "linear.classifier.5"};
+    for (int i = 0; i < 2; ++i) {
+        int in_f = fc_in[i], out_f = fc_out[i];
+        bool relu6 = i == 0;
+        Tensor& w = buf.tensor({out_f, in_f}, rng);
+        const float* bias = buf.make(out_f, rng);
+        const float* in = buf.make(in_f, rng);
+        float* out = buf.make(out_f, rng);
+        double flops = 2.0 * in_f * out_f;
+        forward_flops += flops;
+        cases.push_back({fc_names[i], flops, f * (in_f + static_cast<double>(in_f) * out_f + out_f),
+                         [=, &w] { linear_into(in, 1, in_f, w, bias, relu6, out); }});
+    }
+}
+
+void add_preprocess_cases(std::vector<Case>& cases, Buffers& buf, std::mt19937& rng) {
+    // Fused resize + normalize from the decoded sizes uploads typically
+    // reach after DCT-domain reduction, and from a full-size decode
+    const int sizes[][2] = {{504, 378}, {1600, 1200}};
+    for (const auto& s : sizes) {
+        int w = s[0], h = s[1];
+        auto pixels = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(w) * h * 3);
+        std::uniform_int_distribution<int> dist(0, 255);
+        for (uint8_t& v : *pixels) v = static_cast<uint8_t>(dist(rng));
+        DecodedImage image;
+        image.width = w;
+        image.height = h;
+        image.rgb = pixels->data();
+        image.storage = pixels;
+        float* out = buf.make(3 * kInputSize * kInputSize, rng);
+        cases.push_back({"preprocess." + std::to_string(w) + "x" + std::to_string(h), 0.0,
+                         static_cast<double>(pixels->size()) + sizeof(float) * 3.0 * kInputSize * kInputSize,
+                         [image, out] { resize_normalize_into(image, out); }});
+    }
+}
+
+void add_forward_cases(std::vector<Case>& cases, std::vector<std::unique_ptr<LiteCNNPro>>& models,
+                       Buffers& buf, std::mt19937& rng, const Options& options,
+                       double forward_flops) {
+    struct Config {
+        const char* name;
+        Precision precision;
+        int batch;
+    };
+    const Config configs[] = {
+        {"forward.fp32.b1", Precision::FP32, 1},
+        {"forward.fp32.b8", Precision::FP32, 8},
+        {"forward.fp16.b1", Precision::FP16, 1},
+        {"forward.bf16.b1", Precision::BF16, 1},
+    };
+    bool any = false;
+    for (const Config& config : configs) {
+        any = any || selected(options, config.name);
+    }
+    if (!any) {
+        return;
+    }
+
+    std::string weights_path = options.weights_path;
+    bool synthetic = weights_path.empty();
+    if (synthetic) {
+        weights_path = write_synthetic_weights(rng);
+    }
+    for (const Config& config : configs) {
+        if (!selected(options, config.name)) {
+            continue;
+        }
+        auto model = std::make_unique<LiteCNNPro>();
+        model->set_precision(config.precision);
+        if (!model->load_weights(weights_path)) {
+            throw std::runtime_error("Failed to load " + weights_path);
+        }
+        const LiteCNNPro* m = model.get();
+        models.push_back(std::move(model));
+
+        Tensor& input = buf.tensor({config.batch, 3, kInputSize, kInputSize}, rng, -2.0f, 2.0f);
+        auto output = std::make_shared<Tensor>();
+        auto context = std::make_shared<ExecutionContext>();
+        cases.push_back({config.name, forward_flops * config.batch,
+                         sizeof(float) * (static_cast<double>(input.data.size()) + kClasses * config.batch),
+                         [m, &input, output, context] { m->forward(input, *output, *context); }});
+    }
+    if (synthetic) {
+        std::filesystem::remove(weights_path); // LCNN v2 weights stay mapped
+    }
+}
+
+void print_result(const Result& r, const json* baseline) {
+    char line[256];
+    char gflops[32] = "-";
+    if (r.gflops > 0.0) {
+        std::snprintf(gflops, sizeof(gflops), "%.2f", r.gflops);
+    }
+    std::snprintf(line, sizeof(line), "%-24s %12.0f ns  +-%5.1f%%  %8s GFLOP/s  %7.2f GB/s",
+                  r.name.c_str(), r.median_ns, r.mean_ns > 0 ? 100.0 * r.stddev_ns / r.mean_ns : 0.0,
+                  gflops, r.gbs);
+    std::cout << line;
+    if (baseline && baseline->contains(r.name)) {
+        double base = (*baseline)[r.name].get<double>();
+        std::snprintf(line, sizeof(line), "  %+6.1f%% vs baseline", 100.0 * (r.median_ns / base - 1.0));
+        std::cout << line;
+    }
+    std::cout << "\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--samples" && i + 1 < argc) {
+            options.samples = std::max(std::atoi(argv[++i]), 1);
+        } else if (arg == "--min-time-ms" && i + 1 < argc) {
+            options.min_sample_ms = std::max(std::atof(argv[++i]), 0.1);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = std::atoi(argv[++i]);
+        } else if (arg == "--weights" && i + 1 < argc) {
+            options.weights_path = argv[++i];
+        } else if (arg == "--json" && i + 1 < argc) {
+            options.json_path = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            options.baseline_path = argv[++i];
+        } else if (arg == "--threshold" && i + 1 < argc) {
+            options.threshold_pct = std::atof(argv[++i]);
+        } else if (arg == "--help") {
+            std::cout << "Usage: " << argv[0] << " [options]\n"
+                      << "Options:\n"
+                      << "  --filter TEXT      Only run benchmarks whose name contains TEXT\n"
+                      << "  --samples N        Timed samples per benchmark (default: 10)\n"
+                      << "  --min-time-ms MS   Minimum duration of one sample (default: 20)\n"
+                      << "  --threads N        Intra-op threads (default: 1)\n"
+                      << "  --weights PATH     Weights for forward() (default: random, real shapes)\n"
+                      << "  --json PATH        Write results as JSON\n"
+                      << "  --baseline PATH    Compare medians against an earlier --json file;\n"
+                      << "                     exits with 2 if any is slower by more than --threshold\n"
+                      << "  --threshold PCT    Allowed slowdown vs the baseline (default: 10)\n"
+                      << "  --help             Show this help\n";
+            return 0;
+        }
+    }
+
+    try {
+        parallel::set_num_threads(options.threads);
+        std::mt19937 rng(42);
+
+        json baseline;
+        if (!options.baseline_path.empty()) {
+            std::ifstream f(options.baseline_path);
+            if (!f.is_open()) {
+                std::cerr << "Failed to open baseline: " << options.baseline_path << std::endl;
+                return 1;
+            }
+            json stored = json::parse(f);
+            for (const json& r : stored.at("results")) {
+                baseline[r.at("name").get<std::string>()] = r.at("ns_per_op").get<double>();
+            }
+        }
+
+        Buffers buf;
+        std::vector<Case> cases;
+        std::vector<std::unique_ptr<LiteCNNPro>> models;
+        double forward_flops = 0.0;
+        add_layer_cases(cases, buf, rng, forward_flops);
+        add_preprocess_cases(cases, buf, rng);
+        add_forward_cases(cases, models, buf, rng, options, forward_flops);
+
+        std::cout << "threads " << parallel::num_threads() << ", channel block " << kChannelBlock
+                  << ", SIMD width " << simd::kWidth << "\n";
+        std::vector<Result> results;
+        for (const Case& c : cases) {
+            if (!selected(options, c.name)) {
+                continue;
+            }
+            results.push_back(measure(c, options));
+            print_result(results.back(), options.baseline_path.empty() ? nullptr : &baseline);
+        }
+
+        if (!options.json_path.empty()) {
+            json out;
+            out["config"] = {
+                {"threads", parallel::num_threads()},
+                {"channel_block", kChannelBlock},
+                {"simd_width", simd::kWidth},
+                {"samples", options.samples},
+            };
+            out["results"] = json::array();
+            for (const Result& r : results) {
+                out["results"].push_back({
+                    {"name", r.name},
+                    {"ns_per_op", r.median_ns},
+                    {"mean_ns", r.mean_ns},
+                    {"stddev_ns", r.stddev_ns},
+                    {"min_ns", r.min_ns},
+                    {"gflops", r.gflops},
+                    {"gb_per_s", r.gbs},
+                    {"iterations", r.iterations},
+                    {"samples", r.samples},
+                });
+            }
+            std::ofstream f(options.json_path);
+            f << out.dump(2) << "\n";
+            if (!f) {
+                std::cerr << "Failed to write " << options.json_path << std::endl;
+                return 1;
+            }
+        }
+
+        if (!options.baseline_path.empty()) {
+            int regressions = 0;
+            for (const Result& r : results) {
+                if (baseline.contains(r.name) &&
+                    r.median_ns > baseline[r.name].get<double>() * (1.0 + options.threshold_pct / 100.0)) {
+                    std::cout << "REGRESSION " << r.name << std::endl;
+                    ++regressions;
+                }
+            }
+            if (regressions > 0) {
+                return 2;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
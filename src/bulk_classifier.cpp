@@ -0,0 +1,414 @@
+#include "bulk_classifier.h"
+#include "preprocess.h"
+#include "../third_party/json.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Keeps "file" first in every output line
+using json = nlohmann::ordered_json;
+namespace fs = std::filesystem;
+
+namespace {
+
+// Blocking FIFO with a fixed capacity. close() wakes everyone: push then
+// fails and pop drains what is left before failing.
+template <class T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)) {}
+
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [&] { return closed_ || items_.size() < capacity_; });
+        if (closed_) {
+            return false;
+        }
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [&] { return closed_ || !items_.empty(); });
+        return take(item);
+    }
+
+    // Non-blocking pop
+    bool try_pop(T& item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return take(item);
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    // close() that also drops what is left, so pop fails at once
+    void cancel() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        items_.clear();
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<T> items_;
+    bool closed_ = false;
+
+    bool take(T& item) {
+        if (items_.empty()) {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+};
+
+// Threads of one stage; the last one to finish closes the next queue
+class Stage {
+public:
+    template <class F>
+    Stage(int threads, F body, std::function<void()> on_done) : remaining_(threads) {
+        for (int i = 0; i < threads; ++i) {
+            threads_.emplace_back([this, body, on_done] {
+                body();
+                if (remaining_.fetch_sub(1) == 1) {
+                    on_done();
+                }
+            });
+        }
+    }
+
+    void join() {
+        for (std::thread& t : threads_) {
+            t.join();
+        }
+    }
+
+private:
+    std::atomic<int> remaining_;
+    std::vector<std::thread> threads_;
+};
+
+struct Encoded {
+    std::string file;
+    std::vector<uint8_t> bytes;
+};
+
+// One preprocessed [3, 224, 224] image; data comes from and returns to
+// the sample pool
+struct Sample {
+    std::string file;
+    std::vector<float> data;
+};
+
+struct Outcome {
+    std::string file;
+    std::vector<float> logits; // empty on error
+    std::string error;
+};
+
+constexpr size_t kSampleSize = 3 * kInputSize * kInputSize;
+
+// JSON strings must be UTF-8, file names need not be. Such a name is
+// written with its invalid bytes replaced, plus its exact bytes in hex
+// ("file_hex") so that a rerun recognizes the file.
+bool is_utf8(const std::string& text) {
+    try {
+        json(text).dump();
+        return true;
+    } catch (const json::type_error&) {
+        return false;
+    }
+}
+
+std::string to_hex(const std::string& bytes) {
+    static const char kDigits[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned char c : bytes) {
+        hex += kDigits[c >> 4];
+        hex += kDigits[c & 15];
+    }
+    return hex;
+}
+
+std::string from_hex(const std::string& hex) {
+    std::string bytes;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        bytes += static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16));
+    }
+    return bytes;
+}
+
+// Same predictions as /predict, with k of them
+json top_k_predictions(const std::vector<float>& logits, int k,
+                       const std::map<int, BreedInfo>& breeds) {
+    json predictions = json::array();
+    for (const auto& [class_id, score] : top_predictions(logits, k)) {
+        json pred;
+        pred["class_id"] = class_id;
+        pred["score"] = score;
+        auto it = breeds.find(class_id);
+        if (it != breeds.end()) {
+            pred["breed_en"] = it->second.en;
+            pred["breed_ko"] = it->second.ko;
+        }
+        predictions.push_back(pred);
+    }
+    return predictions;
+}
+
+// Files classified by an earlier run. Error lines are dropped so those
+// files are retried (the failure may have been transient), and a last
+// line without its newline was torn by a crash and is dropped too. If
+// anything was dropped the file is rewritten, via a rename, with the rest.
+std::unordered_set<std::string> read_checkpoint(const std::string& path) {
+    std::unordered_set<std::string> done;
+    std::ifstream f(path, std::ios::binary);
+    if (!f.is_open()) {
+        return done;
+    }
+    std::string contents((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    f.close();
+
+    std::string kept;
+    size_t begin = 0;
+    while (begin < contents.size()) {
+        size_t end = contents.find('\n', begin);
+        if (end == std::string::npos) {
+            break; // torn
+        }
+        json line = json::parse(contents.begin() + begin, contents.begin() + end, nullptr, false);
+        if (line.is_object() && line.contains("file") && line.contains("predictions")) {
+            done.insert(line.contains("file_hex") ? from_hex(line["file_hex"].get<std::string>())
+                                                  : line["file"].get<std::string>());
+            kept.append(contents, begin, end + 1 - begin);
+        }
+        begin = end + 1;
+    }
+
+    if (kept.size() < contents.size()) {
+        std::string tmp = path + ".tmp";
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out << kept;
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Failed to rewrite " + path);
+        }
+        fs::rename(tmp, path);
+    }
+    return done;
+}
+
+} // namespace
+
+int classify_directory(const LiteCNNPro& model, const std::map<int, BreedInfo>& breeds,
+                       const BulkOptions& options) {
+    if (!fs::is_directory(options.dir)) {
+        std::cerr << "Not a directory: " << options.dir << std::endl;
+        return 1;
+    }
+
+    // Relative paths, sorted so reruns walk the archive in the same order
+    std::vector<std::string> files;
+    for (const auto& entry : fs::recursive_directory_iterator(options.dir)) {
+        if (entry.is_regular_file()) {
+            files.push_back(fs::relative(entry.path(), options.dir).generic_string());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    std::unordered_set<std::string> done = read_checkpoint(options.out_path);
+    size_t total = files.size();
+    files.erase(std::remove_if(files.begin(), files.end(),
+                               [&](const std::string& f) { return done.count(f) > 0; }),
+                files.end());
+    std::cout << "Classifying " << files.size() << " of " << total << " files in " << options.dir
+              << " (" << total - files.size() << " already in " << options.out_path << ")" << std::endl;
+    if (files.empty()) {
+        return 0;
+    }
+
+    std::ofstream out(options.out_path, std::ios::binary | std::ios::app);
+    if (!out.is_open()) {
+        std::cerr << "Failed to open " << options.out_path << std::endl;
+        return 1;
+    }
+
+    // The heavy stages together oversubscribe the cores: the bounded
+    // queues stall whichever one runs ahead, so the slower stage gets them
+    int hardware = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    int max_batch = std::max(options.max_batch, 1);
+    int read_threads = std::max(options.read_threads, 1);
+    int decode_threads = options.decode_threads > 0 ? options.decode_threads : hardware;
+    int forward_threads = options.forward_threads > 0 ? options.forward_threads
+                                                      : std::max(1, hardware / 2);
+
+    BoundedQueue<std::string> paths(files.size());
+    BoundedQueue<Encoded> encoded(2 * static_cast<size_t>(decode_threads));
+    BoundedQueue<Sample> samples(static_cast<size_t>(max_batch) * forward_threads);
+    BoundedQueue<Outcome> outcomes(4 * static_cast<size_t>(max_batch) * forward_threads);
+
+    // Preprocessed images in flight are capped by a pool of sample buffers:
+    // queued for forward(), being decoded into, or being copied into a batch
+    size_t pool_size = static_cast<size_t>(max_batch) * forward_threads * 2 + decode_threads;
+    BoundedQueue<std::vector<float>> free_samples(pool_size);
+    for (size_t i = 0; i < pool_size; ++i) {
+        free_samples.push(std::vector<float>(kSampleSize));
+    }
+
+    for (std::string& file : files) {
+        paths.push(std::move(file));
+    }
+    paths.close();
+
+    Stage read(read_threads, [&] {
+        std::string file;
+        while (paths.pop(file)) {
+            std::ifstream f(fs::path(options.dir) / file, std::ios::binary);
+            if (!f.is_open()) {
+                outcomes.push(Outcome{file, {}, "Failed to open file"});
+                continue;
+            }
+            std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+            encoded.push(Encoded{std::move(file), std::move(bytes)});
+        }
+    }, [&] { encoded.close(); });
+
+    Stage decode(decode_threads, [&] {
+        Encoded item;
+        while (encoded.pop(item)) {
+            Sample sample{std::move(item.file), {}};
+            if (!free_samples.pop(sample.data)) {
+                break; // cancelled
+            }
+            try {
+                DecodedImage image = decode_image(item.bytes.data(), item.bytes.size());
+                resize_normalize_into(image, sample.data.data());
+            } catch (const std::exception& e) {
+                outcomes.push(Outcome{std::move(sample.file), {}, e.what()});
+                free_samples.push(std::move(sample.data));
+                continue;
+            }
+            samples.push(std::move(sample));
+        }
+    }, [&] { samples.close(); });
+
+    Stage forward(forward_threads, [&] {
+        ExecutionContext context;
+        Tensor input;
+        Tensor output;
+        std::vector<Sample> batch;
+        Sample sample;
+        while (samples.pop(sample)) {
+            // Whatever is ready joins the batch; never waits for more
+            batch.clear();
+            batch.push_back(std::move(sample));
+            while (static_cast<int>(batch.size()) < max_batch && samples.try_pop(sample)) {
+                batch.push_back(std::move(sample));
+            }
+
+            input.shape = {static_cast<int>(batch.size()), 3, kInputSize, kInputSize};
+            input.data.resize(batch.size() * kSampleSize);
+            for (size_t i = 0; i < batch.size(); ++i) {
+                std::copy(batch[i].data.begin(), batch[i].data.end(), input.data.begin() + i * kSampleSize);
+                free_samples.push(std::move(batch[i].data));
+            }
+
+            try {
+                model.forward(input, output, context);
+                size_t classes = output.shape[1];
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    auto row = output.data.begin() + i * classes;
+                    outcomes.push(Outcome{std::move(batch[i].file), std::vector<float>(row, row + classes), {}});
+                }
+            } catch (const std::exception& e) {
+                for (Sample& s : batch) {
+                    outcomes.push(Outcome{std::move(s.file), {}, e.what()});
+                }
+            }
+        }
+    }, [&] { outcomes.close(); });
+
+    // Writer: this thread
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    Clock::time_point last_flush = start;
+    Clock::time_point last_report = start;
+    size_t written = 0;
+    size_t errors = 0;
+    Outcome outcome;
+    try {
+        while (outcomes.pop(outcome)) {
+            json line;
+            line["file"] = outcome.file;
+            if (!is_utf8(outcome.file)) {
+                line["file_hex"] = to_hex(outcome.file);
+            }
+            if (outcome.error.empty()) {
+                line["predictions"] = top_k_predictions(outcome.logits, options.top_k, breeds);
+            } else {
+                line["error"] = outcome.error;
+                ++errors;
+            }
+            out << line.dump(-1, ' ', false, json::error_handler_t::replace) << '\n';
+            ++written;
+
+            Clock::time_point now = Clock::now();
+            if (now - last_flush >= std::chrono::seconds(1)) {
+                out.flush();
+                last_flush = now;
+            }
+            if (now - last_report >= std::chrono::seconds(10)) {
+                double elapsed = std::chrono::duration<double>(now - start).count();
+                std::cout << written << " / " << files.size() << " files, " << errors << " errors, "
+                          << static_cast<int>(written / elapsed) << " images/s" << std::endl;
+                last_report = now;
+            }
+        }
+    } catch (...) {
+        // The stage threads are still joinable: stop them before unwinding
+        paths.cancel();
+        encoded.cancel();
+        free_samples.cancel();
+        samples.cancel();
+        outcomes.cancel();
+        read.join();
+        decode.join();
+        forward.join();
+        out.flush();
+        throw;
+    }
+    read.join();
+    decode.join();
+    forward.join();
+    out.flush();
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << "Classified " << written << " files (" << errors << " errors) in " << elapsed
+              << " s, " << static_cast<int>(written / std::max(elapsed, 1e-9)) << " images/s" << std::endl;
+    return out.good() ? 0 : 1;
+}
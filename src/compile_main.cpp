@@ -0,0 +1,86 @@
+#include "model.h"
+#include <iostream>
+#include <string>
+
+// Ahead-of-time model compiler: folds BatchNorm, quantizes / converts and
+// packs the weights for one target and writes the plan as an LCNP artifact
+// that litecnn_server loads with --weights without compiling anything.
+
+// NCHWc block the kernels of each target ISA use (see kChannelBlock)
+static int channel_block_for(const std::string& isa) {
+    if (isa == "native") {
+        return kChannelBlock;
+    }
+    if (isa == "avx512") {
+        return 16;
+    }
+    if (isa == "avx2" || isa == "neon" || isa == "generic") {
+        return 8;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string weights_path = "weights/model_weights.bin";
+    std::string out_path;
+    std::string isa = "native";
+    Precision precision = Precision::FP32;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--weights" && i + 1 < argc) {
+            weights_path = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (arg == "--isa" && i + 1 < argc) {
+            isa = argv[++i];
+        } else if (arg == "--precision" && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (value == "fp32") {
+                precision = Precision::FP32;
+            } else if (value == "fp16") {
+                precision = Precision::FP16;
+            } else if (value == "bf16") {
+                precision = Precision::BF16;
+            } else if (value == "int8") {
+                precision = Precision::INT8;
+            } else {
+                std::cerr << "Unknown precision: " << value << std::endl;
+                return 1;
+            }
+        } else if (arg == "--help") {
+            std::cout << "Usage: " << argv[0] << " --out PATH [options]\n"
+                      << "Options:\n"
+                      << "  --weights PATH     LCNN weights to compile (default: weights/model_weights.bin)\n"
+                      << "  --out PATH         Output plan artifact\n"
+                      << "  --isa ISA          native, avx512, avx2, neon or generic (default: native)\n"
+                      << "  --precision MODE   fp32, fp16, bf16 or int8 (default: fp32);\n"
+                      << "                     int8 needs weights written by --calibrate\n"
+                      << "  --help             Show this help\n";
+            return 0;
+        }
+    }
+
+    int block = channel_block_for(isa);
+    if (block == 0) {
+        std::cerr << "Unknown ISA: " << isa << std::endl;
+        return 1;
+    }
+    if (out_path.empty()) {
+        std::cerr << "--out PATH is required" << std::endl;
+        return 1;
+    }
+
+    try {
+        LiteCNNPro model;
+        model.set_precision(precision);
+        model.set_channel_block(block);
+        if (!model.load_weights(weights_path)) {
+            return 1;
+        }
+        return model.save_plan(out_path) ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,702 @@
+#include "epoll_server.h"
+#include "mpmc_queue.h"
+#include "httplib.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <unordered_map>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Lets workers sleep on an empty queue without a lock on the fast path:
+// a producer bumps the sequence after pushing and only enters the kernel
+// when someone is asleep. A consumer registers as a waiter, reads the
+// sequence, re-checks the queue and sleeps only if the sequence is still
+// the one it read.
+class EventCount {
+public:
+    uint32_t prepare_wait() {
+        waiters_.fetch_add(1);
+        return sequence_.load();
+    }
+    void cancel_wait() { waiters_.fetch_sub(1); }
+    void wait(uint32_t key) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&sequence_), FUTEX_WAIT_PRIVATE, key,
+                nullptr, nullptr, 0);
+        waiters_.fetch_sub(1);
+    }
+    void notify(int count = 1) {
+        sequence_.fetch_add(1);
+        if (waiters_.load() > 0) {
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&sequence_), FUTEX_WAKE_PRIVATE, count,
+                    nullptr, nullptr, 0);
+        }
+    }
+
+private:
+    std::atomic<uint32_t> sequence_{0};
+    std::atomic<int> waiters_{0};
+};
+
+struct Connection {
+    int fd = -1;
+    std::string remote_addr; // numeric peer address, as httplib reports it
+    std::string in;     // received, not yet parsed (headers, pipelined requests)
+    size_t scanned = 0; // bytes of `in` known not to end the headers
+    std::string out;    // response being written
+    size_t written = 0;
+
+    // Request being received; request->body grows as bytes arrive, up to
+    // the declared length
+    std::unique_ptr<httplib::Request> request;
+    size_t body_length = 0;
+    bool keep_alive = true;
+
+    bool in_flight = false; // handed to a worker
+    Clock::time_point last_active;
+};
+
+} // namespace
+
+// A parsed request on its way to a worker and back
+struct EpollServer::Pending {
+    Loop* loop;
+    Connection* connection;
+    httplib::Request request;
+    bool keep_alive;
+    std::string response; // serialized by the worker
+};
+
+struct EpollServer::Shared {
+    explicit Shared(size_t capacity) : jobs(capacity) {}
+    MpmcQueue<Pending*> jobs;
+    EventCount jobs_ready;
+    std::atomic<bool> stopping{false};
+};
+
+struct EpollServer::Loop {
+    Loop(const EpollOptions& options, Shared& shared)
+        : options(options), shared(shared),
+          completions(options.queue_capacity + static_cast<size_t>(std::max(options.workers, 1))) {}
+
+    ~Loop() {
+        for (auto& [connection, owned] : connections) {
+            if (connection->fd >= 0) ::close(connection->fd);
+        }
+        if (listener >= 0) ::close(listener);
+        if (wake_fd >= 0) ::close(wake_fd);
+        if (epoll_fd >= 0) ::close(epoll_fd);
+        if (spare_fd >= 0) ::close(spare_fd);
+    }
+
+    const EpollOptions& options;
+    Shared& shared;
+    int epoll_fd = -1;
+    int listener = -1;
+    int wake_fd = -1;
+    int spare_fd = -1; // given up to accept-and-close when out of descriptors
+    MpmcQueue<Pending*> completions;
+    std::unordered_map<Connection*, std::unique_ptr<Connection>> connections;
+    // Closed this iteration, freed once no event or worker refers to them
+    std::vector<Connection*> closed;
+    std::vector<std::string> buffers; // pooled request buffers
+    std::vector<char> scratch = std::vector<char>(64 << 10);
+
+    void open(const std::string& host, int port);
+    void run();
+
+    void accept_all();
+    void on_readable(Connection* c);
+    void on_writable(Connection* c);
+    void on_completions();
+    void sweep_idle(Clock::time_point now);
+    void free_closed();
+
+    // Parses what `in` holds; dispatches at most one request
+    void parse(Connection* c);
+    void dispatch(Connection* c);
+    void reply_error(Connection* c, int status, const char* message);
+    void write_out(Connection* c);
+    void watch(Connection* c, uint32_t events);
+    void close(Connection* c);
+
+    std::string take_buffer();
+    void give_buffer(std::string&& buffer);
+};
+
+namespace {
+
+std::string serialize(const httplib::Response& res, bool keep_alive) {
+    int status = res.status < 0 ? 200 : res.status;
+    std::string out = "HTTP/1.1 " + std::to_string(status) + " " + httplib::status_message(status) + "\r\n";
+    for (const auto& [key, value] : res.headers) {
+        out += key + ": " + value + "\r\n";
+    }
+    out += "Content-Length: " + std::to_string(res.body.size()) + "\r\n";
+    out += keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    out += res.body;
+    return out;
+}
+
+// "Name: value" lines after the request line; false if malformed
+bool parse_head(const std::string& head, httplib::Request& req) {
+    size_t line_end = head.find("\r\n");
+    std::string line = head.substr(0, line_end);
+    size_t sp1 = line.find(' ');
+    size_t sp2 = line.rfind(' ');
+    if (sp1 == std::string::npos || sp2 == sp1) {
+        return false;
+    }
+    req.method = line.substr(0, sp1);
+    req.target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    req.version = line.substr(sp2 + 1);
+    if (req.version.compare(0, 5, "HTTP/") != 0) {
+        return false;
+    }
+    size_t query = req.target.find('?');
+    req.path = req.target.substr(0, query);
+    if (query != std::string::npos) {
+        httplib::detail::parse_query_text(req.target.substr(query + 1), req.params);
+    }
+
+    size_t pos = line_end + 2;
+    while (pos < head.size()) {
+        size_t end = head.find("\r\n", pos);
+        if (end == std::string::npos) {
+            end = head.size();
+        }
+        size_t colon = head.find(':', pos);
+        if (colon == std::string::npos || colon > end) {
+            return false;
+        }
+        size_t value = head.find_first_not_of(" \t", colon + 1);
+        value = value == std::string::npos || value > end ? end : value;
+        size_t value_end = end;
+        while (value_end > value && (head[value_end - 1] == ' ' || head[value_end - 1] == '\t')) {
+            --value_end;
+        }
+        req.headers.emplace(head.substr(pos, colon - pos), head.substr(value, value_end - value));
+        pos = end + 2;
+    }
+    return true;
+}
+
+// Fills req.form from a multipart body, as httplib's server does
+bool parse_form(httplib::Request& req) {
+    std::string boundary;
+    if (!httplib::detail::parse_multipart_boundary(req.get_header_value("Content-Type"), boundary)) {
+        return false;
+    }
+    httplib::detail::FormDataParser parser;
+    parser.set_boundary(std::move(boundary));
+    httplib::FormFields::iterator field;
+    httplib::FormFiles::iterator file;
+    bool is_field = false;
+    bool ok = parser.parse(
+        req.body.data(), req.body.size(),
+        [&](const httplib::FormData& part) {
+            if (part.filename.empty()) {
+                field = req.form.fields.emplace(part.name, httplib::FormField{part.name, part.content, part.headers});
+                is_field = true;
+            } else {
+                file = req.form.files.emplace(part.name, part);
+                is_field = false;
+            }
+            return true;
+        },
+        [&](const char* data, size_t n) {
+            (is_field ? field->second.content : file->second.content).append(data, n);
+            return true;
+        });
+    return ok && parser.is_valid();
+}
+
+} // namespace
+
+void EpollServer::Loop::open(const std::string& host, int port) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* result = nullptr;
+    if (::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0 || !result) {
+        throw std::runtime_error("Cannot resolve " + host);
+    }
+    listener = ::socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    // Every loop binds the same port; the kernel spreads connections
+    ::setsockopt(listener, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    bool bound = listener >= 0 && ::bind(listener, result->ai_addr, result->ai_addrlen) == 0 &&
+                 ::listen(listener, SOMAXCONN) == 0;
+    ::freeaddrinfo(result);
+    if (!bound) {
+        throw std::runtime_error("Cannot listen on port " + std::to_string(port));
+    }
+
+    epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    spare_fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = &listener;
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listener, &ev);
+    ev.data.ptr = &wake_fd;
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+}
+
+void EpollServer::Loop::run() {
+    std::vector<epoll_event> events(256);
+    Clock::time_point last_sweep = Clock::now();
+    while (!shared.stopping.load(std::memory_order_relaxed)) {
+        int n = ::epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), 1000);
+        for (int i = 0; i < n; ++i) {
+            void* tag = events[i].data.ptr;
+            if (tag == &listener) {
+                accept_all();
+            } else if (tag == &wake_fd) {
+                uint64_t count;
+                while (::read(wake_fd, &count, sizeof(count)) > 0) {
+                }
+                on_completions();
+            } else {
+                auto* c = static_cast<Connection*>(tag);
+                if (c->fd < 0) {
+                    continue; // closed earlier in this batch
+                }
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    close(c);
+                    continue;
+                }
+                if (events[i].events & EPOLLOUT) {
+                    on_writable(c);
+                }
+                if ((events[i].events & EPOLLIN) && c->fd >= 0) {
+                    on_readable(c);
+                }
+            }
+        }
+        free_closed();
+        Clock::time_point now = Clock::now();
+        if (now - last_sweep >= std::chrono::seconds(1)) {
+            sweep_idle(now);
+            last_sweep = now;
+        }
+    }
+}
+
+void EpollServer::Loop::accept_all() {
+    while (true) {
+        sockaddr_storage peer{};
+        socklen_t peer_size = sizeof(peer);
+        int fd = ::accept4(listener, reinterpret_cast<sockaddr*>(&peer), &peer_size,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE) {
+                // Out of descriptors: accept with the spare one and close
+                // it at once, otherwise the listener stays readable forever
+                ::close(spare_fd);
+                fd = ::accept(listener, nullptr, nullptr);
+                if (fd >= 0) ::close(fd);
+                spare_fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+                continue;
+            }
+            return; // EAGAIN or a transient error
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        auto owned = std::make_unique<Connection>();
+        Connection* c = owned.get();
+        c->fd = fd;
+        char host[NI_MAXHOST];
+        if (::getnameinfo(reinterpret_cast<sockaddr*>(&peer), peer_size, host, sizeof(host), nullptr, 0,
+                          NI_NUMERICHOST) == 0) {
+            c->remote_addr = host;
+        }
+        c->last_active = Clock::now();
+        connections.emplace(c, std::move(owned));
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+void EpollServer::Loop::on_readable(Connection* c) {
+    while (!c->in_flight && c->fd >= 0) {
+        ssize_t n;
+        if (c->request && c->body_length > 0 && c->request->body.size() < c->body_length) {
+            // Body bytes are appended as they arrive, so a declared
+            // Content-Length costs no memory until the client sends it
+            std::string& body = c->request->body;
+            n = ::recv(c->fd, scratch.data(), std::min(scratch.size(), c->body_length - body.size()), 0);
+            if (n > 0) {
+                body.append(scratch.data(), static_cast<size_t>(n));
+            }
+        } else {
+            n = ::recv(c->fd, scratch.data(), scratch.size(), 0);
+            if (n > 0) {
+                if (c->in.empty() && c->in.capacity() == 0) {
+                    c->in = take_buffer();
+                }
+                if (!c->request && c->in.empty()) {
+                    // First byte of a new request
+                    c->request = std::make_unique<httplib::Request>();
+                    c->request->start_time_ = Clock::now();
+                }
+                c->in.append(scratch.data(), static_cast<size_t>(n));
+            }
+        }
+        if (n == 0) {
+            close(c);
+            return;
+        }
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                close(c);
+            }
+            break;
+        }
+        c->last_active = Clock::now();
+        parse(c);
+    }
+}
+
+void EpollServer::Loop::parse(Connection* c) {
+    if (c->in_flight || c->fd < 0) {
+        return;
+    }
+    if (!c->request) {
+        if (c->in.empty()) {
+            return;
+        }
+        // Pipelined request already buffered behind the previous one
+        c->request = std::make_unique<httplib::Request>();
+        c->request->start_time_ = Clock::now();
+    }
+    httplib::Request& req = *c->request;
+
+    if (req.method.empty()) {
+        size_t from = c->scanned >= 3 ? c->scanned - 3 : 0;
+        size_t end = c->in.find("\r\n\r\n", from);
+        if (end == std::string::npos) {
+            c->scanned = c->in.size();
+            if (c->in.size() > options.max_header_bytes) {
+                reply_error(c, 431, "Request headers too large");
+            }
+            return;
+        }
+        if (end > options.max_header_bytes || !parse_head(c->in.substr(0, end), req)) {
+            reply_error(c, 400, "Malformed request");
+            return;
+        }
+        c->in.erase(0, end + 4);
+        c->scanned = 0;
+
+        std::string connection = req.get_header_value("Connection");
+        std::transform(connection.begin(), connection.end(), connection.begin(), ::tolower);
+        c->keep_alive = req.version == "HTTP/1.1" ? connection != "close" : connection == "keep-alive";
+
+        if (req.has_header("Transfer-Encoding")) {
+            reply_error(c, 411, "Chunked request bodies are not supported, send Content-Length");
+            return;
+        }
+        size_t length = req.get_header_value_u64("Content-Length");
+        if (length > options.max_body_bytes) {
+            reply_error(c, 413, "Request body too large");
+            return;
+        }
+        // Body: what already arrived behind the headers, the rest is
+        // appended to this buffer as it arrives
+        req.body = take_buffer();
+        size_t buffered = std::min(length, c->in.size());
+        req.body.append(c->in, 0, buffered);
+        c->in.erase(0, buffered);
+        c->body_length = length;
+
+        if (buffered < length && req.get_header_value("Expect") == "100-continue") {
+            static const char kContinue[] = "HTTP/1.1 100 Continue\r\n\r\n";
+            ::send(c->fd, kContinue, sizeof(kContinue) - 1, MSG_NOSIGNAL);
+        }
+    }
+
+    if (req.body.size() == c->body_length) {
+        dispatch(c);
+    }
+}
+
+void EpollServer::Loop::dispatch(Connection* c) {
+    auto* pending = new Pending{this, c, std::move(*c->request), c->keep_alive, {}};
+    pending->request.remote_addr = c->remote_addr;
+    c->request.reset();
+    c->body_length = 0;
+    if (c->in.empty()) {
+        give_buffer(std::move(c->in));
+        c->in = std::string();
+    }
+    if (!shared.jobs.try_push(pending)) {
+        give_buffer(std::move(pending->request.body));
+        delete pending;
+        reply_error(c, 503, "Server busy");
+        return;
+    }
+    c->in_flight = true;
+    watch(c, 0); // no reads until the response is out; errors still report
+    shared.jobs_ready.notify();
+}
+
+void EpollServer::Loop::reply_error(Connection* c, int status, const char* message) {
+    httplib::Response res;
+    res.status = status;
+    res.set_content(std::string("{\"error\":\"") + message + "\"}", "application/json");
+    // The rest of a rejected request cannot be skipped reliably
+    c->keep_alive = false;
+    c->request.reset();
+    c->body_length = 0;
+    c->out = serialize(res, false);
+    c->written = 0;
+    write_out(c);
+}
+
+void EpollServer::Loop::on_completions() {
+    Pending* pending;
+    while (completions.try_pop(pending)) {
+        Connection* c = pending->connection;
+        give_buffer(std::move(pending->request.body));
+        c->in_flight = false;
+        if (c->fd < 0) {
+            closed.push_back(c); // the client left while it was handled
+        } else {
+            c->out = std::move(pending->response);
+            c->written = 0;
+            c->keep_alive = pending->keep_alive;
+            c->last_active = Clock::now();
+            write_out(c);
+        }
+        delete pending;
+    }
+}
+
+void EpollServer::Loop::write_out(Connection* c) {
+    while (c->written < c->out.size()) {
+        ssize_t n = ::send(c->fd, c->out.data() + c->written, c->out.size() - c->written, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                watch(c, EPOLLOUT);
+                return;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            close(c);
+            return;
+        }
+        c->written += static_cast<size_t>(n);
+    }
+    c->out = std::string();
+    c->written = 0;
+    if (!c->keep_alive) {
+        close(c);
+        return;
+    }
+    watch(c, EPOLLIN);
+    // Next pipelined request, if one is buffered
+    parse(c);
+}
+
+void EpollServer::Loop::on_writable(Connection* c) {
+    if (c->written < c->out.size()) {
+        write_out(c);
+    }
+}
+
+void EpollServer::Loop::watch(Connection* c, uint32_t events) {
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.ptr = c;
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+void EpollServer::Loop::close(Connection* c) {
+    if (c->fd < 0) {
+        return;
+    }
+    ::close(c->fd); // also leaves the epoll set
+    c->fd = -1;
+    if (c->request) {
+        give_buffer(std::move(c->request->body));
+    }
+    give_buffer(std::move(c->in));
+    // A worker handling its request still points at it; then the
+    // completion queues it for freeing instead
+    if (!c->in_flight) {
+        closed.push_back(c);
+    }
+}
+
+void EpollServer::Loop::free_closed() {
+    for (Connection* c : closed) {
+        connections.erase(c);
+    }
+    closed.clear();
+}
+
+void EpollServer::Loop::sweep_idle(Clock::time_point now) {
+    auto limit = std::chrono::seconds(options.idle_timeout_s);
+    std::vector<Connection*> idle;
+    for (auto& [c, owned] : connections) {
+        if (!c->in_flight && c->fd >= 0 && now - c->last_active > limit) {
+            idle.push_back(c);
+        }
+    }
+    for (Connection* c : idle) {
+        close(c);
+    }
+}
+
+std::string EpollServer::Loop::take_buffer() {
+    if (buffers.empty()) {
+        return std::string();
+    }
+    std::string buffer = std::move(buffers.back());
+    buffers.pop_back();
+    return buffer;
+}
+
+void EpollServer::Loop::give_buffer(std::string&& buffer) {
+    // Keep a bounded number of reasonably sized buffers
+    if (buffer.capacity() == 0 || buffer.capacity() > (4 << 20) || buffers.size() >= 256) {
+        return;
+    }
+    buffer.clear();
+    buffers.push_back(std::move(buffer));
+}
+
+EpollServer::EpollServer(const EpollOptions& options, Handler handler)
+    : options_(options), handler_(std::move(handler)) {
+    options_.io_threads = std::max(options_.io_threads, 1);
+    if (options_.workers <= 0) {
+        options_.workers = CPPHTTPLIB_THREAD_POOL_COUNT;
+    }
+    shared_ = std::make_unique<Shared>(options_.queue_capacity);
+}
+
+EpollServer::~EpollServer() {
+    stop();
+    for (std::thread& t : workers_) {
+        if (t.joinable()) t.join();
+    }
+}
+
+void EpollServer::listen(const std::string& host, int port) {
+    for (int i = 0; i < options_.io_threads; ++i) {
+        loops_.push_back(std::make_unique<Loop>(options_, *shared_));
+        loops_.back()->open(host, port);
+    }
+    for (int i = 0; i < options_.workers; ++i) {
+        workers_.emplace_back(&EpollServer::worker_loop, this);
+    }
+
+    std::vector<std::thread> io;
+    for (size_t i = 1; i < loops_.size(); ++i) {
+        io.emplace_back(&Loop::run, loops_[i].get());
+    }
+    loops_[0]->run();
+    for (std::thread& t : io) {
+        t.join();
+    }
+}
+
+void EpollServer::stop() {
+    shared_->stopping.store(true);
+    shared_->jobs_ready.notify(INT_MAX);
+    for (auto& loop : loops_) {
+        uint64_t one = 1;
+        if (::write(loop->wake_fd, &one, sizeof(one)) < 0) {
+            // Loops also notice within a second
+        }
+    }
+}
+
+void EpollServer::worker_loop() {
+    Shared& shared = *shared_;
+    Pending* pending;
+    while (true) {
+        if (!shared.jobs.try_pop(pending)) {
+            uint32_t key = shared.jobs_ready.prepare_wait();
+            if (shared.jobs.try_pop(pending)) {
+                shared.jobs_ready.cancel_wait();
+            } else if (shared.stopping.load()) {
+                shared.jobs_ready.cancel_wait();
+                return;
+            } else {
+                shared.jobs_ready.wait(key);
+                continue;
+            }
+        }
+
+        httplib::Request& req = pending->request;
+        httplib::Response res;
+        try {
+            if (req.is_multipart_form_data() && !parse_form(req)) {
+                res.status = 400;
+                res.set_content("{\"error\":\"Malformed multipart body\"}", "application/json");
+            } else {
+                handler_(req, res);
+            }
+        } catch (const std::exception& e) {
+            res.status = 500;
+            res.set_content(std::string("{\"error\":\"") + e.what() + "\"}", "application/json");
+        }
+        pending->response = serialize(res, pending->keep_alive);
+
+        // Completions hold at most every queued plus every running request
+        Loop* loop = pending->loop;
+        while (!loop->completions.try_push(pending)) {
+            std::this_thread::yield();
+        }
+        uint64_t one = 1;
+        if (::write(loop->wake_fd, &one, sizeof(one)) < 0) {
+            // The counter is saturated, so a wake-up is already pending
+        }
+    }
+}
+
+#else
+
+struct EpollServer::Shared {};
+struct EpollServer::Loop {};
+
+EpollServer::EpollServer(const EpollOptions& options, Handler handler)
+    : options_(options), handler_(std::move(handler)) {}
+
+EpollServer::~EpollServer() = default;
+
+void EpollServer::listen(const std::string&, int) {
+    throw std::runtime_error("The epoll front-end needs Linux; use the default front-end");
+}
+
+void EpollServer::stop() {}
+
+void EpollServer::worker_loop() {}
+
+#endif
@@ -0,0 +1,221 @@
+#include "gemm.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstring>
+
+namespace gemm {
+
+namespace {
+
+constexpr int kNR = 2 * simd::kWidth;
+
+// Cache blocking: a KC x NR sliver of B stays in L1,
+// an MC x KC block of A and a KC x NC block of B stay in L2.
+constexpr int kMC = 16 * kMR;
+constexpr int kNC = 512;
+
+inline int round_up(int x, int m) { return (x + m - 1) / m * m; }
+
+// Packed B block: kc x nc -> NR-column panels, zero padded
+void pack_b(int kc, int nc, const float* B, int ldb, float* dst) {
+    for (int j = 0; j < nc; j += kNR) {
+        int nr = std::min(kNR, nc - j);
+        for (int k = 0; k < kc; ++k) {
+            const float* src = B + static_cast<size_t>(k) * ldb + j;
+            std::memcpy(dst, src, nr * sizeof(float));
+            std::fill(dst + nr, dst + kNR, 0.0f);
+            dst += kNR;
+        }
+    }
+}
+
+// MR x NR micro-kernel over a kc-deep packed A panel and packed B panel
+// ep (if set) carries bias pointers already offset to this tile's first row.
+void micro_kernel(int kc, const float* a, const float* b,
+                  float* c, int ldc, bool accumulate, const Epilogue* ep) {
+    simd::vfloat acc[kMR][2];
+    for (int i = 0; i < kMR; ++i) {
+        acc[i][0] = simd::zero();
+        acc[i][1] = simd::zero();
+    }
+
+    for (int k = 0; k < kc; ++k) {
+        simd::vfloat b0 = simd::load(b);
+        simd::vfloat b1 = simd::load(b + simd::kWidth);
+        for (int i = 0; i < kMR; ++i) {
+            simd::vfloat ai = simd::set1(a[i]);
+            acc[i][0] = simd::fmadd(ai, b0, acc[i][0]);
+            acc[i][1] = simd::fmadd(ai, b1, acc[i][1]);
+        }
+        a += kMR;
+        b += kNR;
+    }
+
+    for (int i = 0; i < kMR; ++i) {
+        float* row = c + static_cast<size_t>(i) * ldc;
+        if (accumulate) {
+            acc[i][0] = simd::add(acc[i][0], simd::load(row));
+            acc[i][1] = simd::add(acc[i][1], simd::load(row + simd::kWidth));
+        }
+        if (ep) {
+            if (ep->bias) {
+                simd::vfloat b = simd::set1(ep->bias[i]);
+                acc[i][0] = simd::add(acc[i][0], b);
+                acc[i][1] = simd::add(acc[i][1], b);
+            }
+            if (ep->relu6) {
+                simd::vfloat lo = simd::zero(), hi = simd::set1(6.0f);
+                acc[i][0] = simd::min(simd::max(acc[i][0], lo), hi);
+                acc[i][1] = simd::min(simd::max(acc[i][1], lo), hi);
+            }
+        }
+        simd::store(row, acc[i][0]);
+        simd::store(row + simd::kWidth, acc[i][1]);
+    }
+}
+
+// Edge tiles go through a local buffer so the kernel never touches
+// memory outside C.
+void edge_kernel(int kc, const float* a, const float* b,
+                 float* c, int ldc, int mr, int nr, bool accumulate, const Epilogue* ep) {
+    float tile[kMR * kNR];
+    micro_kernel(kc, a, b, tile, kNR, false, nullptr);
+    for (int i = 0; i < mr; ++i) {
+        float* row = c + static_cast<size_t>(i) * ldc;
+        float bias = (ep && ep->bias) ? ep->bias[i] : 0.0f;
+        for (int j = 0; j < nr; ++j) {
+            float v = accumulate ? row[j] + tile[i * kNR + j] : tile[i * kNR + j];
+            if (ep) {
+                v += bias;
+                if (ep->relu6) v = std::min(std::max(v, 0.0f), 6.0f);
+            }
+            row[j] = v;
+        }
+    }
+}
+
+void run_blocked(const PackedMatrix& A, int N, const float* B, int ldb,
+                 float* C, int ldc, bool accumulate, const Epilogue* epilogue) {
+    const int M = A.rows();
+    const int K = A.cols();
+
+    // Column blocks are independent, so they are the unit of parallel work;
+    // with several threads they shrink until each thread gets a few
+    int nc_step = kNC;
+    int threads = parallel::num_threads();
+    if (threads > 1) {
+        nc_step = std::min(kNC, std::max(kNR, round_up((N + 4 * threads - 1) / (4 * threads), kNR)));
+    }
+    int col_blocks = (N + nc_step - 1) / nc_step;
+
+    parallel::parallel_for(col_blocks, [&](int block_begin, int block_end) {
+        // Per-thread packing buffer, grown once and reused across calls
+        thread_local std::vector<float> packed_b;
+        size_t packed_size = static_cast<size_t>(kKC) * round_up(std::min(N, nc_step), kNR);
+        if (packed_b.size() < packed_size) {
+            packed_b.resize(packed_size);
+        }
+
+        for (int jc = block_begin * nc_step; jc < std::min(N, block_end * nc_step); jc += nc_step) {
+            int nc = std::min(nc_step, N - jc);
+
+            for (int pc = 0; pc < K; pc += kKC) {
+                int kc = std::min(kKC, K - pc);
+                bool acc = accumulate || pc > 0;
+                bool last_k = pc + kc == K;
+                pack_b(kc, nc, B + static_cast<size_t>(pc) * ldb + jc, ldb, packed_b.data());
+
+                for (int ic = 0; ic < M; ic += kMC) {
+                    int mc = std::min(kMC, M - ic);
+
+                    for (int jr = 0; jr < nc; jr += kNR) {
+                        int nr = std::min(kNR, nc - jr);
+                        const float* bp = packed_b.data() + static_cast<size_t>(jr) * kc;
+
+                        for (int ir = 0; ir < mc; ir += kMR) {
+                            int mr = std::min(kMR, mc - ir);
+                            const float* ap = A.panel(pc, ic + ir);
+                            float* cp = C + static_cast<size_t>(ic + ir) * ldc + jc + jr;
+
+                            Epilogue tile_ep;
+                            const Epilogue* ep = nullptr;
+                            if (epilogue && last_k) {
+                                tile_ep.bias = epilogue->bias ? epilogue->bias + ic + ir : nullptr;
+                                tile_ep.relu6 = epilogue->relu6;
+                                ep = &tile_ep;
+                            }
+
+                            if (mr == kMR && nr == kNR) {
+                                micro_kernel(kc, ap, bp, cp, ldc, acc, ep);
+                            } else {
+                                edge_kernel(kc, ap, bp, cp, ldc, mr, nr, acc, ep);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+} // namespace
+
+int kernel_nr() { return kNR; }
+
+PackedMatrix::PackedMatrix(const float* a, int rows, int cols, int lda)
+    : rows_(rows), cols_(cols), padded_rows_(round_up(rows, kMR)) {
+    data_.assign(static_cast<size_t>(padded_rows_) * cols_, 0.0f);
+
+    // Layout: for each K block, for each MR panel, kc x MR values
+    float* dst = data_.data();
+    for (int pc = 0; pc < cols_; pc += kKC) {
+        int kc = std::min(kKC, cols_ - pc);
+        for (int ir = 0; ir < padded_rows_; ir += kMR) {
+            for (int k = 0; k < kc; ++k) {
+                for (int i = 0; i < kMR; ++i) {
+                    int r = ir + i;
+                    dst[i] = r < rows_ ? a[static_cast<size_t>(r) * lda + pc + k] : 0.0f;
+                }
+                dst += kMR;
+            }
+        }
+    }
+}
+
+PackedMatrix PackedMatrix::view_of(const float* panels, int rows, int cols,
+                                   std::shared_ptr<const void> storage) {
+    PackedMatrix m;
+    m.rows_ = rows;
+    m.cols_ = cols;
+    m.padded_rows_ = round_up(rows, kMR);
+    m.view_ = panels;
+    m.storage_ = std::move(storage);
+    return m;
+}
+
+size_t PackedMatrix::packed_size(int rows, int cols) {
+    return static_cast<size_t>(round_up(rows, kMR)) * cols;
+}
+
+const float* PackedMatrix::panel(int k0, int row) const {
+    int kc = std::min(kKC, cols_ - k0);
+    return data() + static_cast<size_t>(k0) * padded_rows_ + static_cast<size_t>(row) * kc;
+}
+
+void sgemm(int M, int N, int K,
+           const float* A, int lda,
+           const float* B, int ldb,
+           float* C, int ldc, bool accumulate) {
+    PackedMatrix packed(A, M, K, lda);
+    run_blocked(packed, N, B, ldb, C, ldc, accumulate, nullptr);
+}
+
+void sgemm_packed(const PackedMatrix& A, int N,
+                  const float* B, int ldb,
+                  float* C, int ldc, bool accumulate,
+                  const Epilogue* epilogue) {
+    run_blocked(A, N, B, ldb, C, ldc, accumulate, epilogue);
+}
+
+} // namespace gemm
@@ -0,0 +1,632 @@
+#include "jpeg_decoder.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace jpeg {
+
+namespace {
+
+// Natural (row-major) position of the k-th coefficient in zigzag order;
+// the tail absorbs runs that overshoot on corrupt data
+const uint8_t kZigzag[64 + 16] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+    63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63
+};
+
+// Thrown on corrupt or unsupported streams, turned into `false`
+struct DecodeError {};
+
+inline int read_u16(const uint8_t* p) {
+    return (p[0] << 8) | p[1];
+}
+
+constexpr int kFastBits = 9;
+
+// Canonical Huffman table with a lookup on the next kFastBits bits
+struct Huffman {
+    uint16_t fast[1 << kFastBits] = {}; // (length << 8) | symbol, 0: longer code
+    // AC tables: code and coefficient bits both within the lookup window,
+    // (value << 8) | (run << 4) | total length, 0: decode the long way
+    int16_t fast_ac[1 << kFastBits] = {};
+    uint8_t symbols[256] = {};
+    int32_t maxcode[17] = {};           // largest code of each length, -1: none
+    int32_t delta[17] = {};             // symbol index = code + delta[length]
+    bool defined = false;
+};
+
+void build_huffman(Huffman& h, const uint8_t* counts, const uint8_t* symbols, int total) {
+    h = Huffman();
+    std::copy(symbols, symbols + total, h.symbols);
+    int32_t code = 0;
+    int k = 0;
+    for (int length = 1; length <= 16; ++length) {
+        // Over-full lengths would write past the fast table
+        if (code + counts[length - 1] > (1 << length)) {
+            throw DecodeError();
+        }
+        h.delta[length] = k - code;
+        for (int i = 0; i < counts[length - 1]; ++i, ++code, ++k) {
+            if (length <= kFastBits) {
+                int first = code << (kFastBits - length);
+                std::fill(h.fast + first, h.fast + first + (1 << (kFastBits - length)),
+                          static_cast<uint16_t>((length << 8) | symbols[k]));
+            }
+        }
+        h.maxcode[length] = counts[length - 1] ? code - 1 : -1;
+        code <<= 1;
+    }
+
+    for (int i = 0; i < (1 << kFastBits); ++i) {
+        int length = h.fast[i] >> 8;
+        int run = (h.fast[i] >> 4) & 15, s = h.fast[i] & 15;
+        if (length == 0 || s == 0 || length + s > kFastBits) {
+            continue;
+        }
+        int v = (i >> (kFastBits - length - s)) & ((1 << s) - 1);
+        v = v < (1 << (s - 1)) ? v - (1 << s) + 1 : v;
+        if (v >= -128 && v <= 127) {
+            h.fast_ac[i] = static_cast<int16_t>(v * 256 + (run << 4) + length + s);
+        }
+    }
+    h.defined = true;
+}
+
+// Entropy-coded segment reader. Stops at the next marker and feeds zeros
+// from there, so corrupt data can never read past the buffer.
+struct BitReader {
+    const uint8_t* p;
+    const uint8_t* end;
+    uint32_t buf = 0;
+    int bits = 0;
+    int padding = 0; // zero bits appended past the entropy data, at the end of buf
+    bool marker = false;
+
+    BitReader(const uint8_t* p_, const uint8_t* end_) : p(p_), end(end_) {}
+
+    void fill() {
+        while (bits <= 24) {
+            uint32_t byte = 0;
+            if (!marker && p < end) {
+                byte = *p++;
+                if (byte == 0xFF) {
+                    if (p < end && *p == 0x00) {
+                        ++p; // stuffed 0xFF data byte
+                    } else {
+                        marker = true;
+                        --p;
+                        byte = 0;
+                        padding += 8;
+                    }
+                }
+            } else {
+                padding += 8;
+            }
+            buf |= byte << (24 - bits);
+            bits += 8;
+        }
+    }
+
+    void consume(int n) {
+        buf <<= n;
+        bits -= n;
+    }
+
+    // Whether decoding has used bits past the end of the entropy data
+    bool overrun() const { return padding > bits; }
+
+    int decode(const Huffman& h) {
+        if (bits < 16) fill();
+        uint16_t entry = h.fast[buf >> (32 - kFastBits)];
+        if (entry) {
+            consume(entry >> 8);
+            return entry & 0xFF;
+        }
+        for (int length = kFastBits + 1; length <= 16; ++length) {
+            int32_t code = static_cast<int32_t>(buf >> (32 - length));
+            if (code <= h.maxcode[length]) {
+                consume(length);
+                return h.symbols[code + h.delta[length]];
+            }
+        }
+        throw DecodeError();
+    }
+
+    // Next `s` bits as a signed coefficient (JPEG EXTEND)
+    int receive_extend(int s) {
+        if (s == 0) {
+            return 0;
+        }
+        if (bits < s) fill();
+        int v = static_cast<int>(buf >> (32 - s));
+        consume(s);
+        return v < (1 << (s - 1)) ? v - (1 << s) + 1 : v;
+    }
+};
+
+// idct_table(n)[x * n + u] = C(u) cos((2x + 1) u pi / 2n) / 2, C(0) = 1/sqrt(2).
+// The n-point transform of the top-left n x n coefficients samples the
+// 8x8 block's continuous IDCT at n x n evenly spaced points.
+const float* idct_table(int n) {
+    static const std::array<std::array<float, 64>, 4> tables = [] {
+        std::array<std::array<float, 64>, 4> t{};
+        const double pi = std::acos(-1.0);
+        for (int level = 0; level < 4; ++level) {
+            int size = 1 << level;
+            for (int x = 0; x < size; ++x) {
+                for (int u = 0; u < size; ++u) {
+                    double c = u == 0 ? std::sqrt(0.5) : 1.0;
+                    t[level][x * size + u] =
+                        static_cast<float>(c * std::cos((2 * x + 1) * u * pi / (2 * size)) / 2);
+                }
+            }
+        }
+        return t;
+    }();
+    return tables[n == 8 ? 3 : n == 4 ? 2 : n == 2 ? 1 : 0].data();
+}
+
+inline uint8_t clamp_sample(float v) {
+    int i = static_cast<int>(std::lrintf(v + 128.0f));
+    return static_cast<uint8_t>(std::min(255, std::max(0, i)));
+}
+
+// Inverse transform of the n x n low-frequency corner (natural order,
+// dequantized) into an n x n block of samples
+void idct_scaled(const float* coef, int n, uint8_t* out, int stride) {
+    if (n == 1) {
+        out[0] = clamp_sample(coef[0] / 8.0f);
+        return;
+    }
+    const float* t = idct_table(n);
+    float rows[64];
+    for (int v = 0; v < n; ++v) {
+        for (int x = 0; x < n; ++x) {
+            float s = 0.0f;
+            for (int u = 0; u < n; ++u) {
+                s += t[x * n + u] * coef[v * 8 + u];
+            }
+            rows[v * 8 + x] = s;
+        }
+    }
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) {
+            float s = 0.0f;
+            for (int v = 0; v < n; ++v) {
+                s += t[y * n + v] * rows[v * 8 + x];
+            }
+            out[static_cast<size_t>(y) * stride + x] = clamp_sample(s);
+        }
+    }
+}
+
+struct Component {
+    int id = 0;
+    int h = 1, v = 1;      // sampling factors
+    int quant = 0;         // quantization table
+    int dc = 0, ac = 0;    // Huffman tables of the current scan
+    int pred = 0;          // DC predictor
+    int blocks_x = 0;      // block grid covering whole MCUs
+    int blocks_y = 0;
+    std::vector<uint8_t> plane; // reduced samples, blocks_x * n wide
+};
+
+class Decoder {
+public:
+    Decoder(const uint8_t* data, size_t size, int scale)
+        : data_(data), end_(data + size), n_(8 / scale) {}
+
+    void run(Image& image);
+
+private:
+    const uint8_t* data_;
+    const uint8_t* end_;
+    int n_; // reduced block size
+
+    uint16_t quant_[4][64] = {}; // natural order
+    Huffman dc_[4], ac_[4];
+    int restart_interval_ = 0;
+    int adobe_transform_ = -1;
+
+    int width_ = 0, height_ = 0;
+    int hmax_ = 1, vmax_ = 1;
+    int mcus_x_ = 0, mcus_y_ = 0;
+    std::vector<Component> components_;
+    std::vector<int> scan_; // component indices of the current scan
+    int scans_ = 0;
+
+    void read_quant(const uint8_t* p, int length);
+    void read_huffman(const uint8_t* p, int length);
+    void read_frame(const uint8_t* p, int length);
+    void read_scan(const uint8_t* p, int length);
+    // Returns the position of the marker that ends the scan
+    const uint8_t* decode_scan(const uint8_t* p);
+    void decode_block(BitReader& bits, Component& c, int bx, int by);
+    void restart(BitReader& bits);
+    void to_rgb(Image& image) const;
+};
+
+void Decoder::run(Image& image) {
+    if (end_ - data_ < 2 || data_[0] != 0xFF || data_[1] != 0xD8) {
+        throw DecodeError();
+    }
+    const uint8_t* p = data_ + 2;
+    while (true) {
+        while (p < end_ && *p != 0xFF) {
+            ++p; // tolerate garbage between segments
+        }
+        while (p < end_ && *p == 0xFF) {
+            ++p;
+        }
+        if (p >= end_) {
+            if (scans_ == 0) throw DecodeError();
+            break; // missing EOI
+        }
+        uint8_t marker = *p++;
+        if (marker == 0xD9) {
+            break;
+        }
+        if ((marker >= 0xD0 && marker <= 0xD7) || marker == 0x01) {
+            continue; // no payload
+        }
+        if (end_ - p < 2) throw DecodeError();
+        int length = read_u16(p);
+        if (length < 2 || length > end_ - p) throw DecodeError();
+        const uint8_t* segment = p + 2;
+        p += length;
+        length -= 2;
+
+        switch (marker) {
+        case 0xC0:
+        case 0xC1:
+            read_frame(segment, length);
+            break;
+        case 0xC4:
+            read_huffman(segment, length);
+            break;
+        case 0xDB:
+            read_quant(segment, length);
+            break;
+        case 0xDD:
+            if (length < 2) throw DecodeError();
+            restart_interval_ = read_u16(segment);
+            break;
+        case 0xEE:
+            if (length >= 12 && std::equal(segment, segment + 5, "Adobe")) {
+                adobe_transform_ = segment[11];
+            }
+            break;
+        case 0xDA:
+            read_scan(segment, length);
+            p = decode_scan(p);
+            ++scans_;
+            break;
+        default:
+            // Progressive, lossless, hierarchical and arithmetic coding
+            if (marker >= 0xC2 && marker <= 0xCF) throw DecodeError();
+            break; // APPn, COM, ...
+        }
+    }
+    to_rgb(image);
+}
+
+void Decoder::read_quant(const uint8_t* p, int length) {
+    while (length > 0) {
+        int precision = p[0] >> 4, id = p[0] & 15;
+        int bytes = 1 + 64 * (precision ? 2 : 1);
+        if (id > 3 || precision > 1 || length < bytes) throw DecodeError();
+        for (int k = 0; k < 64; ++k) {
+            quant_[id][kZigzag[k]] = precision ? read_u16(p + 1 + 2 * k) : p[1 + k];
+        }
+        p += bytes;
+        length -= bytes;
+    }
+}
+
+void Decoder::read_huffman(const uint8_t* p, int length) {
+    while (length > 0) {
+        if (length < 17) throw DecodeError();
+        int cls = p[0] >> 4, id = p[0] & 15;
+        int total = 0;
+        for (int i = 0; i < 16; ++i) {
+            total += p[1 + i];
+        }
+        if (cls > 1 || id > 3 || total > 256 || length < 17 + total) throw DecodeError();
+        build_huffman(cls ? ac_[id] : dc_[id], p + 1, p + 17, total);
+        p += 17 + total;
+        length -= 17 + total;
+    }
+}
+
+void Decoder::read_frame(const uint8_t* p, int length) {
+    if (length < 6 || p[0] != 8 || !components_.empty()) throw DecodeError();
+    height_ = read_u16(p + 1);
+    width_ = read_u16(p + 3);
+    int count = p[5];
+    if (width_ == 0 || height_ == 0 || (count != 1 && count != 3) || length < 6 + 3 * count) {
+        throw DecodeError();
+    }
+    components_.resize(count);
+    for (int i = 0; i < count; ++i) {
+        Component& c = components_[i];
+        c.id = p[6 + 3 * i];
+        c.h = p[7 + 3 * i] >> 4;
+        c.v = p[7 + 3 * i] & 15;
+        c.quant = p[8 + 3 * i];
+        if (c.h < 1 || c.h > 4 || c.v < 1 || c.v > 4 || c.quant > 3) throw DecodeError();
+        hmax_ = std::max(hmax_, c.h);
+        vmax_ = std::max(vmax_, c.v);
+    }
+    mcus_x_ = (width_ + 8 * hmax_ - 1) / (8 * hmax_);
+    mcus_y_ = (height_ + 8 * vmax_ - 1) / (8 * vmax_);
+    for (Component& c : components_) {
+        c.blocks_x = mcus_x_ * c.h;
+        c.blocks_y = mcus_y_ * c.v;
+        c.plane.assign(static_cast<size_t>(c.blocks_x) * n_ * c.blocks_y * n_, 0);
+    }
+}
+
+void Decoder::read_scan(const uint8_t* p, int length) {
+    if (components_.empty() || length < 1) throw DecodeError();
+    int count = p[0];
+    if (count < 1 || count > static_cast<int>(components_.size()) || length < 4 + 2 * count) {
+        throw DecodeError();
+    }
+    scan_.clear();
+    for (int i = 0; i < count; ++i) {
+        int id = p[1 + 2 * i];
+        auto it = std::find_if(components_.begin(), components_.end(),
+                               [id](const Component& c) { return c.id == id; });
+        if (it == components_.end()) throw DecodeError();
+        it->dc = p[2 + 2 * i] >> 4;
+        it->ac = p[2 + 2 * i] & 15;
+        if (it->dc > 3 || it->ac > 3 || !dc_[it->dc].defined || !ac_[it->ac].defined) {
+            throw DecodeError();
+        }
+        scan_.push_back(static_cast<int>(it - components_.begin()));
+    }
+}
+
+void Decoder::decode_block(BitReader& bits, Component& c, int bx, int by) {
+    const uint16_t* q = quant_[c.quant];
+    float coef[64];
+    for (int v = 0; v < n_; ++v) {
+        std::fill(coef + v * 8, coef + v * 8 + n_, 0.0f);
+    }
+
+    int t = bits.decode(dc_[c.dc]);
+    if (t > 11) throw DecodeError();
+    c.pred += bits.receive_extend(t);
+    coef[0] = static_cast<float>(c.pred * q[0]);
+
+    const Huffman& ac = ac_[c.ac];
+    bool has_ac = false;
+    for (int k = 1; k < 64;) {
+        int value;
+        if (bits.bits < 16) bits.fill();
+        int fast = ac.fast_ac[bits.buf >> (32 - kFastBits)];
+        if (fast) {
+            k += (fast >> 4) & 15;
+            bits.consume(fast & 15);
+            value = fast >> 8;
+        } else {
+            int rs = bits.decode(ac);
+            int run = rs >> 4, s = rs & 15;
+            if (s == 0) {
+                if (run != 15) break; // end of block
+                k += 16;
+                continue;
+            }
+            k += run;
+            value = bits.receive_extend(s);
+        }
+        if (k > 63) throw DecodeError();
+        int z = kZigzag[k++];
+        // Only the low-frequency corner survives the reduction
+        if ((z & 7) < n_ && (z >> 3) < n_) {
+            coef[z] = static_cast<float>(value * q[z]);
+            has_ac = true;
+        }
+    }
+
+    size_t stride = static_cast<size_t>(c.blocks_x) * n_;
+    uint8_t* out = c.plane.data() + static_cast<size_t>(by) * n_ * stride + bx * n_;
+    if (!has_ac) {
+        uint8_t dc = clamp_sample(coef[0] / 8.0f);
+        for (int y = 0; y < n_; ++y) {
+            std::fill(out + y * stride, out + y * stride + n_, dc);
+        }
+        return;
+    }
+    idct_scaled(coef, n_, out, static_cast<int>(stride));
+}
+
+void Decoder::restart(BitReader& bits) {
+    const uint8_t* p = bits.p;
+    while (p + 1 < end_ && !(p[0] == 0xFF && p[1] >= 0xD0 && p[1] <= 0xD7)) {
+        ++p;
+    }
+    bits = BitReader(std::min(p + 2, end_), end_);
+    for (Component& c : components_) {
+        c.pred = 0;
+    }
+}
+
+const uint8_t* Decoder::decode_scan(const uint8_t* p) {
+    BitReader bits(p, end_);
+    for (Component& c : components_) {
+        c.pred = 0;
+    }
+    // Every restart_interval_ units the stream is byte-aligned behind an RSTn
+    int units = 0;
+    // Data that runs out before the last unit is an error, not zeros
+    auto next_unit = [&] {
+        if (bits.overrun()) {
+            throw DecodeError();
+        }
+        if (restart_interval_ > 0 && units > 0 && units % restart_interval_ == 0) {
+            restart(bits);
+        }
+        ++units;
+    };
+
+    if (scan_.size() == 1) {
+        // Non-interleaved: one block per unit over the component's own extent
+        Component& c = components_[scan_[0]];
+        int cols = ((width_ * c.h + hmax_ - 1) / hmax_ + 7) / 8;
+        int rows = ((height_ * c.v + vmax_ - 1) / vmax_ + 7) / 8;
+        for (int by = 0; by < rows; ++by) {
+            for (int bx = 0; bx < cols; ++bx) {
+                next_unit();
+                decode_block(bits, c, bx, by);
+            }
+        }
+    } else {
+        for (int my = 0; my < mcus_y_; ++my) {
+            for (int mx = 0; mx < mcus_x_; ++mx) {
+                next_unit();
+                for (int index : scan_) {
+                    Component& c = components_[index];
+                    for (int v = 0; v < c.v; ++v) {
+                        for (int h = 0; h < c.h; ++h) {
+                            decode_block(bits, c, mx * c.h + h, my * c.v + v);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (bits.overrun()) {
+        throw DecodeError();
+    }
+
+    // Skip to the marker ending the scan (past any trailing RSTn)
+    const uint8_t* q = bits.p;
+    while (q + 1 < end_ && !(q[0] == 0xFF && q[1] != 0x00 && !(q[1] >= 0xD0 && q[1] <= 0xD7))) {
+        ++q;
+    }
+    return q + 1 < end_ ? q : end_;
+}
+
+void Decoder::to_rgb(Image& image) const {
+    if (components_.empty()) throw DecodeError();
+    int scale = 8 / n_;
+    image.width = scaled_size(width_, scale);
+    image.height = scaled_size(height_, scale);
+    image.rgb.resize(static_cast<size_t>(image.width) * image.height * 3);
+
+    // Chroma is upsampled by replication
+    size_t count = components_.size();
+    std::vector<std::vector<int>> column(count);
+    for (size_t i = 0; i < count; ++i) {
+        column[i].resize(image.width);
+        for (int x = 0; x < image.width; ++x) {
+            column[i][x] = x * components_[i].h / hmax_;
+        }
+    }
+    bool ycbcr = count == 3 && adobe_transform_ != 0 &&
+                 !(components_[0].id == 'R' && components_[1].id == 'G' && components_[2].id == 'B');
+
+    for (int y = 0; y < image.height; ++y) {
+        const uint8_t* row[3] = {};
+        for (size_t i = 0; i < count; ++i) {
+            const Component& c = components_[i];
+            row[i] = c.plane.data() + static_cast<size_t>(y * c.v / vmax_) * c.blocks_x * n_;
+        }
+        uint8_t* out = image.rgb.data() + static_cast<size_t>(y) * image.width * 3;
+        const int* x0 = column[0].data();
+        if (count == 1) {
+            for (int x = 0; x < image.width; ++x, out += 3) {
+                out[0] = out[1] = out[2] = row[0][x0[x]];
+            }
+            continue;
+        }
+        const int* x1 = column[1].data();
+        const int* x2 = column[2].data();
+        if (!ycbcr) {
+            for (int x = 0; x < image.width; ++x, out += 3) {
+                out[0] = row[0][x0[x]];
+                out[1] = row[1][x1[x]];
+                out[2] = row[2][x2[x]];
+            }
+            continue;
+        }
+        // JFIF YCbCr -> RGB in 16.16 fixed point
+        for (int x = 0; x < image.width; ++x, out += 3) {
+            int base = (row[0][x0[x]] << 16) + 32768;
+            int cb = row[1][x1[x]] - 128, cr = row[2][x2[x]] - 128;
+            out[0] = static_cast<uint8_t>(std::min(255, std::max(0, (base + 91881 * cr) >> 16)));
+            out[1] = static_cast<uint8_t>(std::min(255, std::max(0, (base - 22554 * cb - 46802 * cr) >> 16)));
+            out[2] = static_cast<uint8_t>(std::min(255, std::max(0, (base + 116130 * cb) >> 16)));
+        }
+    }
+}
+
+} // namespace
+
+bool read_header(const uint8_t* data, size_t size, Header& header) {
+    const uint8_t* end = data + size;
+    if (size < 2 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+    const uint8_t* p = data + 2;
+    while (p + 4 <= end) {
+        if (*p != 0xFF) {
+            ++p;
+            continue;
+        }
+        while (p < end && *p == 0xFF) ++p;
+        if (p >= end) break;
+        uint8_t marker = *p++;
+        if ((marker >= 0xD0 && marker <= 0xD7) || marker == 0x01) {
+            continue;
+        }
+        if (marker == 0xD9 || marker == 0xDA || end - p < 2) {
+            break; // no frame header before the image data
+        }
+        int length = read_u16(p);
+        if (length < 2 || end - p < length) {
+            return false;
+        }
+        bool frame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 &&
+                     marker != 0xCC;
+        if (frame) {
+            if (length < 8) return false;
+            header.height = read_u16(p + 3);
+            header.width = read_u16(p + 5);
+            header.components = p[7];
+            header.supported = (marker == 0xC0 || marker == 0xC1) && p[2] == 8 &&
+                               (header.components == 1 || header.components == 3);
+            return header.width > 0 && header.height > 0;
+        }
+        p += length;
+    }
+    return false;
+}
+
+int scale_for(const Header& header, int min_side) {
+    int scale = 1;
+    while (scale < 8 && scaled_size(header.width, scale * 2) >= min_side &&
+           scaled_size(header.height, scale * 2) >= min_side) {
+        scale *= 2;
+    }
+    return scale;
+}
+
+bool decode(const uint8_t* data, size_t size, int scale, Image& image) {
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8) {
+        return false;
+    }
+    try {
+        Decoder(data, size, scale).run(image);
+        return true;
+    } catch (const DecodeError&) {
+        return false;
+    }
+}
+
+} // namespace jpeg
@@ -1,27 +1,116 @@
 #include "layers.h"
+#include "gemm.h"
+#include "simd.h"
+#include "thread_pool.h"
 #include <cmath>
 #include <iostream>
 
-// Optimized conv2d implementation
-Tensor conv2d(const Tensor& input, const Tensor& weight, 
-              int stride, int padding, int groups) {
-    // Input: [N, C_in, H, W]
-    // Weight: [C_out, C_in/groups, kH, kW]
-    
+// Unfold one image [C, H, W] into columns [C * kH * kW, H_out * W_out]
+static void im2col(const float* input, int C, int H, int W,
+                   int kH, int kW, int stride, int padding,
+                   int H_out, int W_out, float* col) {
+    // Each (c, kh, kw) fills one independent column row
+    parallel::parallel_for(C * kH * kW, [&](int begin, int end) {
+        for (int r = begin; r < end; ++r) {
+            int c = r / (kH * kW);
+            int kh = r / kW % kH;
+            int kw = r % kW;
+            float* dst = col + static_cast<size_t>(r) * H_out * W_out;
+            for (int oh = 0; oh < H_out; ++oh) {
+                int ih = oh * stride - padding + kh;
+                if (ih < 0 || ih >= H) {
+                    std::fill(dst, dst + W_out, 0.0f);
+                    dst += W_out;
+                    continue;
+                }
+                const float* row = input + (c * H + ih) * W;
+                for (int ow = 0; ow < W_out; ++ow) {
+                    int iw = ow * stride - padding + kw;
+                    *dst++ = (iw >= 0 && iw < W) ? row[iw] : 0.0f;
+                }
+            }
+        }
+    });
+}
+
+// Dense conv (groups == 1) lowered onto SGEMM:
+// output[C_out, H_out * W_out] = weight[C_out, C_in * kH * kW] * col
+void conv2d_packed_into(const float* input, int N, int C_in, int H_in, int W_in,
+                        const gemm::PackedMatrix& weight, int kH, int kW,
+                        int stride, int padding, const float* bias, bool relu6,
+                        float* output, float* col) {
+    int C_out = weight.rows();
+    int H_out = conv_out_size(H_in, kH, stride, padding);
+    int W_out = conv_out_size(W_in, kW, stride, padding);
+    int K = C_in * kH * kW;
+    int HW_out = H_out * W_out;
+
+    if (weight.cols() != K) {
+        throw std::runtime_error("conv2d: weight does not match input channels");
+    }
+
+    gemm::Epilogue epilogue;
+    epilogue.bias = bias;
+    epilogue.relu6 = relu6;
+    const gemm::Epilogue* ep = (bias || relu6) ? &epilogue : nullptr;
+
+    // 1x1 stride-1 convs read the input image directly as the B matrix
+    bool direct = conv2d_col_size(C_in, H_in, W_in, kH, kW, stride, padding) == 0;
+
+    for (int n = 0; n < N; ++n) {
+        const float* in = input + static_cast<size_t>(n) * C_in * H_in * W_in;
+        float* out = output + static_cast<size_t>(n) * C_out * HW_out;
+
+        if (direct) {
+            gemm::sgemm_packed(weight, HW_out, in, HW_out, out, HW_out, false, ep);
+        } else {
+            im2col(in, C_in, H_in, W_in, kH, kW, stride, padding, H_out, W_out, col);
+            gemm::sgemm_packed(weight, HW_out, col, HW_out, out, HW_out, false, ep);
+        }
+    }
+}
+
+size_t conv2d_col_size(int C_in, int H_in, int W_in, int kH, int kW,
+                       int stride, int padding) {
+    if (kH == 1 && kW == 1 && stride == 1 && padding == 0) {
+        return 0;
+    }
+    size_t H_out = conv_out_size(H_in, kH, stride, padding);
+    size_t W_out = conv_out_size(W_in, kW, stride, padding);
+    return static_cast<size_t>(C_in) * kH * kW * H_out * W_out;
+}
+
+Tensor conv2d_packed(const Tensor& input, const gemm::PackedMatrix& weight,
+                     int kH, int kW, int stride, int padding,
+                     const float* bias, bool relu6) {
     int N = input.shape[0];
     int C_in = input.shape[1];
     int H_in = input.shape[2];
     int W_in = input.shape[3];
+
+    Tensor output({N, weight.rows(),
+                   conv_out_size(H_in, kH, stride, padding),
+                   conv_out_size(W_in, kW, stride, padding)});
+    std::vector<float> col(conv2d_col_size(C_in, H_in, W_in, kH, kW, stride, padding));
+
+    conv2d_packed_into(input.ptr(), N, C_in, H_in, W_in, weight, kH, kW,
+                       stride, padding, bias, relu6, output.ptr(), col.data());
+    return output;
+}
+
+// Generic grouped conv (direct loops)
+void grouped_conv2d_into(const float* input, int N, int C_in, int H_in, int W_in,
+                         const Tensor& weight, int stride, int padding, int groups,
+                         float* output) {
+    // Input: [N, C_in, H, W]
+    // Weight: [C_out, C_in/groups, kH, kW]
     
     int C_out = weight.shape[0];
     int kH = weight.shape[2];
     int kW = weight.shape[3];
     
-    int H_out = (H_in + 2 * padding - kH) / stride + 1;
-    int W_out = (W_in + 2 * padding - kW) / stride + 1;
-    
-    Tensor output({N, C_out, H_out, W_out});
-    std::fill(output.data.begin(), output.data.end(), 0.0f);
+    int H_out = conv_out_size(H_in, kH, stride, padding);
+    int W_out = conv_out_size(W_in, kW, stride, padding);
     
     int C_per_group = C_in / groups;
     int C_out_per_group = C_out / groups;
@@ -46,20 +135,179 @@ Tensor conv2d(const Tensor& input, const Tensor& weight,
                                     if (ih >= 0 && ih < H_in && iw >= 0 && iw < W_in) {
                                         int input_idx = ((n * C_in + in_ch) * H_in + ih) * W_in + iw;
                                         int weight_idx = ((out_ch * C_per_group + ic) * kH + kh) * kW + kw;
-                                        sum += input.data[input_idx] * weight.data[weight_idx];
+                                        sum += input[input_idx] * weight.ptr()[weight_idx];
                                     }
                                 }
                             }
                         }
                         
                         int output_idx = ((n * C_out + out_ch) * H_out + oh) * W_out + ow;
-                        output.data[output_idx] = sum;
+                        output[output_idx] = sum;
                     }
                 }
             }
         }
     }
+}
+
+// Optimized conv2d implementation
+Tensor conv2d(const Tensor& input, const Tensor& weight, 
+              int stride, int padding, int groups) {
+    if (groups == 1) {
+        int C_out = weight.shape[0];
+        int K = weight.shape[1] * weight.shape[2] * weight.shape[3];
+        gemm::PackedMatrix packed(weight.ptr(), C_out, K, K);
+        return conv2d_packed(input, packed, weight.shape[2], weight.shape[3], stride, padding);
+    }
+    
+    int N = input.shape[0];
+    int H_out = conv_out_size(input.shape[2], weight.shape[2], stride, padding);
+    int W_out = conv_out_size(input.shape[3], weight.shape[3], stride, padding);
     
+    Tensor output({N, weight.shape[0], H_out, W_out});
+    grouped_conv2d_into(input.ptr(), N, input.shape[1], input.shape[2], input.shape[3],
+                        weight, stride, padding, groups, output.ptr());
+    return output;
+}
+
+// One 3x3 output point with zero padding handled by explicit bounds checks.
+// Only used for the border ring of each output plane.
+static inline float dw3x3_border(const float* in, int H, int W,
+                                 const float* k, int ih0, int iw0) {
+    float sum = 0.0f;
+    for (int kh = 0; kh < 3; ++kh) {
+        int ih = ih0 + kh;
+        if (ih < 0 || ih >= H) continue;
+        for (int kw = 0; kw < 3; ++kw) {
+            int iw = iw0 + kw;
+            if (iw < 0 || iw >= W) continue;
+            sum += in[ih * W + iw] * k[kh * 3 + kw];
+        }
+    }
+    return sum;
+}
+
+// Interior 3x3 point, all taps in bounds
+static inline float dw3x3_interior(const float* r0, const float* r1, const float* r2,
+                                   const float* k, int iw) {
+    return r0[iw] * k[0] + r0[iw + 1] * k[1] + r0[iw + 2] * k[2] +
+           r1[iw] * k[3] + r1[iw + 1] * k[4] + r1[iw + 2] * k[5] +
+           r2[iw] * k[6] + r2[iw + 1] * k[7] + r2[iw + 2] * k[8];
+}
+
+// One channel plane of a padding-1 depthwise 3x3 conv.
+// The output splits into a border ring (bounds-checked scalar code) and an
+// interior where all nine taps are valid; the interior is vectorized along W.
+template <int STRIDE>
+static void dw3x3_plane(const float* in, int H, int W, const float* k,
+                        float* out, int H_out, int W_out, float bias, bool relu6) {
+    // Output columns [1, ow_end) and rows [1, oh_end) never touch padding
+    int ow_end = std::min(W_out, (W - 2) / STRIDE + 1);
+    int oh_end = std::min(H_out, (H - 2) / STRIDE + 1);
+
+    // Last column whose full vector load stays inside the input row
+    constexpr int VW = simd::kWidth;
+    int ow_vec_end = STRIDE == 1 ? W - VW : (W - 2 * VW + 1) / 2;
+    ow_vec_end = std::min(ow_vec_end, ow_end - VW + 1);
+
+    simd::vfloat kv[9];
+    for (int i = 0; i < 9; ++i) kv[i] = simd::set1(k[i]);
+    simd::vfloat bv = simd::set1(bias);
+    simd::vfloat lo = simd::zero(), hi = simd::set1(6.0f);
+
+    auto finish = [&](float v) {
+        v += bias;
+        return relu6 ? std::min(std::max(v, 0.0f), 6.0f) : v;
+    };
+
+    for (int oh = 0; oh < H_out; ++oh) {
+        int ih0 = oh * STRIDE - 1;
+        float* orow = out + oh * W_out;
+
+        if (oh == 0 || oh >= oh_end) {
+            for (int ow = 0; ow < W_out; ++ow) {
+                orow[ow] = finish(dw3x3_border(in, H, W, k, ih0, ow * STRIDE - 1));
+            }
+            continue;
+        }
+
+        const float* r0 = in + ih0 * W;
+        const float* r1 = r0 + W;
+        const float* r2 = r1 + W;
+
+        orow[0] = finish(dw3x3_border(in, H, W, k, ih0, -1));
+
+        int ow = 1;
+        for (; ow < ow_vec_end; ow += VW) {
+            int iw = ow * STRIDE - 1;
+            simd::vfloat acc;
+            if (STRIDE == 1) {
+                acc = simd::mul(simd::load(r0 + iw), kv[0]);
+                acc = simd::fmadd(simd::load(r0 + iw + 1), kv[1], acc);
+                acc = simd::fmadd(simd::load(r0 + iw + 2), kv[2], acc);
+                acc = simd::fmadd(simd::load(r1 + iw), kv[3], acc);
+                acc = simd::fmadd(simd::load(r1 + iw + 1), kv[4], acc);
+                acc = simd::fmadd(simd::load(r1 + iw + 2), kv[5], acc);
+                acc = simd::fmadd(simd::load(r2 + iw), kv[6], acc);
+                acc = simd::fmadd(simd::load(r2 + iw + 1), kv[7], acc);
+                acc = simd::fmadd(simd::load(r2 + iw + 2), kv[8], acc);
+            } else {
+                acc = simd::mul(simd::load_even(r0 + iw), kv[0]);
+                acc = simd::fmadd(simd::load_even(r0 + iw + 1), kv[1], acc);
+                acc = simd::fmadd(simd::load_even(r0 + iw + 2), kv[2], acc);
+                acc = simd::fmadd(simd::load_even(r1 + iw), kv[3], acc);
+                acc = simd::fmadd(simd::load_even(r1 + iw + 1), kv[4], acc);
+                acc = simd::fmadd(simd::load_even(r1 + iw + 2), kv[5], acc);
+                acc = simd::fmadd(simd::load_even(r2 + iw), kv[6], acc);
+                acc = simd::fmadd(simd::load_even(r2 + iw + 1), kv[7], acc);
+                acc = simd::fmadd(simd::load_even(r2 + iw + 2), kv[8], acc);
+            }
+            acc = simd::add(acc, bv);
+            if (relu6) acc = simd::min(simd::max(acc, lo), hi);
+            simd::store(orow + ow, acc);
+        }
+        for (; ow < ow_end; ++ow) {
+            orow[ow] = finish(dw3x3_interior(r0, r1, r2, k, ow * STRIDE - 1));
+        }
+        for (; ow < W_out; ++ow) {
+            orow[ow] = finish(dw3x3_border(in, H, W, k, ih0, ow * STRIDE - 1));
+        }
+    }
+}
+
+void depthwise_conv3x3_into(const float* input, int N, int C, int H, int W,
+                            const float* weight, int stride,
+                            const float* bias, bool relu6, float* output) {
+    // Input: [N, C, H, W], Weight: [C, 1, 3, 3], padding 1
+    int H_out = conv_out_size(H, 3, stride, 1);
+    int W_out = conv_out_size(W, 3, stride, 1);
+
+    for (int n = 0; n < N; ++n) {
+        for (int c = 0; c < C; ++c) {
+            const float* in = input + static_cast<size_t>(n * C + c) * H * W;
+            float* out = output + static_cast<size_t>(n * C + c) * H_out * W_out;
+            const float* k = weight + c * 9;
+            float b = bias ? bias[c] : 0.0f;
+
+            if (stride == 1) {
+                dw3x3_plane<1>(in, H, W, k, out, H_out, W_out, b, relu6);
+            } else {
+                dw3x3_plane<2>(in, H, W, k, out, H_out, W_out, b, relu6);
+            }
+        }
+    }
+}
+
+Tensor depthwise_conv3x3(const Tensor& input, const Tensor& weight, int stride,
+                         const float* bias, bool relu6) {
+    int N = input.shape[0];
+    int C = input.shape[1];
+    int H = input.shape[2];
+    int W = input.shape[3];
+
+    Tensor output({N, C, conv_out_size(H, 3, stride, 1), conv_out_size(W, 3, stride, 1)});
+    depthwise_conv3x3_into(input.ptr(), N, C, H, W, weight.ptr(), stride,
+                           bias, relu6, output.ptr());
     return output;
 }
 
@@ -76,10 +324,10 @@ Tensor batchnorm2d(const Tensor& input, const Tensor& weight,
     
     for (int n = 0; n < N; ++n) {
         for (int c = 0; c < C; ++c) {
-            float mean = running_mean.data[c];
-            float var = running_var.data[c];
-            float gamma = weight.data[c];
-            float beta = bias.data[c];
+            float mean = running_mean.ptr()[c];
+            float var = running_var.ptr()[c];
+            float gamma = weight.ptr()[c];
+            float beta = bias.ptr()[c];
             
             float scale = gamma / std::sqrt(var + eps);
             
@@ -133,33 +381,122 @@ Tensor adaptive_avg_pool2d(const Tensor& input, int output_h, int output_w) {
     return output;
 }
 
-// Linear (fully connected)
-Tensor linear(const Tensor& input, const Tensor& weight, const Tensor* bias) {
+// Global average pool: [N, C, HW] -> [N, C]
+void global_avg_pool_into(const float* input, int N, int C, int HW, float* output) {
+    float inv = 1.0f / HW;
+    for (int nc = 0; nc < N * C; ++nc) {
+        const float* plane = input + static_cast<size_t>(nc) * HW;
+        float sum = 0.0f;
+        for (int i = 0; i < HW; ++i) {
+            sum += plane[i];
+        }
+        output[nc] = sum * inv;
+    }
+}
+
+template <class T>
+static inline float dot(const float* a, const T* b, int n) {
+    simd::vfloat acc = simd::zero();
+    int i = 0;
+    for (; i + simd::kWidth <= n; i += simd::kWidth) {
+        acc = simd::fmadd(simd::load(a + i), simd::load(b + i), acc);
+    }
+    float lanes[simd::kWidth];
+    simd::store(lanes, acc);
+    float sum = 0.0f;
+    for (int l = 0; l < simd::kWidth; ++l) sum += lanes[l];
+    for (; i < n; ++i) sum += a[i] * simd::to_float(b[i]);
+    return sum;
+}
+
+void linear_into(const float* input, int N, int in_features,
+                 const Tensor& weight, const float* bias, bool relu6, float* output) {
+    linear_into(input, N, in_features, weight.ptr(), weight.shape[0], bias, relu6, output);
+}
+
+template <class T>
+void linear_into(const float* input, int N, int in_features, const T* weight,
+                 int out_features, const float* bias, bool relu6, float* output) {
     // Input: [N, in_features]
     // Weight: [out_features, in_features]
     // Output: [N, out_features]
-    
+    // Samples are the inner loop so a batch reads each weight row once;
+    // threads split the output features
+    parallel::parallel_for(out_features, [&](int begin, int end) {
+        for (int o = begin; o < end; ++o) {
+            const T* w = weight + static_cast<size_t>(o) * in_features;
+            for (int n = 0; n < N; ++n) {
+                float sum = dot(input + static_cast<size_t>(n) * in_features, w, in_features);
+                if (bias) sum += bias[o];
+                if (relu6) sum = std::min(std::max(sum, 0.0f), 6.0f);
+                output[n * out_features + o] = sum;
+            }
+        }
+    }, 16);
+}
+
+template void linear_into<float>(const float*, int, int, const float*, int, const float*,
+                                 bool, float*);
+template void linear_into<simd::fp16>(const float*, int, int, const simd::fp16*, int,
+                                      const float*, bool, float*);
+template void linear_into<simd::bf16>(const float*, int, int, const simd::bf16*, int,
+                                      const float*, bool, float*);
+
+// Linear (fully connected)
+Tensor linear(const Tensor& input, const Tensor& weight, const Tensor* bias) {
     int N = input.shape[0];
     int in_features = input.shape[1];
     int out_features = weight.shape[0];
     
     Tensor output({N, out_features});
-    
-    for (int n = 0; n < N; ++n) {
-        for (int o = 0; o < out_features; ++o) {
-            float sum = 0.0f;
-            
-            for (int i = 0; i < in_features; ++i) {
-                sum += input.data[n * in_features + i] * weight.data[o * in_features + i];
-            }
-            
-            if (bias) {
-                sum += bias->data[o];
-            }
-            
-            output.data[n * out_features + o] = sum;
+    linear_into(input.ptr(), N, in_features, weight, bias ? bias->ptr() : nullptr,
+                false, output.ptr());
+    return output;
+}
+
+size_t se_block_scratch_size(int N, int C, const Tensor& fc1_weight) {
+    return static_cast<size_t>(N) * (2 * C + fc1_weight.shape[0]);
+}
+
+// Squeeze-Excitation: x * sigmoid(fc2(relu6(fc1(avgpool(x))))), in place
+void se_block_inplace(float* x, int N, int C, int HW,
+                      const Tensor& fc1_weight, const Tensor& fc2_weight, float* scratch) {
+    int hidden = fc1_weight.shape[0];
+    float* squeezed = scratch;
+    float* excited = squeezed + static_cast<size_t>(N) * C;
+    float* scale = excited + static_cast<size_t>(N) * hidden;
+
+    // Squeeze: AdaptiveAvgPool2d(1, 1), flattened to [N, C]
+    global_avg_pool_into(x, N, C, HW, squeezed);
+
+    // Excitation: FC -> ReLU6 -> FC -> Sigmoid
+    linear_into(squeezed, N, C, fc1_weight, nullptr, true, excited);
+    linear_into(excited, N, hidden, fc2_weight, nullptr, false, scale);
+    for (int i = 0; i < N * C; ++i) {
+        scale[i] = 1.0f / (1.0f + std::exp(-scale[i]));
+    }
+
+    // Broadcast multiply over each channel plane
+    for (int nc = 0; nc < N * C; ++nc) {
+        float* plane = x + static_cast<size_t>(nc) * HW;
+        simd::vfloat sv = simd::set1(scale[nc]);
+        int i = 0;
+        for (; i + simd::kWidth <= HW; i += simd::kWidth) {
+            simd::store(plane + i, simd::mul(simd::load(plane + i), sv));
+        }
+        for (; i < HW; ++i) {
+            plane[i] *= scale[nc];
         }
     }
-    
+}
+
+Tensor se_block(const Tensor& x, const Tensor& fc1_weight, const Tensor& fc2_weight) {
+    int N = x.shape[0];
+    int C = x.shape[1];
+
+    Tensor output = x;
+    std::vector<float> scratch(se_block_scratch_size(N, C, fc1_weight));
+    se_block_inplace(output.ptr(), N, C, x.shape[2] * x.shape[3],
+                     fc1_weight, fc2_weight, scratch.data());
     return output;
 }
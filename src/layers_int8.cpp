@@ -0,0 +1,585 @@
+// INT8 kernels for the NCHWc layout.
+//
+// Activations are unsigned 8-bit with a per-tensor scale (every quantized
+// layer consumes a ReLU6 output, so zero point is always 0). Weights are
+// signed 8-bit, symmetric, one scale per output channel. Products are
+// accumulated in int32 and requantized with requant[c] = s_in * s_w[c].
+//
+// Pointwise convs and the classifier use VNNI (vpdpbusd) on x86 and USDOT
+// on ARMv8.6 i8mm, falling back to 16-bit multiply-adds (vpmaddwd, vmlal)
+// without them; depthwise convs widen to one 32-bit lane per channel. Other
+// targets use plain C++ loops on int32.
+#include "layers.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr int B = kChannelBlock;
+constexpr int VB = kChannelBlock / simd::kWidth;
+
+// ---------------------------------------------------------------------------
+// Per-ISA primitives on one channel block of int32 accumulators
+//   dw_mac:  acc[c] += x[c] * w[c]                    (depthwise tap)
+//   pw_dot4: acc[c] += sum_j x[j] * w[c][j], j < 4    (pointwise, 4 inputs)
+//   pack_u8: B floats already in [0, 255] -> rounded u8
+// ---------------------------------------------------------------------------
+
+#if defined(__AVX512F__)
+
+struct Acc {
+    __m512i v;
+    void zero() { v = _mm512_setzero_si512(); }
+    simd::vfloat to_float(int) const { return _mm512_cvtepi32_ps(v); }
+};
+
+// Weights are widened to one 32-bit lane per channel; the high 16 bits of
+// every activation lane are zero, so a 16-bit pair multiply is exactly x * w
+using DwWeight = __m512i;
+inline DwWeight dw_load_weight(const int8_t* w) {
+    return _mm512_cvtepi8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(w)));
+}
+inline void dw_mac(Acc& acc, const uint8_t* x, const DwWeight& w) {
+    __m512i x32 = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x)));
+#if defined(__AVX512VNNI__)
+    acc.v = _mm512_dpwssd_epi32(acc.v, x32, w);
+#else
+    acc.v = _mm512_add_epi32(acc.v, _mm512_madd_epi16(x32, w));
+#endif
+}
+
+inline void pack_u8(const simd::vfloat* r, uint8_t* dst) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm512_cvtusepi32_epi8(_mm512_cvtps_epi32(r[0])));
+}
+
+#elif defined(__AVX2__)
+
+struct Acc {
+    __m256i v;
+    void zero() { v = _mm256_setzero_si256(); }
+    simd::vfloat to_float(int) const { return _mm256_cvtepi32_ps(v); }
+};
+
+using DwWeight = __m256i;
+inline DwWeight dw_load_weight(const int8_t* w) {
+    return _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(w)));
+}
+inline void dw_mac(Acc& acc, const uint8_t* x, const DwWeight& w) {
+    __m256i x32 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(x)));
+#if defined(__AVXVNNI__)
+    acc.v = _mm256_dpwssd_avx_epi32(acc.v, x32, w);
+#else
+    acc.v = _mm256_add_epi32(acc.v, _mm256_madd_epi16(x32, w));
+#endif
+}
+
+inline void pack_u8(const simd::vfloat* r, uint8_t* dst) {
+    __m256i i = _mm256_cvtps_epi32(r[0]);
+    __m128i i16 = _mm_packus_epi32(_mm256_castsi256_si128(i), _mm256_extracti128_si256(i, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(i16, i16));
+}
+
+#elif defined(__ARM_NEON)
+
+struct Acc {
+    int32x4_t v[2];
+    void zero() { v[0] = v[1] = vdupq_n_s32(0); }
+    simd::vfloat to_float(int i) const { return vcvtq_f32_s32(v[i]); }
+};
+
+using DwWeight = int16x8_t;
+inline DwWeight dw_load_weight(const int8_t* w) { return vmovl_s8(vld1_s8(w)); }
+inline void dw_mac(Acc& acc, const uint8_t* x, const DwWeight& w) {
+    int16x8_t x16 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(x)));
+    acc.v[0] = vmlal_s16(acc.v[0], vget_low_s16(x16), vget_low_s16(w));
+    acc.v[1] = vmlal_s16(acc.v[1], vget_high_s16(x16), vget_high_s16(w));
+}
+
+inline void pack_u8(const simd::vfloat* r, uint8_t* dst) {
+    uint16x4_t lo = vqmovun_s32(vcvtnq_s32_f32(r[0]));
+    uint16x4_t hi = vqmovun_s32(vcvtnq_s32_f32(r[1]));
+    vst1_u8(dst, vqmovn_u16(vcombine_u16(lo, hi)));
+}
+
+#else
+
+struct Acc {
+    int32_t v[B];
+    void zero() { std::fill(v, v + B, 0); }
+    simd::vfloat to_float(int i) const { return static_cast<float>(v[i]); }
+};
+
+using DwWeight = const int8_t*;
+inline DwWeight dw_load_weight(const int8_t* w) { return w; }
+inline void dw_mac(Acc& acc, const uint8_t* x, const DwWeight& w) {
+    for (int l = 0; l < B; ++l) acc.v[l] += static_cast<int32_t>(x[l]) * w[l];
+}
+
+inline void pack_u8(const simd::vfloat* r, uint8_t* dst) {
+    for (int l = 0; l < B; ++l) dst[l] = static_cast<uint8_t>(std::nearbyint(r[l]));
+}
+
+#endif
+
+// Pointwise weights are [C_out / B][C_in_pad / 4][B][4]: four input channels
+// of a whole output block form one contiguous vector of B * 4 bytes.
+// Without a u8 x s8 dot product instruction the four inputs are split into
+// two 16-bit pairs and reduced with vpmaddwd (exact: |x * w| < 2^15).
+
+#if defined(__AVX512F__) && defined(__AVX512VNNI__)
+
+using PwWeight = __m512i;
+inline PwWeight pw_load_weight(const int8_t* w) { return _mm512_loadu_si512(w); }
+inline void pw_dot4(Acc& acc, const uint8_t* x, const PwWeight& w) {
+    int32_t word;
+    std::memcpy(&word, x, 4);
+    acc.v = _mm512_dpbusd_epi32(acc.v, _mm512_set1_epi32(word), w);
+}
+constexpr int kPointwiseP = 8;
+
+#elif defined(__AVX512F__)
+
+struct PwWeight { __m512i w01, w23; };
+inline PwWeight pw_load_weight(const int8_t* w) {
+    // Per 128-bit lane: the (x0, x1) bytes of four channels, then (x2, x3)
+    const __m512i split = _mm512_broadcast_i32x4(
+        _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15));
+    __m512i v = _mm512_shuffle_epi8(_mm512_loadu_si512(w), split);
+    v = _mm512_permutexvar_epi64(_mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7), v);
+    return {_mm512_cvtepi8_epi16(_mm512_castsi512_si256(v)),
+            _mm512_cvtepi8_epi16(_mm512_extracti64x4_epi64(v, 1))};
+}
+inline void pw_dot4(Acc& acc, const uint8_t* x, const PwWeight& w) {
+    // Broadcast the four bytes once, zero-extend (x0, x1) and (x2, x3) pairs
+    const __m512i pair01 = _mm512_set1_epi32(static_cast<int32_t>(0x80018000u));
+    const __m512i pair23 = _mm512_set1_epi32(static_cast<int32_t>(0x80038002u));
+    int32_t word;
+    std::memcpy(&word, x, 4);
+    __m512i xv = _mm512_set1_epi32(word);
+    __m512i x01 = _mm512_shuffle_epi8(xv, pair01);
+    __m512i x23 = _mm512_shuffle_epi8(xv, pair23);
+    acc.v = _mm512_add_epi32(acc.v, _mm512_madd_epi16(x01, w.w01));
+    acc.v = _mm512_add_epi32(acc.v, _mm512_madd_epi16(x23, w.w23));
+}
+constexpr int kPointwiseP = 8;
+
+#elif defined(__AVX2__) && defined(__AVXVNNI__)
+
+using PwWeight = __m256i;
+inline PwWeight pw_load_weight(const int8_t* w) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w));
+}
+inline void pw_dot4(Acc& acc, const uint8_t* x, const PwWeight& w) {
+    int32_t word;
+    std::memcpy(&word, x, 4);
+    acc.v = _mm256_dpbusd_avx_epi32(acc.v, _mm256_set1_epi32(word), w);
+}
+constexpr int kPointwiseP = 6;
+
+#elif defined(__AVX2__)
+
+struct PwWeight { __m256i w01, w23; };
+inline PwWeight pw_load_weight(const int8_t* w) {
+    const __m256i split = _mm256_setr_epi8(
+        0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15,
+        0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+    __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(w)), split);
+    v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+    return {_mm256_cvtepi8_epi16(_mm256_castsi256_si128(v)),
+            _mm256_cvtepi8_epi16(_mm256_extracti128_si256(v, 1))};
+}
+inline void pw_dot4(Acc& acc, const uint8_t* x, const PwWeight& w) {
+    // Broadcast the four bytes once, zero-extend (x0, x1) and (x2, x3) pairs
+    const __m256i pair01 = _mm256_set1_epi32(static_cast<int32_t>(0x80018000u));
+    const __m256i pair23 = _mm256_set1_epi32(static_cast<int32_t>(0x80038002u));
+    int32_t word;
+    std::memcpy(&word, x, 4);
+    __m256i xv = _mm256_set1_epi32(word);
+    __m256i x01 = _mm256_shuffle_epi8(xv, pair01);
+    __m256i x23 = _mm256_shuffle_epi8(xv, pair23);
+    acc.v = _mm256_add_epi32(acc.v, _mm256_madd_epi16(x01, w.w01));
+    acc.v = _mm256_add_epi32(acc.v, _mm256_madd_epi16(x23, w.w23));
+}
+constexpr int kPointwiseP = 4; // two weight registers per block: keep the tile in 16 ymm
+
+#elif defined(__ARM_NEON) && defined(__ARM_FEATURE_MATMUL_INT8)
+
+struct PwWeight { int8x16_t lo, hi; };
+inline PwWeight pw_load_weight(const int8_t* w) { return {vld1q_s8(w), vld1q_s8(w + 16)}; }
+inline void pw_dot4(Acc& acc, const uint8_t* x, const PwWeight& w) {
+    uint32_t word;
+    std::memcpy(&word, x, 4);
+    uint8x16_t xv = vreinterpretq_u8_u32(vdupq_n_u32(word));
+    acc.v[0] = vusdotq_s32(acc.v[0], xv, w.lo);
+    acc.v[1] = vusdotq_s32(acc.v[1], xv, w.hi);
+}
+constexpr int kPointwiseP = 6;
+
+#elif defined(__ARM_NEON)
+
+// De-interleaved to one 16-bit vector per input channel
+struct PwWeight { int16x8_t w[4]; };
+inline PwWeight pw_load_weight(const int8_t* w) {
+    int8x8x4_t v = vld4_s8(w);
+    return {{vmovl_s8(v.val[0]), vmovl_s8(v.val[1]), vmovl_s8(v.val[2]), vmovl_s8(v.val[3])}};
+}
+inline void pw_dot4(Acc& acc, const uint8_t* x, const PwWeight& w) {
+    for (int j = 0; j < 4; ++j) {
+        int16_t xj = x[j];
+        acc.v[0] = vmlal_n_s16(acc.v[0], vget_low_s16(w.w[j]), xj);
+        acc.v[1] = vmlal_n_s16(acc.v[1], vget_high_s16(w.w[j]), xj);
+    }
+}
+constexpr int kPointwiseP = 4;
+
+#else
+
+using PwWeight = const int8_t*;
+inline PwWeight pw_load_weight(const int8_t* w) { return w; }
+inline void pw_dot4(Acc& acc, const uint8_t* x, const PwWeight& w) {
+    int32_t x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3];
+    for (int l = 0; l < B; ++l) {
+        acc.v[l] += x0 * w[l * 4] + x1 * w[l * 4 + 1] + x2 * w[l * 4 + 2] + x3 * w[l * 4 + 3];
+    }
+}
+constexpr int kPointwiseP = 4;
+
+#endif
+
+// ---------------------------------------------------------------------------
+// Depthwise KxK over output rows [oh_begin, oh_end) of one channel block
+// plane [H][W][B], u8 in, u8 out
+// ---------------------------------------------------------------------------
+
+template <int K>
+void dw_u8_plane(const uint8_t* in, int H, int W, const int8_t* k, int stride, int pad,
+                 const float* requant, const float* bias, bool relu6, float out_inv_scale,
+                 uint8_t* out, int W_out, int oh_begin, int oh_end) {
+    DwWeight kv[K * K];
+    for (int t = 0; t < K * K; ++t) kv[t] = dw_load_weight(k + t * B);
+
+    // Output scale folded into the requantization: q = acc * rq' + b',
+    // clamped to [0, hi] where hi covers ReLU6 and the u8 range
+    simd::vfloat rqv[VB], bv[VB];
+    for (int v = 0; v < VB; ++v) {
+        rqv[v] = simd::mul(simd::load(requant + v * simd::kWidth), simd::set1(out_inv_scale));
+        bv[v] = simd::mul(simd::load(bias + v * simd::kWidth), simd::set1(out_inv_scale));
+    }
+    simd::vfloat hi = simd::set1(relu6 ? std::min(255.0f, 6.0f * out_inv_scale) : 255.0f);
+
+    auto emit = [&](const Acc& acc, uint8_t* o) {
+        simd::vfloat r[VB];
+        for (int v = 0; v < VB; ++v) {
+            r[v] = simd::min(simd::max(simd::fmadd(acc.to_float(v), rqv[v], bv[v]), simd::zero()), hi);
+        }
+        pack_u8(r, o);
+    };
+
+    // Output columns [ow_lo, ow_hi) read no horizontal padding
+    int ow_lo = std::min(W_out, (pad + stride - 1) / stride);
+    int ow_hi = W - K + pad >= 0 ? std::min(W_out, (W - K + pad) / stride + 1) : 0;
+    ow_hi = std::max(ow_hi, ow_lo);
+
+    for (int oh = oh_begin; oh < oh_end; ++oh) {
+        int ih0 = oh * stride - pad;
+        uint8_t* orow = out + static_cast<size_t>(oh) * W_out * B;
+        bool row_interior = ih0 >= 0 && ih0 + K <= H;
+
+        for (int ow = 0; ow < W_out; ++ow) {
+            int iw0 = ow * stride - pad;
+            Acc acc;
+            acc.zero();
+
+            if (row_interior && ow >= ow_lo && ow < ow_hi) {
+                const uint8_t* base = in + (static_cast<size_t>(ih0) * W + iw0) * B;
+                for (int kh = 0; kh < K; ++kh) {
+                    for (int kw = 0; kw < K; ++kw) {
+                        dw_mac(acc, base + (static_cast<size_t>(kh) * W + kw) * B, kv[kh * K + kw]);
+                    }
+                }
+            } else {
+                for (int kh = 0; kh < K; ++kh) {
+                    int ih = ih0 + kh;
+                    if (ih < 0 || ih >= H) continue;
+                    for (int kw = 0; kw < K; ++kw) {
+                        int iw = iw0 + kw;
+                        if (iw < 0 || iw >= W) continue;
+                        dw_mac(acc, in + (static_cast<size_t>(ih) * W + iw) * B, kv[kh * K + kw]);
+                    }
+                }
+            }
+            emit(acc, orow + ow * B);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Pointwise: P pixels x OB output blocks, four input channels per step
+// ---------------------------------------------------------------------------
+
+template <int P, int OB>
+void pw_u8_tile(const uint8_t* in, size_t in_block_stride, int C_in_pad,
+                const int8_t* w, size_t w_block_stride,
+                const float* requant, const float* bias, bool relu6,
+                float* out, size_t out_block_stride) {
+    Acc acc[P][OB];
+    for (int p = 0; p < P; ++p) {
+        for (int o = 0; o < OB; ++o) acc[p][o].zero();
+    }
+
+    for (int ic = 0; ic < C_in_pad; ic += 4) {
+        const uint8_t* x = in + (ic / B) * in_block_stride + ic % B;
+        PwWeight wv[OB];
+        for (int o = 0; o < OB; ++o) {
+            wv[o] = pw_load_weight(w + o * w_block_stride + static_cast<size_t>(ic) * B);
+        }
+        for (int p = 0; p < P; ++p) {
+            for (int o = 0; o < OB; ++o) {
+                pw_dot4(acc[p][o], x + p * B, wv[o]);
+            }
+        }
+    }
+
+    for (int o = 0; o < OB; ++o) {
+        for (int v = 0; v < VB; ++v) {
+            int c = o * B + v * simd::kWidth;
+            simd::vfloat rq = simd::load(requant + c);
+            simd::vfloat b = simd::load(bias + c);
+            for (int p = 0; p < P; ++p) {
+                simd::vfloat r = simd::fmadd(acc[p][o].to_float(v), rq, b);
+                if (relu6) r = simd::min(simd::max(r, simd::zero()), simd::set1(6.0f));
+                simd::store(out + o * out_block_stride + p * B + v * simd::kWidth, r);
+            }
+        }
+    }
+}
+
+// Pixels [p_begin, p_end) of OB output blocks
+template <int OB>
+void pw_u8_blocks(const uint8_t* in, int C_in_pad, int HW, int p_begin, int p_end,
+                  const int8_t* w, const float* requant, const float* bias, bool relu6,
+                  float* out) {
+    size_t plane = static_cast<size_t>(HW) * B;
+    size_t w_block_stride = static_cast<size_t>(C_in_pad) * B;
+
+    int p = p_begin;
+    for (; p + kPointwiseP <= p_end; p += kPointwiseP) {
+        pw_u8_tile<kPointwiseP, OB>(in + p * B, plane, C_in_pad, w, w_block_stride,
+                                    requant, bias, relu6, out + p * B, plane);
+    }
+    for (; p < p_end; ++p) {
+        pw_u8_tile<1, OB>(in + p * B, plane, C_in_pad, w, w_block_stride,
+                          requant, bias, relu6, out + p * B, plane);
+    }
+}
+
+// Rounds one channel block of floats to u8 with the given inverse scale
+inline void quantize_block(const float* x, float inv_scale, uint8_t* dst) {
+    simd::vfloat r[VB];
+    for (int v = 0; v < VB; ++v) {
+        r[v] = simd::mul(simd::load(x + v * simd::kWidth), simd::set1(inv_scale));
+        r[v] = simd::min(simd::max(r[v], simd::zero()), simd::set1(255.0f));
+    }
+    pack_u8(r, dst);
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Quantization helpers and weight packing
+// ---------------------------------------------------------------------------
+
+void quantize_per_channel(const float* weight, int rows, int cols,
+                          std::vector<int8_t>& q, std::vector<float>& scales) {
+    q.resize(static_cast<size_t>(rows) * cols);
+    scales.resize(rows);
+    for (int r = 0; r < rows; ++r) {
+        const float* row = weight + static_cast<size_t>(r) * cols;
+        float max_abs = 0.0f;
+        for (int c = 0; c < cols; ++c) max_abs = std::max(max_abs, std::fabs(row[c]));
+        float scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+        scales[r] = scale;
+        for (int c = 0; c < cols; ++c) {
+            float v = std::nearbyint(row[c] / scale);
+            q[static_cast<size_t>(r) * cols + c] = static_cast<int8_t>(std::min(std::max(v, -127.0f), 127.0f));
+        }
+    }
+}
+
+std::vector<int8_t> pack_pointwise_weight_nchwc_s8(const int8_t* q, int C_out, int C_in,
+                                                   int block) {
+    // [C_out, C_in] -> [C_out / B][C_in_pad / 4][B][4]
+    int C_out_pad = round_up_channels(C_out, block);
+    int C_in_pad = round_up_channels(C_in, block);
+    std::vector<int8_t> packed(static_cast<size_t>(C_out_pad) * C_in_pad, 0);
+    for (int oc = 0; oc < C_out; ++oc) {
+        for (int ic = 0; ic < C_in; ++ic) {
+            size_t idx = ((static_cast<size_t>(oc / block) * (C_in_pad / 4) + ic / 4) * block + oc % block) * 4 + ic % 4;
+            packed[idx] = q[static_cast<size_t>(oc) * C_in + ic];
+        }
+    }
+    return packed;
+}
+
+std::vector<int8_t> pack_depthwise_weight_nchwc_s8(const int8_t* q, int C, int taps,
+                                                   int block) {
+    // [C, taps] -> [C / B][taps][B]
+    int C_pad = round_up_channels(C, block);
+    std::vector<int8_t> packed(static_cast<size_t>(C_pad) * taps, 0);
+    for (int c = 0; c < C; ++c) {
+        for (int t = 0; t < taps; ++t) {
+            packed[(static_cast<size_t>(c / block) * taps + t) * block + c % block] = q[c * taps + t];
+        }
+    }
+    return packed;
+}
+
+void quantize_nchw_to_nchwc_u8(const float* src, int N, int C, int HW,
+                               float inv_scale, uint8_t* dst) {
+    int blocks = round_up_channels(C, B) / B;
+    parallel::parallel_for_tiles(N * blocks, HW, 1, [&](int item, int p_begin, int p_end) {
+        int n = item / blocks;
+        int cb = item % blocks;
+        uint8_t* out = dst + static_cast<size_t>(item) * HW * B;
+        int count = std::min(B, C - cb * B);
+        const float* planes = src + static_cast<size_t>(n * C + cb * B) * HW;
+        alignas(64) float pixel[B] = {};
+        for (int p = p_begin; p < p_end; ++p) {
+            for (int j = 0; j < count; ++j) pixel[j] = planes[static_cast<size_t>(j) * HW + p];
+            quantize_block(pixel, inv_scale, out + p * B);
+        }
+    });
+}
+
+// ---------------------------------------------------------------------------
+// Kernels
+// ---------------------------------------------------------------------------
+
+void depthwise_conv_nchwc_u8_into(const uint8_t* input, int N, int C, int H, int W,
+                                  const int8_t* weight, int kernel, int stride, int padding,
+                                  const float* requant, const float* bias, bool relu6,
+                                  float out_inv_scale, uint8_t* output) {
+    int blocks = round_up_channels(C, B) / B;
+    int H_out = conv_out_size(H, kernel, stride, padding);
+    int W_out = conv_out_size(W, kernel, stride, padding);
+    size_t in_plane = static_cast<size_t>(H) * W * B;
+    size_t out_plane = static_cast<size_t>(H_out) * W_out * B;
+
+    if (kernel != 3) {
+        throw std::runtime_error("INT8 depthwise conv supports 3x3 kernels only");
+    }
+
+    parallel::parallel_for_tiles(N * blocks, H_out, 1, [&](int plane, int oh_begin, int oh_end) {
+        int cb = plane % blocks;
+        dw_u8_plane<3>(input + static_cast<size_t>(plane) * in_plane, H, W,
+                       weight + static_cast<size_t>(cb) * 9 * B, stride, padding,
+                       requant + cb * B, bias + cb * B, relu6, out_inv_scale,
+                       output + static_cast<size_t>(plane) * out_plane,
+                       W_out, oh_begin, oh_end);
+    });
+}
+
+void pointwise_conv_nchwc_u8_into(const uint8_t* input, int N, int C_in, int C_out, int HW,
+                                  const int8_t* weight, const float* requant,
+                                  const float* bias, bool relu6, float* output) {
+    int C_in_pad = round_up_channels(C_in, B);
+    int out_blocks = round_up_channels(C_out, B) / B;
+    size_t plane = static_cast<size_t>(HW) * B;
+    size_t w_block_stride = static_cast<size_t>(C_in_pad) * B;
+
+    int pairs = (out_blocks + 1) / 2;
+    parallel::parallel_for_tiles(N * pairs, HW, kPointwiseP, [&](int item, int p_begin, int p_end) {
+        int n = item / pairs;
+        int ob = item % pairs * 2;
+        const uint8_t* in = input + static_cast<size_t>(n) * C_in_pad * HW;
+        float* out = output + (static_cast<size_t>(n) * out_blocks + ob) * plane;
+        const int8_t* w = weight + ob * w_block_stride;
+
+        if (ob + 2 <= out_blocks) {
+            pw_u8_blocks<2>(in, C_in_pad, HW, p_begin, p_end, w, requant + ob * B,
+                            bias + ob * B, relu6, out);
+        } else {
+            pw_u8_blocks<1>(in, C_in_pad, HW, p_begin, p_end, w, requant + ob * B,
+                            bias + ob * B, relu6, out);
+        }
+    });
+}
+
+void se_block_nchwc_quantize(const float* x, int N, int C, int HW,
+                             const Tensor& fc1_weight, const Tensor& fc2_weight,
+                             float* scratch, float out_inv_scale, uint8_t* output) {
+    int C_pad = round_up_channels(C, B);
+    int blocks = C_pad / B;
+    const float* gates = se_block_nchwc_gates(x, N, C, HW, fc1_weight, fc2_weight, scratch);
+
+    // Gate and output scale fold into one multiplier per channel
+    parallel::parallel_for_tiles(N * blocks, HW, 1, [&](int item, int p_begin, int p_end) {
+        int n = item / blocks;
+        int cb = item % blocks;
+        size_t offset = static_cast<size_t>(item) * HW * B;
+        const float* plane = x + offset;
+        uint8_t* out = output + offset;
+        const float* g = gates + static_cast<size_t>(n) * C_pad + cb * B;
+
+        simd::vfloat gv[VB];
+        for (int v = 0; v < VB; ++v) {
+            gv[v] = simd::mul(simd::load(g + v * simd::kWidth), simd::set1(out_inv_scale));
+        }
+        for (int p = p_begin; p < p_end; ++p) {
+            simd::vfloat r[VB];
+            for (int v = 0; v < VB; ++v) {
+                r[v] = simd::mul(simd::load(plane + p * B + v * simd::kWidth), gv[v]);
+                r[v] = simd::min(simd::max(r[v], simd::zero()), simd::set1(255.0f));
+            }
+            pack_u8(r, out + p * B);
+        }
+    });
+}
+
+size_t linear_u8_scratch_size(int N, int in_features, int out_features) {
+    size_t out_pad = round_up_channels(out_features, B);
+    size_t in_pad = round_up_channels(in_features, B);
+    return (static_cast<size_t>(N) + 1) * out_pad + (static_cast<size_t>(N) * in_pad + 3) / 4;
+}
+
+void linear_u8_into(const float* input, int N, int in_features, const int8_t* weight,
+                    int out_features, float input_scale, const float* requant,
+                    const float* bias, bool relu6, float* output, float* scratch) {
+    // A pointwise conv over one image whose N pixels are the batch rows, so
+    // it runs on the same packed weights and u8 x s8 tiles
+    int out_pad = round_up_channels(out_features, B);
+    int in_pad = round_up_channels(in_features, B);
+    float* blocked = scratch;                                    // [out_pad / B][N][B]
+    float* padded_bias = blocked + static_cast<size_t>(N) * out_pad; // [out_pad]
+    auto* x = reinterpret_cast<uint8_t*>(padded_bias + out_pad);  // [in_pad / B][N][B]
+
+    std::fill(padded_bias, padded_bias + out_pad, 0.0f);
+    if (bias) {
+        std::copy(bias, bias + out_features, padded_bias);
+    }
+    float inv_scale = 1.0f / input_scale;
+    alignas(64) float pixel[B];
+    for (int n = 0; n < N; ++n) {
+        const float* row = input + static_cast<size_t>(n) * in_features;
+        for (int cb = 0; cb < in_pad / B; ++cb) {
+            int count = std::min(B, in_features - cb * B);
+            std::fill(pixel, pixel + B, 0.0f);
+            std::copy(row + cb * B, row + cb * B + count, pixel);
+            quantize_block(pixel, inv_scale, x + (static_cast<size_t>(cb) * N + n) * B);
+        }
+    }
+
+    pointwise_conv_nchwc_u8_into(x, 1, in_features, out_features, N, weight, requant,
+                                 padded_bias, relu6, blocked);
+
+    for (int n = 0; n < N; ++n) {
+        float* out = output + static_cast<size_t>(n) * out_features;
+        for (int o = 0; o < out_features; ++o) {
+            out[o] = blocked[(static_cast<size_t>(o / B) * N + n) * B + o % B];
+        }
+    }
+}
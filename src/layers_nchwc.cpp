@@ -0,0 +1,431 @@
+// Kernels for the blocked NCHWc activation layout.
+// Every inner loop walks a channel block with unit stride, so each
+// pixel is kChannelBlock / simd::kWidth full vector loads.
+// Activations and weights are stored as T (float, simd::fp16 or
+// simd::bf16); arithmetic is always float.
+#include "layers.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+namespace {
+
+constexpr int B = kChannelBlock;
+constexpr int VB = kChannelBlock / simd::kWidth;
+
+inline simd::vfloat clamp6(simd::vfloat v) {
+    return simd::min(simd::max(v, simd::zero()), simd::set1(6.0f));
+}
+
+// ---------------------------------------------------------------------------
+// Depthwise KxK over output rows [oh_begin, oh_end) of one channel block
+// plane [H][W][B]
+// ---------------------------------------------------------------------------
+
+template <int K, class T>
+void dw_nchwc_plane(const T* in, int H, int W, const T* k, const float* bias,
+                    int stride, int pad, bool relu6, T* out, int W_out,
+                    int oh_begin, int oh_end) {
+    simd::vfloat kv[K * K][VB];
+    simd::vfloat bv[VB];
+    for (int v = 0; v < VB; ++v) {
+        for (int t = 0; t < K * K; ++t) kv[t][v] = simd::load(k + t * B + v * simd::kWidth);
+        bv[v] = simd::load(bias + v * simd::kWidth);
+    }
+
+    // Output columns [ow_lo, ow_hi) read no horizontal padding
+    int ow_lo = std::min(W_out, (pad + stride - 1) / stride);
+    int ow_hi = W - K + pad >= 0 ? std::min(W_out, (W - K + pad) / stride + 1) : 0;
+    ow_hi = std::max(ow_hi, ow_lo);
+
+    auto border = [&](const T* rows, int ih0, int iw0, T* o) {
+        for (int v = 0; v < VB; ++v) {
+            simd::vfloat acc = bv[v];
+            for (int kh = 0; kh < K; ++kh) {
+                int ih = ih0 + kh;
+                if (ih < 0 || ih >= H) continue;
+                for (int kw = 0; kw < K; ++kw) {
+                    int iw = iw0 + kw;
+                    if (iw < 0 || iw >= W) continue;
+                    acc = simd::fmadd(simd::load(rows + (static_cast<size_t>(ih) * W + iw) * B + v * simd::kWidth),
+                                      kv[kh * K + kw][v], acc);
+                }
+            }
+            simd::store(o + v * simd::kWidth, relu6 ? clamp6(acc) : acc);
+        }
+    };
+
+    for (int oh = oh_begin; oh < oh_end; ++oh) {
+        int ih0 = oh * stride - pad;
+        T* orow = out + static_cast<size_t>(oh) * W_out * B;
+
+        if (ih0 < 0 || ih0 + K > H) {
+            for (int ow = 0; ow < W_out; ++ow) {
+                border(in, ih0, ow * stride - pad, orow + ow * B);
+            }
+            continue;
+        }
+
+        int ow = 0;
+        for (; ow < ow_lo; ++ow) {
+            border(in, ih0, ow * stride - pad, orow + ow * B);
+        }
+        for (; ow < ow_hi; ++ow) {
+            const T* base = in + (static_cast<size_t>(ih0) * W + ow * stride - pad) * B;
+            for (int v = 0; v < VB; ++v) {
+                simd::vfloat acc = bv[v];
+                for (int kh = 0; kh < K; ++kh) {
+                    const T* row = base + static_cast<size_t>(kh) * W * B + v * simd::kWidth;
+                    for (int kw = 0; kw < K; ++kw) {
+                        acc = simd::fmadd(simd::load(row + kw * B), kv[kh * K + kw][v], acc);
+                    }
+                }
+                simd::store(orow + ow * B + v * simd::kWidth, relu6 ? clamp6(acc) : acc);
+            }
+        }
+        for (; ow < W_out; ++ow) {
+            border(in, ih0, ow * stride - pad, orow + ow * B);
+        }
+    }
+}
+
+// Runtime kernel size: same structure, taps not unrolled
+template <class T>
+void dw_nchwc_plane_generic(const T* in, int H, int W, int K, const T* k,
+                            const float* bias, int stride, int pad, bool relu6,
+                            T* out, int W_out, int oh_begin, int oh_end) {
+    for (int oh = oh_begin; oh < oh_end; ++oh) {
+        for (int ow = 0; ow < W_out; ++ow) {
+            T* o = out + (static_cast<size_t>(oh) * W_out + ow) * B;
+            for (int v = 0; v < VB; ++v) {
+                simd::vfloat acc = simd::load(bias + v * simd::kWidth);
+                for (int kh = 0; kh < K; ++kh) {
+                    int ih = oh * stride - pad + kh;
+                    if (ih < 0 || ih >= H) continue;
+                    for (int kw = 0; kw < K; ++kw) {
+                        int iw = ow * stride - pad + kw;
+                        if (iw < 0 || iw >= W) continue;
+                        acc = simd::fmadd(simd::load(in + (static_cast<size_t>(ih) * W + iw) * B + v * simd::kWidth),
+                                          simd::load(k + (kh * K + kw) * B + v * simd::kWidth), acc);
+                    }
+                }
+                simd::store(o + v * simd::kWidth, relu6 ? clamp6(acc) : acc);
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Pointwise 1x1: P pixels x OB output blocks register tile
+// ---------------------------------------------------------------------------
+
+// Input channels are processed in chunks so the weight slice of a tile
+// (OB blocks x kPointwiseKC channels) stays in L1 across pixel tiles.
+// Partial sums live in the output between chunks, so 16-bit outputs take
+// all input channels in one pass instead (their weights are half the size).
+constexpr int kPointwiseKC = 128;
+constexpr int kPointwiseP = simd::kWidth >= 16 ? 8 : 6;
+
+template <int P, int OB, class T>
+inline void pw_tile(const T* in, size_t in_block_stride, int ic_begin, int ic_end,
+                    const T* w, size_t w_block_stride, const float* bias,
+                    T* out, size_t out_block_stride, bool first, bool last, bool relu6) {
+    simd::vfloat acc[P][OB][VB];
+
+    for (int o = 0; o < OB; ++o) {
+        for (int v = 0; v < VB; ++v) {
+            for (int p = 0; p < P; ++p) {
+                acc[p][o][v] = first ? simd::load(bias + o * B + v * simd::kWidth)
+                                     : simd::load(out + o * out_block_stride + p * B + v * simd::kWidth);
+            }
+        }
+    }
+
+    for (int icb = ic_begin / B; icb * B < ic_end; ++icb) {
+        const float* ib;
+        alignas(64) float widened[P * B];
+        if constexpr (std::is_same_v<T, float>) {
+            ib = in + icb * in_block_stride;
+        } else {
+            // Convert the tile's input block once; the loop below broadcasts from it
+            for (int p = 0; p < P; ++p) {
+                for (int v = 0; v < VB; ++v) {
+                    simd::store(widened + p * B + v * simd::kWidth,
+                                simd::load(in + icb * in_block_stride + p * B + v * simd::kWidth));
+                }
+            }
+            ib = widened;
+        }
+        for (int j = 0; j < B; ++j) {
+            int ic = icb * B + j;
+            simd::vfloat wv[OB][VB];
+            for (int o = 0; o < OB; ++o) {
+                for (int v = 0; v < VB; ++v) {
+                    wv[o][v] = simd::load(w + o * w_block_stride + static_cast<size_t>(ic) * B + v * simd::kWidth);
+                }
+            }
+            for (int p = 0; p < P; ++p) {
+                simd::vfloat a = simd::set1(ib[p * B + j]);
+                for (int o = 0; o < OB; ++o) {
+                    for (int v = 0; v < VB; ++v) {
+                        acc[p][o][v] = simd::fmadd(a, wv[o][v], acc[p][o][v]);
+                    }
+                }
+            }
+        }
+    }
+
+    for (int o = 0; o < OB; ++o) {
+        for (int v = 0; v < VB; ++v) {
+            for (int p = 0; p < P; ++p) {
+                simd::vfloat r = acc[p][o][v];
+                if (last && relu6) r = clamp6(r);
+                simd::store(out + o * out_block_stride + p * B + v * simd::kWidth, r);
+            }
+        }
+    }
+}
+
+// Pixels [p_begin, p_end) of OB output blocks
+template <int OB, class T>
+void pw_blocks(const T* in, int C_in_pad, int HW, int p_begin, int p_end, const T* w,
+               const float* bias, bool relu6, T* out) {
+    size_t plane = static_cast<size_t>(HW) * B;
+    size_t w_block_stride = static_cast<size_t>(C_in_pad) * B;
+    int kc = std::is_same_v<T, float> ? kPointwiseKC : C_in_pad;
+
+    for (int ic0 = 0; ic0 < C_in_pad; ic0 += kc) {
+        int ic1 = std::min(C_in_pad, ic0 + kc);
+        bool first = ic0 == 0;
+        bool last = ic1 == C_in_pad;
+
+        int p = p_begin;
+        for (; p + kPointwiseP <= p_end; p += kPointwiseP) {
+            pw_tile<kPointwiseP, OB, T>(in + p * B, plane, ic0, ic1, w, w_block_stride, bias,
+                                     out + p * B, plane, first, last, relu6);
+        }
+        for (; p < p_end; ++p) {
+            pw_tile<1, OB, T>(in + p * B, plane, ic0, ic1, w, w_block_stride, bias,
+                           out + p * B, plane, first, last, relu6);
+        }
+    }
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Weight packing
+// ---------------------------------------------------------------------------
+
+Tensor pack_pointwise_weight_nchwc(const Tensor& weight, int block) {
+    // [C_out, C_in, 1, 1] -> [C_out / B][C_in_pad][B]
+    int C_out = weight.shape[0];
+    int C_in = weight.shape[1];
+    int C_out_pad = round_up_channels(C_out, block);
+    int C_in_pad = round_up_channels(C_in, block);
+
+    Tensor packed({C_out_pad / block, C_in_pad, block});
+    std::fill(packed.data.begin(), packed.data.end(), 0.0f);
+    for (int oc = 0; oc < C_out; ++oc) {
+        for (int ic = 0; ic < C_in; ++ic) {
+            packed.data[(static_cast<size_t>(oc / block) * C_in_pad + ic) * block + oc % block] =
+                weight.ptr()[static_cast<size_t>(oc) * C_in + ic];
+        }
+    }
+    return packed;
+}
+
+Tensor pack_depthwise_weight_nchwc(const Tensor& weight, int block) {
+    // [C, 1, kH, kW] -> [C / B][kH * kW][B]
+    int C = weight.shape[0];
+    int taps = weight.shape[2] * weight.shape[3];
+    int C_pad = round_up_channels(C, block);
+
+    Tensor packed({C_pad / block, taps, block});
+    std::fill(packed.data.begin(), packed.data.end(), 0.0f);
+    for (int c = 0; c < C; ++c) {
+        for (int t = 0; t < taps; ++t) {
+            packed.data[(static_cast<size_t>(c / block) * taps + t) * block + c % block] = weight.ptr()[c * taps + t];
+        }
+    }
+    return packed;
+}
+
+Tensor pad_channels(const Tensor& vec, int block) {
+    int C = static_cast<int>(vec.size());
+    Tensor padded({round_up_channels(C, block)});
+    std::fill(padded.data.begin(), padded.data.end(), 0.0f);
+    std::copy(vec.ptr(), vec.ptr() + C, padded.data.begin());
+    return padded;
+}
+
+// ---------------------------------------------------------------------------
+// Kernels
+// ---------------------------------------------------------------------------
+
+template <class T>
+void depthwise_conv_nchwc_into(const T* input, int N, int C, int H, int W,
+                               const T* weight, int kernel, int stride, int padding,
+                               const float* bias, bool relu6, T* output) {
+    int blocks = round_up_channels(C, B) / B;
+    int H_out = conv_out_size(H, kernel, stride, padding);
+    int W_out = conv_out_size(W, kernel, stride, padding);
+    size_t in_plane = static_cast<size_t>(H) * W * B;
+    size_t out_plane = static_cast<size_t>(H_out) * W_out * B;
+
+    // Work items: channel block planes, split into row tiles
+    parallel::parallel_for_tiles(N * blocks, H_out, 1, [&](int plane, int oh_begin, int oh_end) {
+        int cb = plane % blocks;
+        const T* in = input + static_cast<size_t>(plane) * in_plane;
+        T* out = output + static_cast<size_t>(plane) * out_plane;
+        const T* k = weight + static_cast<size_t>(cb) * kernel * kernel * B;
+        const float* b = bias + cb * B;
+
+        if (kernel == 3) {
+            dw_nchwc_plane<3>(in, H, W, k, b, stride, padding, relu6, out, W_out,
+                              oh_begin, oh_end);
+        } else {
+            dw_nchwc_plane_generic(in, H, W, kernel, k, b, stride, padding, relu6,
+                                   out, W_out, oh_begin, oh_end);
+        }
+    });
+}
+
+template <class T>
+void pointwise_conv_nchwc_into(const T* input, int N, int C_in, int C_out, int HW,
+                               const T* weight, const float* bias, bool relu6,
+                               T* output) {
+    int C_in_pad = round_up_channels(C_in, B);
+    int out_blocks = round_up_channels(C_out, B) / B;
+    size_t plane = static_cast<size_t>(HW) * B;
+    size_t w_block_stride = static_cast<size_t>(C_in_pad) * B;
+
+    // Work items: pairs of output blocks per image, split into pixel tiles
+    int pairs = (out_blocks + 1) / 2;
+    parallel::parallel_for_tiles(N * pairs, HW, kPointwiseP, [&](int item, int p_begin, int p_end) {
+        int n = item / pairs;
+        int ob = item % pairs * 2;
+        const T* in = input + static_cast<size_t>(n) * C_in_pad * HW;
+        T* out = output + (static_cast<size_t>(n) * out_blocks + ob) * plane;
+        const T* w = weight + ob * w_block_stride;
+
+        if (ob + 2 <= out_blocks) {
+            pw_blocks<2, T>(in, C_in_pad, HW, p_begin, p_end, w, bias + ob * B, relu6, out);
+        } else {
+            pw_blocks<1, T>(in, C_in_pad, HW, p_begin, p_end, w, bias + ob * B, relu6, out);
+        }
+    });
+}
+
+template <class T>
+void global_avg_pool_nchwc_into(const T* input, int N, int C, int HW, float* output) {
+    int C_pad = round_up_channels(C, B);
+    int blocks = C_pad / B;
+    float inv = 1.0f / HW;
+    float pooled[B];
+
+    for (int n = 0; n < N; ++n) {
+        for (int cb = 0; cb < blocks; ++cb) {
+            const T* in = input + static_cast<size_t>(n * blocks + cb) * HW * B;
+            for (int v = 0; v < VB; ++v) {
+                simd::vfloat acc = simd::zero();
+                for (int p = 0; p < HW; ++p) {
+                    acc = simd::add(acc, simd::load(in + p * B + v * simd::kWidth));
+                }
+                simd::store(pooled + v * simd::kWidth, simd::mul(acc, simd::set1(inv)));
+            }
+            int count = std::min(B, C - cb * B);
+            std::copy(pooled, pooled + count, output + static_cast<size_t>(n) * C + cb * B);
+        }
+    }
+}
+
+size_t se_block_nchwc_scratch_size(int N, int C, const Tensor& fc1_weight) {
+    return static_cast<size_t>(N) * (C + fc1_weight.shape[0] + round_up_channels(C, B));
+}
+
+template <class T>
+const float* se_block_nchwc_gates(const T* x, int N, int C, int HW,
+                                  const Tensor& fc1_weight, const Tensor& fc2_weight,
+                                  float* scratch) {
+    int hidden = fc1_weight.shape[0];
+    int C_pad = round_up_channels(C, B);
+    float* squeezed = scratch;
+    float* excited = squeezed + static_cast<size_t>(N) * C;
+    float* scale = excited + static_cast<size_t>(N) * hidden;
+
+    // Squeeze + excitation on the pooled [N, C] vector
+    global_avg_pool_nchwc_into(x, N, C, HW, squeezed);
+    linear_into(squeezed, N, C, fc1_weight, nullptr, true, excited);
+    for (int n = 0; n < N; ++n) {
+        float* s = scale + static_cast<size_t>(n) * C_pad;
+        linear_into(excited + static_cast<size_t>(n) * hidden, 1, hidden, fc2_weight,
+                    nullptr, false, s);
+        for (int c = 0; c < C; ++c) s[c] = 1.0f / (1.0f + std::exp(-s[c]));
+        std::fill(s + C, s + C_pad, 0.0f);
+    }
+    return scale;
+}
+
+template <class T>
+void se_block_nchwc_inplace(T* x, int N, int C, int HW,
+                            const Tensor& fc1_weight, const Tensor& fc2_weight, float* scratch) {
+    int C_pad = round_up_channels(C, B);
+    int blocks = C_pad / B;
+    const float* scale = se_block_nchwc_gates(x, N, C, HW, fc1_weight, fc2_weight, scratch);
+
+    // Channel scaling: one vector multiply per pixel and block
+    parallel::parallel_for_tiles(N * blocks, HW, 1, [&](int item, int p_begin, int p_end) {
+        int n = item / blocks;
+        int cb = item % blocks;
+        T* plane = x + static_cast<size_t>(item) * HW * B;
+        const float* s = scale + static_cast<size_t>(n) * C_pad + cb * B;
+        simd::vfloat sv[VB];
+        for (int v = 0; v < VB; ++v) sv[v] = simd::load(s + v * simd::kWidth);
+        for (int p = p_begin; p < p_end; ++p) {
+            for (int v = 0; v < VB; ++v) {
+                T* ptr = plane + p * B + v * simd::kWidth;
+                simd::store(ptr, simd::mul(simd::load(ptr), sv[v]));
+            }
+        }
+    });
+}
+
+template <class T>
+void nchw_to_nchwc_into(const float* src, int N, int C, int HW, T* dst) {
+    // Gather one pixel of a channel block, then store it as vectors
+    int blocks = round_up_channels(C, B) / B;
+    parallel::parallel_for_tiles(N * blocks, HW, 1, [&](int item, int p_begin, int p_end) {
+        int n = item / blocks;
+        int cb = item % blocks;
+        T* out = dst + static_cast<size_t>(item) * HW * B;
+        int count = std::min(B, C - cb * B);
+        const float* planes = src + static_cast<size_t>(n * C + cb * B) * HW;
+        alignas(64) float pixel[B] = {};
+        for (int p = p_begin; p < p_end; ++p) {
+            for (int j = 0; j < count; ++j) pixel[j] = planes[static_cast<size_t>(j) * HW + p];
+            for (int v = 0; v < VB; ++v) {
+                simd::store(out + p * B + v * simd::kWidth, simd::load(pixel + v * simd::kWidth));
+            }
+        }
+    });
+}
+
+// Storage types used by the compiled plan
+#define INSTANTIATE_NCHWC_KERNELS(T)                                                         \
+    template void depthwise_conv_nchwc_into<T>(const T*, int, int, int, int, const T*, int, \
+                                               int, int, const float*, bool, T*);           \
+    template void pointwise_conv_nchwc_into<T>(const T*, int, int, int, int, const T*,      \
+                                               const float*, bool, T*);                     \
+    template void global_avg_pool_nchwc_into<T>(const T*, int, int, int, float*);           \
+    template const float* se_block_nchwc_gates<T>(const T*, int, int, int, const Tensor&,   \
+                                                  const Tensor&, float*);                   \
+    template void se_block_nchwc_inplace<T>(T*, int, int, int, const Tensor&, const Tensor&, \
+                                            float*);                                        \
+    template void nchw_to_nchwc_into<T>(const float*, int, int, int, T*);
+
+INSTANTIATE_NCHWC_KERNELS(float)
+INSTANTIATE_NCHWC_KERNELS(simd::fp16)
+INSTANTIATE_NCHWC_KERNELS(simd::bf16)
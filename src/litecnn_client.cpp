@@ -0,0 +1,265 @@
+#include "litecnn_client.h"
+#include "shm_protocol.h"
+#include "unix_protocol.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace unix_protocol;
+
+namespace {
+
+std::runtime_error io_error(const char* what) {
+    return std::runtime_error(std::string(what) + ": " +
+                              (errno ? std::strerror(errno) : "connection closed"));
+}
+
+void read_full(int fd, void* data, size_t size) {
+    auto* p = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        errno = 0;
+        ssize_t n = ::read(fd, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw io_error("read");
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+} // namespace
+
+LiteCNNClient::LiteCNNClient(const std::string& socket_path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Unix socket path too long: " + socket_path);
+    }
+    std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        throw io_error("socket");
+    }
+    if (::connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::string error = std::strerror(errno);
+        ::close(fd_);
+        throw std::runtime_error("Cannot connect to " + socket_path + ": " + error);
+    }
+}
+
+LiteCNNClient::~LiteCNNClient() {
+    ::close(fd_);
+}
+
+std::vector<Prediction> LiteCNNClient::classify(const void* image, size_t size, int top_k) {
+    if (size == 0 || size > kMaxImageSize) {
+        throw std::runtime_error("Image size must be in [1, " + std::to_string(kMaxImageSize) + "] bytes");
+    }
+    if (top_k < 1 || top_k > kMaxTopK) {
+        throw std::runtime_error("top_k must be in [1, " + std::to_string(kMaxTopK) + "]");
+    }
+
+    // Header and image in one gather write, without copying the image
+    uint8_t header[kRequestHeaderSize];
+    put_u32(header, static_cast<uint32_t>(size));
+    put_u16(header + 4, static_cast<uint16_t>(top_k));
+    put_u16(header + 6, 0);
+    iovec parts[2] = {{header, sizeof(header)}, {const_cast<void*>(image), size}};
+    size_t remaining = sizeof(header) + size;
+    msghdr msg{};
+    msg.msg_iov = parts;
+    msg.msg_iovlen = 2;
+    while (remaining > 0) {
+        ssize_t n = ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw io_error("write");
+        }
+        remaining -= static_cast<size_t>(n);
+        // Advance past what was sent
+        size_t sent = static_cast<size_t>(n);
+        while (sent > 0 && sent >= msg.msg_iov->iov_len) {
+            sent -= msg.msg_iov->iov_len;
+            ++msg.msg_iov;
+            --msg.msg_iovlen;
+        }
+        if (sent > 0) {
+            msg.msg_iov->iov_base = static_cast<uint8_t*>(msg.msg_iov->iov_base) + sent;
+            msg.msg_iov->iov_len -= sent;
+        }
+    }
+
+    uint8_t reply[kResponseHeaderSize];
+    read_full(fd_, reply, sizeof(reply));
+    uint32_t status = get_u32(reply);
+    uint32_t count = get_u32(reply + 4);
+    if (status != Ok) {
+        std::string message(count, '\0');
+        read_full(fd_, &message[0], count);
+        throw std::runtime_error(message);
+    }
+
+    std::vector<uint8_t> payload(static_cast<size_t>(count) * kPredictionSize);
+    read_full(fd_, payload.data(), payload.size());
+    std::vector<Prediction> predictions(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint8_t* p = payload.data() + i * kPredictionSize;
+        uint32_t bits = get_u32(p + 4);
+        predictions[i].class_id = static_cast<int>(get_u32(p));
+        std::memcpy(&predictions[i].score, &bits, sizeof(float));
+    }
+    return predictions;
+}
+
+#if defined(__linux__)
+
+LiteCNNShmClient::LiteCNNShmClient(const std::string& name) {
+    int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open shared memory " + name + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(shm_protocol::Header)) {
+        ::close(fd);
+        throw std::runtime_error("Shared memory " + name + " is not initialized");
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* region = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (region == MAP_FAILED) {
+        throw io_error("mmap");
+    }
+    header_ = static_cast<shm_protocol::Header*>(region);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header_->magic != shm_protocol::kMagic || header_->version != shm_protocol::kVersion ||
+        header_->slot_count == 0 || (header_->slot_count & (header_->slot_count - 1)) != 0 ||
+        shm_protocol::region_size(header_->slot_count) != size_) {
+        ::munmap(region, size_);
+        throw std::runtime_error("Shared memory " + name + " is not a LiteCNN region (version " +
+                                 std::to_string(shm_protocol::kVersion) + ")");
+    }
+    slot_count_ = header_->slot_count;
+}
+
+LiteCNNShmClient::~LiteCNNShmClient() {
+    ::munmap(header_, size_);
+}
+
+int LiteCNNShmClient::acquire() {
+    shm_protocol::Slot* slots = shm_protocol::slots(header_, slot_count_);
+    uint32_t count = slot_count_;
+    // Start at a per-thread offset so concurrent producers rarely collide
+    thread_local uint32_t next = 0;
+    while (true) {
+        if (header_->closed.load()) {
+            throw std::runtime_error("Server shut down");
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t index = (next + i) & (count - 1);
+            uint32_t expected = shm_protocol::Free;
+            if (slots[index].state.compare_exchange_strong(expected, shm_protocol::Writing)) {
+                next = index + 1;
+                return static_cast<int>(index);
+            }
+        }
+        // Every slot is in flight; one frees up within an inference
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+void* LiteCNNShmClient::input(int slot) {
+    return shm_protocol::slots(header_, slot_count_)[slot].input;
+}
+
+void LiteCNNShmClient::submit(int slot, InputType type, int top_k) {
+    shm_protocol::Slot& s = shm_protocol::slots(header_, slot_count_)[slot];
+    s.dtype = type;
+    s.top_k = static_cast<uint32_t>(top_k);
+    s.submit_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    s.state.store(shm_protocol::Submitted);
+    // Full only while a worker is mid-pop, or for good if a producer died
+    // mid-push (see try_push); back off and notice a shutdown meanwhile
+    while (!shm_protocol::try_push(header_, slot_count_, static_cast<uint32_t>(slot))) {
+        if (header_->closed.load()) {
+            throw std::runtime_error("Server shut down");
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    header_->submitted.fetch_add(1);
+    if (header_->sleepers.load()) {
+        shm_protocol::futex_wake(header_->submitted, 1);
+    }
+}
+
+std::vector<Prediction> LiteCNNShmClient::wait(int slot) {
+    shm_protocol::Slot& s = shm_protocol::slots(header_, slot_count_)[slot];
+    uint32_t state;
+    while ((state = s.state.load()) != shm_protocol::Done) {
+        s.waiting.store(1);
+        if (header_->closed.load()) {
+            throw std::runtime_error("Server shut down");
+        }
+        // Wait on the state just seen (Submitted or Processing); timeout so
+        // that a server shutdown is noticed
+        shm_protocol::futex_wait(s.state, state, 200);
+    }
+    s.waiting.store(0);
+
+    std::vector<Prediction> predictions;
+    uint32_t status = s.status;
+    if (status == shm_protocol::Ok) {
+        for (uint32_t i = 0; i < s.count; ++i) {
+            predictions.push_back({static_cast<int>(s.predictions[i].class_id), s.predictions[i].score});
+        }
+    }
+    std::string error(s.error, status == shm_protocol::Ok ? 0 : s.count);
+    s.state.store(shm_protocol::Free);
+    if (status != shm_protocol::Ok) {
+        throw std::runtime_error(error);
+    }
+    return predictions;
+}
+
+std::vector<Prediction> LiteCNNShmClient::classify(const void* data, InputType type, int top_k) {
+    size_t size = type == RGB8 ? shm_protocol::kInputBytes / sizeof(float) : shm_protocol::kInputBytes;
+    int slot = acquire();
+    std::memcpy(input(slot), data, size);
+    submit(slot, type, top_k);
+    return wait(slot);
+}
+
+#else
+
+LiteCNNShmClient::LiteCNNShmClient(const std::string&) {
+    throw std::runtime_error("The shared-memory interface requires Linux");
+}
+
+LiteCNNShmClient::~LiteCNNShmClient() = default;
+
+int LiteCNNShmClient::acquire() { return -1; }
+
+void* LiteCNNShmClient::input(int) { return nullptr; }
+
+void LiteCNNShmClient::submit(int, InputType, int) {}
+
+std::vector<Prediction> LiteCNNShmClient::wait(int) { return {}; }
+
+std::vector<Prediction> LiteCNNShmClient::classify(const void*, InputType, int) { return {}; }
+
+#endif
@@ -0,0 +1,454 @@
+#include "httplib.h"
+#include "../third_party/json.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// HTTP load generator for /predict. Every connection is a persistent
+// keep-alive client on its own thread. With --rate the arrival schedule is
+// fixed in advance (open loop) and latency is measured from each request's
+// intended send time, so a stalled server is charged for the requests it
+// kept waiting (coordinated omission). Without --rate every connection
+// sends back to back (closed loop).
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    std::string host = "localhost";
+    int port = 8080;
+    std::string path = "/predict";
+    std::vector<std::string> images;
+    double rate = 0.0; // requests/s over all connections, 0 = closed loop
+    int connections = 8;
+    double duration_s = 10.0;
+    double warmup_s = 2.0;
+    int timeout_s = 30;
+    std::string json_path;
+};
+
+// Log-linear histogram in the HdrHistogram layout: values below
+// 2 * kSubBuckets are exact, above that every power of two is split into
+// kSubBuckets linear steps, so any value is stored within 1 / kSubBuckets
+// (~0.1%) of itself. Values are microseconds.
+class LatencyHistogram {
+public:
+    static constexpr int kSubBits = 10;
+    static constexpr uint64_t kSubBuckets = 1ULL << kSubBits;
+    static constexpr uint64_t kMaxValue = 3600ULL * 1000 * 1000; // one hour
+
+    LatencyHistogram() : counts_(index(kMaxValue) + 1, 0) {}
+
+    void record(uint64_t us) {
+        us = std::min(us, kMaxValue);
+        ++counts_[index(us)];
+        ++total_;
+        sum_ += static_cast<double>(us);
+        max_ = std::max(max_, us);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    uint64_t count() const { return total_; }
+    uint64_t max() const { return max_; }
+    double mean() const { return total_ ? sum_ / static_cast<double>(total_) : 0.0; }
+
+    // Smallest recorded value v such that pct % of all values are <= v
+    uint64_t percentile(double pct) const {
+        if (total_ == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(std::ceil(pct / 100.0 * static_cast<double>(total_)));
+        rank = std::clamp<uint64_t>(rank, 1, total_);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                return std::min(highest_equivalent(i), max_);
+            }
+        }
+        return max_;
+    }
+
+private:
+    std::vector<uint64_t> counts_;
+    uint64_t total_ = 0;
+    uint64_t max_ = 0;
+    double sum_ = 0.0;
+
+    static size_t index(uint64_t v) {
+        if (v < 2 * kSubBuckets) {
+            return static_cast<size_t>(v);
+        }
+        // v >> shift lands in [kSubBuckets, 2 * kSubBuckets)
+        int shift = 63 - __builtin_clzll(v) - kSubBits;
+        return static_cast<size_t>(shift) * kSubBuckets + (v >> shift);
+    }
+
+    static uint64_t highest_equivalent(size_t i) {
+        if (i < 2 * kSubBuckets) {
+            return i;
+        }
+        int shift = static_cast<int>(i / kSubBuckets) - 1;
+        uint64_t sub = i % kSubBuckets + kSubBuckets;
+        return ((sub + 1) << shift) - 1;
+    }
+};
+
+struct Image {
+    std::string name;
+    httplib::UploadFormDataItems form;
+};
+
+// Everything one connection saw after warmup
+struct ConnectionStats {
+    LatencyHistogram response; // intended send time -> response received
+    LatencyHistogram service;  // actual send time -> response received
+    uint64_t sent = 0;
+    uint64_t ok = 0;
+    uint64_t cache_hits = 0;
+    uint64_t late = 0; // sent more than 1 ms after their intended time
+    uint64_t abandoned = UINT64_MAX; // ticket claimed but not sent at the deadline
+    std::map<std::string, uint64_t> errors;
+};
+
+std::string content_type_for(const std::string& name) {
+    std::string ext = std::filesystem::path(name).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".png" ? "image/png" : "image/jpeg";
+}
+
+bool is_image(const std::filesystem::path& p) {
+    std::string ext = p.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".jpg" || ext == ".jpeg" || ext == ".png";
+}
+
+// Reads every corpus file up front so the timed loop never touches disk
+std::vector<Image> load_corpus(const std::vector<std::string>& paths) {
+    std::vector<std::filesystem::path> files;
+    for (const std::string& p : paths) {
+        if (std::filesystem::is_directory(p)) {
+            std::vector<std::filesystem::path> found;
+            for (const auto& entry : std::filesystem::directory_iterator(p)) {
+                if (entry.is_regular_file() && is_image(entry.path())) {
+                    found.push_back(entry.path());
+                }
+            }
+            std::sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        } else {
+            files.emplace_back(p);
+        }
+    }
+
+    std::vector<Image> corpus;
+    for (const auto& file : files) {
+        std::ifstream f(file, std::ios::binary);
+        if (!f.is_open()) {
+            throw std::runtime_error("Failed to open image: " + file.string());
+        }
+        std::stringstream ss;
+        ss << f.rdbuf();
+        std::string name = file.filename().string();
+        corpus.push_back(Image{name, {{"image", ss.str(), name, content_type_for(name)}}});
+    }
+    return corpus;
+}
+
+// Intended send time of the ticket-th request in open loop
+Clock::time_point slot_time(Clock::time_point start, double rate, uint64_t ticket) {
+    return start + std::chrono::duration_cast<Clock::duration>(
+                       std::chrono::duration<double>(static_cast<double>(ticket) / rate));
+}
+
+void run_connection(const Options& options, const std::vector<Image>& corpus,
+                    std::atomic<uint64_t>& next_ticket, Clock::time_point start,
+                    Clock::time_point measure_from, Clock::time_point end, ConnectionStats& stats) {
+    httplib::Client client(options.host, options.port);
+    client.set_keep_alive(true);
+    client.set_connection_timeout(options.timeout_s);
+    client.set_read_timeout(options.timeout_s);
+    client.set_write_timeout(options.timeout_s);
+
+    const bool open_loop = options.rate > 0.0;
+    while (true) {
+        uint64_t ticket = next_ticket.fetch_add(1, std::memory_order_relaxed);
+        Clock::time_point intended;
+        if (open_loop) {
+            intended = slot_time(start, options.rate, ticket);
+            if (intended >= end) {
+                break;
+            }
+            // Past the deadline the backlog of an overloaded server is
+            // abandoned (reported as unsent) instead of draining for minutes
+            if (Clock::now() >= end) {
+                stats.abandoned = ticket;
+                break;
+            }
+            std::this_thread::sleep_until(intended);
+        } else {
+            intended = Clock::now();
+            if (intended >= end) {
+                break;
+            }
+        }
+
+        const Image& image = corpus[ticket % corpus.size()];
+        Clock::time_point sent = Clock::now();
+        httplib::Result res = client.Post(options.path, image.form);
+        Clock::time_point done = Clock::now();
+
+        if (intended < measure_from) {
+            continue;
+        }
+        ++stats.sent;
+        if (sent - intended > std::chrono::milliseconds(1)) {
+            ++stats.late;
+        }
+        if (!res) {
+            ++stats.errors[httplib::to_string(res.error())];
+            continue;
+        }
+        if (res->status != 200) {
+            ++stats.errors["HTTP " + std::to_string(res->status)];
+            continue;
+        }
+        auto us = [](Clock::duration d) {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+        };
+        stats.response.record(us(done - intended));
+        stats.service.record(us(done - sent));
+        ++stats.ok;
+        if (res->get_header_value("X-Cache") == "hit") {
+            ++stats.cache_hits;
+        }
+    }
+}
+
+const std::vector<std::pair<std::string, double>> kPercentiles = {
+    {"p50", 50.0}, {"p90", 90.0}, {"p99", 99.0}, {"p99.9", 99.9}, {"p99.99", 99.99},
+};
+
+json histogram_json(const LatencyHistogram& h) {
+    json out = {{"mean_ms", h.mean() * 1e-3}, {"max_ms", h.max() * 1e-3}};
+    for (const auto& [label, pct] : kPercentiles) {
+        out[label + "_ms"] = h.percentile(pct) * 1e-3;
+    }
+    return out;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--host" && i + 1 < argc) {
+            options.host = argv[++i];
+        } else if (arg == "--port" && i + 1 < argc) {
+            options.port = std::atoi(argv[++i]);
+        } else if (arg == "--path" && i + 1 < argc) {
+            options.path = argv[++i];
+        } else if (arg == "--images" && i + 1 < argc) {
+            options.images.push_back(argv[++i]);
+        } else if (arg == "--rate" && i + 1 < argc) {
+            options.rate = std::max(std::atof(argv[++i]), 0.0);
+        } else if ((arg == "--connections" || arg == "--concurrency") && i + 1 < argc) {
+            options.connections = std::max(std::atoi(argv[++i]), 1);
+        } else if (arg == "--duration" && i + 1 < argc) {
+            options.duration_s = std::max(std::atof(argv[++i]), 0.1);
+        } else if (arg == "--warmup" && i + 1 < argc) {
+            options.warmup_s = std::max(std::atof(argv[++i]), 0.0);
+        } else if (arg == "--timeout" && i + 1 < argc) {
+            options.timeout_s = std::max(std::atoi(argv[++i]), 1);
+        } else if (arg == "--json" && i + 1 < argc) {
+            options.json_path = argv[++i];
+        } else if (arg == "--help") {
+            std::cout << "Usage: " << argv[0] << " --images DIR|FILE [options]\n"
+                      << "Options:\n"
+                      << "  --host HOST        Server host (default: localhost)\n"
+                      << "  --port PORT        Server port (default: 8080)\n"
+                      << "  --path PATH        Endpoint (default: /predict)\n"
+                      << "  --images DIR|FILE  Image corpus, sent round robin (repeatable)\n"
+                      << "  --rate R           Open loop: R requests/s on a fixed schedule\n"
+                      << "                     (default: closed loop, back to back)\n"
+                      << "  --connections N    Persistent connections (default: 8)\n"
+                      << "  --concurrency N    Same as --connections\n"
+                      << "  --duration S       Measured seconds (default: 10)\n"
+                      << "  --warmup S         Unmeasured seconds before that (default: 2)\n"
+                      << "  --timeout S        Connect / read / write timeout (default: 30)\n"
+                      << "  --json PATH        Write the summary as JSON\n"
+                      << "  --help             Show this help\n";
+            return 0;
+        }
+    }
+
+    try {
+        if (options.images.empty()) {
+            std::cerr << "--images is required (see --help)" << std::endl;
+            return 1;
+        }
+        std::vector<Image> corpus = load_corpus(options.images);
+        if (corpus.empty()) {
+            std::cerr << "No .jpg / .jpeg / .png files found" << std::endl;
+            return 1;
+        }
+
+        const bool open_loop = options.rate > 0.0;
+        std::cout << options.host << ":" << options.port << options.path << ", " << corpus.size()
+                  << " images, " << options.connections << " connections, ";
+        if (open_loop) {
+            std::cout << "open loop at " << options.rate << " req/s";
+        } else {
+            std::cout << "closed loop";
+        }
+        std::cout << ", " << options.warmup_s << " s warmup + " << options.duration_s << " s"
+                  << std::endl;
+
+        // Connections start with a little slack so the first slots are not late
+        auto seconds = [](double s) {
+            return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(s));
+        };
+        Clock::time_point start = Clock::now() + std::chrono::milliseconds(50);
+        Clock::time_point measure_from = start + seconds(options.warmup_s);
+        Clock::time_point end = measure_from + seconds(options.duration_s);
+
+        std::atomic<uint64_t> next_ticket{0};
+        std::vector<ConnectionStats> stats(options.connections);
+        std::vector<std::thread> threads;
+        for (int c = 0; c < options.connections; ++c) {
+            threads.emplace_back(run_connection, std::cref(options), std::cref(corpus),
+                                 std::ref(next_ticket), start, measure_from, end, std::ref(stats[c]));
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        // Requests still in flight at `end` finish after it; count them anyway
+        double elapsed_s = std::chrono::duration<double>(Clock::now() - measure_from).count();
+
+        ConnectionStats total;
+        for (const ConnectionStats& s : stats) {
+            total.response.merge(s.response);
+            total.service.merge(s.service);
+            total.sent += s.sent;
+            total.ok += s.ok;
+            total.cache_hits += s.cache_hits;
+            total.late += s.late;
+            for (const auto& [error, count] : s.errors) {
+                total.errors[error] += count;
+            }
+        }
+        // Slots inside the measured window that never got a connection had
+        // already waited (end - intended) when the run stopped; record that
+        // lower bound rather than dropping them from the distribution
+        uint64_t unsent = 0;
+        if (open_loop) {
+            auto record_unsent = [&](uint64_t ticket) {
+                Clock::time_point intended = slot_time(start, options.rate, ticket);
+                if (intended >= measure_from && intended < end) {
+                    total.response.record(static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::microseconds>(end - intended).count()));
+                    ++unsent;
+                }
+            };
+            for (const ConnectionStats& s : stats) {
+                if (s.abandoned != UINT64_MAX) {
+                    record_unsent(s.abandoned);
+                }
+            }
+            for (uint64_t t = next_ticket.load(); slot_time(start, options.rate, t) < end; ++t) {
+                record_unsent(t);
+            }
+        }
+        uint64_t error_count = 0;
+        for (const auto& [error, count] : total.errors) {
+            error_count += count;
+        }
+
+        double throughput = total.ok / elapsed_s;
+        std::printf("\n%llu sent, %llu ok, %llu errors, %llu cache hits, %.1f req/s",
+                    static_cast<unsigned long long>(total.sent),
+                    static_cast<unsigned long long>(total.ok),
+                    static_cast<unsigned long long>(error_count),
+                    static_cast<unsigned long long>(total.cache_hits), throughput);
+        if (open_loop) {
+            std::printf(" (target %.1f)", options.rate);
+        }
+        std::printf("\n");
+        if (unsent > 0) {
+            std::printf("  %-24s %llu (response counts their wait until the deadline)\n",
+                        "unsent", static_cast<unsigned long long>(unsent));
+        }
+        for (const auto& [error, count] : total.errors) {
+            std::printf("  %-24s %llu\n", error.c_str(), static_cast<unsigned long long>(count));
+        }
+
+        // Closed loop has no schedule to fall behind, so both columns agree there
+        std::printf("\n%-8s %12s %12s\n", "ms", "response", "service");
+        for (const auto& [label, pct] : kPercentiles) {
+            std::printf("%-8s %12.3f %12.3f\n", label.c_str(), total.response.percentile(pct) * 1e-3,
+                        total.service.percentile(pct) * 1e-3);
+        }
+        std::printf("%-8s %12.3f %12.3f\n", "max", total.response.max() * 1e-3,
+                    total.service.max() * 1e-3);
+        std::printf("%-8s %12.3f %12.3f\n", "mean", total.response.mean() * 1e-3,
+                    total.service.mean() * 1e-3);
+        if (open_loop && total.late > 0) {
+            std::printf("\n%llu requests were sent >1 ms after their slot: all connections were busy "
+                        "(their wait is included in response)\n",
+                        static_cast<unsigned long long>(total.late));
+        }
+
+        if (!options.json_path.empty()) {
+            json out;
+            out["config"] = {
+                {"url", options.host + ":" + std::to_string(options.port) + options.path},
+                {"mode", open_loop ? "open" : "closed"},
+                {"rate", options.rate},
+                {"connections", options.connections},
+                {"duration_s", options.duration_s},
+                {"warmup_s", options.warmup_s},
+                {"images", corpus.size()},
+            };
+            out["sent"] = total.sent;
+            out["ok"] = total.ok;
+            out["errors"] = total.errors;
+            out["cache_hits"] = total.cache_hits;
+            out["late"] = total.late;
+            out["unsent"] = unsent;
+            out["throughput_rps"] = throughput;
+            out["response"] = histogram_json(total.response);
+            out["service"] = histogram_json(total.service);
+            std::ofstream f(options.json_path);
+            if (!f.is_open()) {
+                std::cerr << "Failed to write " << options.json_path << std::endl;
+                return 1;
+            }
+            f << out.dump(2) << "\n";
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -1,10 +1,98 @@
 #include "server.h"
+#include "bulk_classifier.h"
+#include "preprocess.h"
+#include "thread_pool.h"
 #include <iostream>
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <csignal>
+#include <pthread.h>
+#include <thread>
+
+// Reloads the server's model on every SIGHUP, which must be blocked in all
+// threads, until destroyed. Declare it after the server so that it stops
+// before the server goes away
+class HangupReloader {
+public:
+    HangupReloader(InferenceServer& server, const sigset_t& hup)
+        : thread_([this, &server, hup] {
+              int signal;
+              while (sigwait(&hup, &signal) == 0 && !stopping_.load()) {
+                  try {
+                      server.reload_model();
+                  } catch (const std::exception&) {
+                      // Logged by reload_model; the current model keeps serving
+                  }
+              }
+          }) {}
+
+    ~HangupReloader() {
+        stopping_.store(true);
+        // sigwait() only returns for SIGHUP: send one to this thread
+        pthread_kill(thread_.native_handle(), SIGHUP);
+        thread_.join();
+    }
+
+    HangupReloader(const HangupReloader&) = delete;
+    HangupReloader& operator=(const HangupReloader&) = delete;
+
+private:
+    std::atomic<bool> stopping_{false};
+    std::thread thread_;
+};
+
+// Runs every image in `dir` through the FP32 model and writes the weights
+// with calibrated INT8 activation scales to `out_path`
+static int run_calibration(const std::string& weights_path, const std::string& dir,
+                           const std::string& out_path) {
+    LiteCNNPro model;
+    if (!model.load_weights(weights_path)) {
+        return 1;
+    }
+
+    int count = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+        std::ifstream f(entry.path(), std::ios::binary);
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+        try {
+            model.calibrate(preprocess_image(bytes.data(), bytes.size()));
+            ++count;
+        } catch (const std::exception& e) {
+            std::cerr << "Skipping " << entry.path().string() << ": " << e.what() << std::endl;
+        }
+    }
+
+    if (count == 0) {
+        std::cerr << "No decodable images in " << dir << std::endl;
+        return 1;
+    }
+    std::cout << "Calibrated on " << count << " images" << std::endl;
+    return model.save_calibrated_weights(out_path) ? 0 : 1;
+}
 
 int main(int argc, char* argv[]) {
     std::string weights_path = "weights/model_weights.bin";
     std::string breeds_path = "breed_classes.json";
+    std::string calibrate_dir;
+    std::string out_path;
+    Precision precision = Precision::FP32;
+    BatchOptions batching;
+    WeightLoadOptions loading;
+    CacheOptions caching;
+    TraceOptions tracing;
+    BulkOptions bulk;
+    EpollOptions epoll;
+    bool use_epoll = false;
+    std::string unix_socket;
+    ShmOptions shm;
+    int threads = 1;
     int port = 8080;
     
     // Parse arguments
@@ -16,20 +104,172 @@ int main(int argc, char* argv[]) {
             breeds_path = argv[++i];
         } else if (arg == "--port" && i + 1 < argc) {
             port = std::atoi(argv[++i]);
+        } else if (arg == "--frontend" && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (value != "httplib" && value != "epoll") {
+                std::cerr << "Unknown front-end: " << value << std::endl;
+                return 1;
+            }
+            use_epoll = value == "epoll";
+        } else if (arg == "--io-threads" && i + 1 < argc) {
+            epoll.io_threads = std::atoi(argv[++i]);
+        } else if (arg == "--http-workers" && i + 1 < argc) {
+            epoll.workers = std::atoi(argv[++i]);
+        } else if (arg == "--unix-socket" && i + 1 < argc) {
+            unix_socket = argv[++i];
+        } else if (arg == "--shm" && i + 1 < argc) {
+            shm.name = argv[++i];
+        } else if (arg == "--shm-slots" && i + 1 < argc) {
+            shm.slots = std::atoi(argv[++i]);
+        } else if (arg == "--shm-workers" && i + 1 < argc) {
+            shm.workers = std::atoi(argv[++i]);
+        } else if (arg == "--precision" && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (value == "fp32") {
+                precision = Precision::FP32;
+            } else if (value == "fp16") {
+                precision = Precision::FP16;
+            } else if (value == "bf16") {
+                precision = Precision::BF16;
+            } else if (value == "int8") {
+                precision = Precision::INT8;
+            } else {
+                std::cerr << "Unknown precision: " << value << std::endl;
+                return 1;
+            }
+        } else if (arg == "--mmap-populate") {
+            loading.populate = true;
+        } else if (arg == "--huge-pages") {
+            loading.huge_pages = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (arg == "--max-batch" && i + 1 < argc) {
+            batching.max_batch = std::atoi(argv[++i]);
+        } else if (arg == "--batch-wait-us" && i + 1 < argc) {
+            batching.max_wait_us = std::atoi(argv[++i]);
+        } else if (arg == "--batch-workers" && i + 1 < argc) {
+            batching.workers = std::atoi(argv[++i]);
+        } else if (arg == "--cache-mb" && i + 1 < argc) {
+            caching.max_bytes = static_cast<size_t>(std::max(std::atoi(argv[++i]), 0)) << 20;
+        } else if (arg == "--cache-ttl" && i + 1 < argc) {
+            caching.ttl_s = std::atoi(argv[++i]);
+        } else if (arg == "--trace-sample" && i + 1 < argc) {
+            tracing.sample_every = std::atoi(argv[++i]);
+        } else if (arg == "--trace-dir" && i + 1 < argc) {
+            tracing.dir = argv[++i];
+        } else if (arg == "--calibrate" && i + 1 < argc) {
+            calibrate_dir = argv[++i];
+        } else if (arg == "--classify-dir" && i + 1 < argc) {
+            bulk.dir = argv[++i];
+        } else if (arg == "--top-k" && i + 1 < argc) {
+            bulk.top_k = std::max(std::atoi(argv[++i]), 1);
+        } else if (arg == "--read-threads" && i + 1 < argc) {
+            bulk.read_threads = std::atoi(argv[++i]);
+        } else if (arg == "--decode-threads" && i + 1 < argc) {
+            bulk.decode_threads = std::atoi(argv[++i]);
+        } else if (arg == "--forward-threads" && i + 1 < argc) {
+            bulk.forward_threads = std::atoi(argv[++i]);
+        } else if (arg == "--out" && i + 1 < argc) {
+            out_path = argv[++i];
         } else if (arg == "--help") {
             std::cout << "Usage: " << argv[0] << " [options]\n"
                       << "Options:\n"
-                      << "  --weights PATH   Path to weights file (default: weights/model_weights.bin)\n"
-                      << "  --breeds PATH    Path to breed classes JSON (default: breed_classes.json)\n"
-                      << "  --port PORT      Server port (default: 8080)\n"
-                      << "  --help           Show this help\n";
+                      << "  --weights PATH     Path to weights file (default: weights/model_weights.bin)\n"
+                      << "  --breeds PATH      Path to breed classes JSON (default: breed_classes.json)\n"
+                      << "  --port PORT        Server port (default: 8080)\n"
+                      << "  --frontend NAME    httplib (thread per connection) or epoll (default: httplib)\n"
+                      << "  --io-threads N     epoll event loops (default: 2)\n"
+                      << "  --http-workers N   epoll threads running requests (default: httplib's pool size)\n"
+                      << "  --unix-socket PATH Also serve the binary protocol on this Unix socket\n"
+                      << "  --shm NAME         Also take submissions through POSIX shared memory NAME\n"
+                      << "  --shm-slots N      Input slots in the shared-memory ring (default: 32)\n"
+                      << "  --shm-workers N    Threads serving shared-memory slots (default: 8)\n"
+                      << "  --precision MODE   fp32, fp16, bf16 or int8 (default: fp32)\n"
+                      << "  --mmap-populate    Fault LCNN v2 weights in at startup (MAP_POPULATE)\n"
+                      << "  --huge-pages       Request transparent huge pages for LCNN v2 weights\n"
+                      << "  --threads N        Threads per inference (intra-op parallelism, default: 1)\n"
+                      << "  --max-batch N      Largest micro-batch of concurrent requests, 1 disables (default: 8)\n"
+                      << "  --batch-wait-us US Max time a request waits for a batch to fill (default: 2000)\n"
+                      << "  --batch-workers N  Threads running batches (default: 1)\n"
+                      << "  --cache-mb N       Memory for cached predictions of identical uploads, 0 disables (default: 64)\n"
+                      << "  --cache-ttl S      Seconds a cached prediction stays valid, 0 never expires (default: 3600)\n"
+                      << "  --trace-sample N   Write a per-layer trace of every Nth request (default: off)\n"
+                      << "  --trace-dir DIR    Directory for sampled traces (default: traces)\n"
+                      << "  --calibrate DIR    Calibrate INT8 activation scales on the images in DIR,\n"
+                      << "                     write the weights to --out and exit\n"
+                      << "  --classify-dir DIR Classify every file under DIR into --out (JSON lines)\n"
+                      << "                     and exit; rerunning skips files already in --out\n"
+                      << "  --top-k K          Predictions per file for --classify-dir (default: 5)\n"
+                      << "  --read-threads N   --classify-dir file readers (default: 2)\n"
+                      << "  --decode-threads N --classify-dir decode + resize threads (default: all cores)\n"
+                      << "  --forward-threads N --classify-dir batched forward() threads (default: cores / 2),\n"
+                      << "                     each running batches of up to --max-batch images\n"
+                      << "  --out PATH         Output file for --calibrate / --classify-dir\n"
+                      << "  --help             Show this help\n";
             return 0;
         }
     }
+
+    // Serving: SIGHUP reloads the model (see below). Blocked before any
+    // thread exists so that every thread inherits the mask and only the
+    // sigwait() thread receives it
+    bool serving = calibrate_dir.empty() && bulk.dir.empty();
+    sigset_t hup;
+    sigemptyset(&hup);
+    sigaddset(&hup, SIGHUP);
+    if (serving) {
+        pthread_sigmask(SIG_BLOCK, &hup, nullptr);
+    }
+    
+    parallel::set_num_threads(threads);
+
+    if (!calibrate_dir.empty()) {
+        if (out_path.empty()) {
+            std::cerr << "--calibrate requires --out PATH" << std::endl;
+            return 1;
+        }
+        try {
+            return run_calibration(weights_path, calibrate_dir, out_path);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    
+    if (!bulk.dir.empty()) {
+        if (out_path.empty()) {
+            std::cerr << "--classify-dir requires --out PATH" << std::endl;
+            return 1;
+        }
+        try {
+            LiteCNNPro model;
+            model.set_precision(precision);
+            if (!model.load_weights(weights_path, loading)) {
+                return 1;
+            }
+            bulk.out_path = out_path;
+            bulk.max_batch = batching.max_batch;
+            return classify_directory(model, load_breed_classes(breeds_path), bulk);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
     
     try {
-        InferenceServer server(port, weights_path, breeds_path);
-        server.run();
+        InferenceServer server(port, weights_path, breeds_path, precision, batching, loading, caching, tracing);
+        if (!unix_socket.empty()) {
+            server.listen_unix(unix_socket);
+        }
+        if (!shm.name.empty()) {
+            server.listen_shm(shm);
+        }
+        HangupReloader reloader(server, hup);
+        if (use_epoll) {
+            server.run_epoll(epoll);
+        } else {
+            server.run();
+        }
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
@@ -0,0 +1,68 @@
+#include "memory_planner.h"
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+
+static size_t align_up(size_t x, size_t a) {
+    return (x + a - 1) / a * a;
+}
+
+int MemoryPlanner::add(size_t size, int first_use, int last_use) {
+    buffers_.push_back({align_up(size, kAlignment), first_use, last_use, 0});
+    return static_cast<int>(buffers_.size()) - 1;
+}
+
+size_t MemoryPlanner::plan() {
+    // Place the largest buffers first; each buffer takes the lowest offset
+    // that does not collide with an already placed, lifetime-overlapping one.
+    std::vector<int> order(buffers_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+        return buffers_[a].size > buffers_[b].size;
+    });
+
+    std::vector<int> placed;
+    arena_size_ = 0;
+
+    for (int id : order) {
+        Buffer& buf = buffers_[id];
+
+        // Live neighbours sorted by offset
+        std::vector<int> live;
+        for (int other : placed) {
+            const Buffer& o = buffers_[other];
+            if (o.first_use <= buf.last_use && buf.first_use <= o.last_use) {
+                live.push_back(other);
+            }
+        }
+        std::sort(live.begin(), live.end(), [this](int a, int b) {
+            return buffers_[a].offset < buffers_[b].offset;
+        });
+
+        size_t candidate = 0;
+        for (int other : live) {
+            const Buffer& o = buffers_[other];
+            if (candidate + buf.size <= o.offset) break;
+            candidate = std::max(candidate, o.offset + o.size);
+        }
+
+        buf.offset = candidate;
+        arena_size_ = std::max(arena_size_, candidate + buf.size);
+        placed.push_back(id);
+    }
+
+    return arena_size_;
+}
+
+void Arena::reserve(size_t floats) {
+    if (floats <= capacity_) {
+        return;
+    }
+
+    storage_.assign(floats + MemoryPlanner::kAlignment, 0.0f);
+    auto addr = reinterpret_cast<std::uintptr_t>(storage_.data());
+    size_t align_bytes = MemoryPlanner::kAlignment * sizeof(float);
+    size_t skip = (align_bytes - addr % align_bytes) % align_bytes / sizeof(float);
+    base_ = storage_.data() + skip;
+    capacity_ = floats;
+}
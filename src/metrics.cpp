@@ -0,0 +1,136 @@
+#include "metrics.h"
+#include <cstdio>
+#include <fstream>
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace metrics {
+
+namespace {
+
+std::atomic<size_t> next_histogram_id{0};
+
+// Per-thread shard of every histogram this thread has recorded into,
+// indexed by histogram id
+thread_local std::vector<void*> local_shards;
+
+void write_header(std::string& out, const std::string& name, const std::string& help,
+                  const char* type) {
+    out += "# HELP " + name + " " + help + "\n";
+    out += "# TYPE " + name + " " + type + "\n";
+}
+
+std::string format(double value) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.9g", value);
+    return buf;
+}
+
+} // namespace
+
+Histogram::Histogram() : id_(next_histogram_id.fetch_add(1, std::memory_order_relaxed)) {}
+
+Histogram::Shard& Histogram::local() {
+    if (local_shards.size() <= id_) {
+        local_shards.resize(id_ + 1, nullptr);
+    }
+    void*& slot = local_shards[id_];
+    if (!slot) {
+        // First observation from this thread
+        std::lock_guard<std::mutex> lock(mutex_);
+        shards_.push_back(std::make_unique<Shard>());
+        slot = shards_.back().get();
+    }
+    return *static_cast<Shard*>(slot);
+}
+
+void Histogram::observe(std::chrono::nanoseconds duration) {
+    uint64_t ns = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+    // Smallest i with ns <= 1000 * 2^i
+    uint64_t us = (ns + 999) / 1000;
+    int bucket = us <= 1 ? 0 : 64 - __builtin_clzll(us - 1);
+    if (bucket > kBuckets) {
+        bucket = kBuckets;
+    }
+
+    // Only this thread writes the shard, so load + store needs no RMW
+    Shard& shard = local();
+    auto bump = [](std::atomic<uint64_t>& v, uint64_t by) {
+        v.store(v.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    };
+    bump(shard.buckets[bucket], 1);
+    bump(shard.sum_ns, ns);
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot s;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& shard : shards_) {
+        for (int i = 0; i <= kBuckets; ++i) {
+            s.buckets[i] += shard->buckets[i].load(std::memory_order_relaxed);
+        }
+        s.sum_ns += shard->sum_ns.load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+double Histogram::bound(int i) {
+    return 1e-6 * static_cast<double>(1ULL << i);
+}
+
+void write_counter(std::string& out, const std::string& name, const std::string& help, double value) {
+    write_header(out, name, help, "counter");
+    out += name + " " + format(value) + "\n";
+}
+
+void write_gauge(std::string& out, const std::string& name, const std::string& help, double value) {
+    write_header(out, name, help, "gauge");
+    out += name + " " + format(value) + "\n";
+}
+
+void write_histograms(std::string& out, const std::string& name, const std::string& help,
+                      const std::string& label,
+                      const std::vector<std::pair<std::string, const Histogram*>>& series) {
+    write_header(out, name, help, "histogram");
+    for (const auto& [value, histogram] : series) {
+        Histogram::Snapshot s = histogram->snapshot();
+        std::string labels = label + "=\"" + value + "\"";
+        // _count is the bucket total, so it always equals the +Inf bucket
+        uint64_t cumulative = 0;
+        for (int i = 0; i < Histogram::kBuckets; ++i) {
+            cumulative += s.buckets[i];
+            out += name + "_bucket{" + labels + ",le=\"" + format(Histogram::bound(i)) + "\"} " +
+                   std::to_string(cumulative) + "\n";
+        }
+        cumulative += s.buckets[Histogram::kBuckets];
+        out += name + "_bucket{" + labels + ",le=\"+Inf\"} " + std::to_string(cumulative) + "\n";
+        out += name + "_sum{" + labels + "} " + format(s.sum_ns * 1e-9) + "\n";
+        out += name + "_count{" + labels + "} " + std::to_string(cumulative) + "\n";
+    }
+}
+
+size_t resident_memory_bytes() {
+#if defined(__APPLE__)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                  reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.resident_size;
+#else
+    // statm: size resident shared ... in pages
+    std::ifstream f("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (!(f >> pages >> resident)) {
+        return 0;
+    }
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+} // namespace metrics
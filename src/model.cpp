@@ -1,12 +1,57 @@
 #include "model.h"
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <type_traits>
+
+ContextPool::ContextPool(size_t capacity)
+    : capacity_(capacity), slots_(new std::atomic<ExecutionContext*>[capacity]) {
+    for (size_t i = 0; i < capacity_; ++i) {
+        slots_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+ContextPool::~ContextPool() {
+    for (size_t i = 0; i < capacity_; ++i) {
+        delete slots_[i].load(std::memory_order_acquire);
+    }
+}
+
+ContextPool::Lease ContextPool::acquire() {
+    for (size_t i = 0; i < capacity_; ++i) {
+        if (slots_[i].load(std::memory_order_relaxed)) {
+            ExecutionContext* context = slots_[i].exchange(nullptr, std::memory_order_acquire);
+            if (context) {
+                return Lease(this, context);
+            }
+        }
+    }
+    return Lease(this, new ExecutionContext());
+}
+
+void ContextPool::release(ExecutionContext* context) {
+    for (size_t i = 0; i < capacity_; ++i) {
+        ExecutionContext* expected = nullptr;
+        if (slots_[i].compare_exchange_strong(expected, context, std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+            return;
+        }
+    }
+    delete context;
+}
 
 LiteCNNPro::LiteCNNPro() {}
 
-bool LiteCNNPro::load_weights(const std::string& weights_path) {
+bool LiteCNNPro::load_weights(const std::string& weights_path, const WeightLoadOptions& options) {
+    char magic[4] = {};
+    std::ifstream(weights_path, std::ios::binary).read(magic, 4);
+    if (std::strncmp(magic, "LCNP", 4) == 0) {
+        return load_plan(weights_path, options);
+    }
+
     std::vector<std::pair<std::string, Tensor>> weight_list;
     
-    if (!WeightLoader::load(weights_path, weight_list)) {
+    if (!WeightLoader::load(weights_path, weight_list, options)) {
         return false;
     }
     
@@ -21,10 +66,19 @@ bool LiteCNNPro::load_weights(const std::string& weights_path) {
     }
     
     std::cout << "Loaded " << weights_.size() << " weight tensors" << std::endl;
+
+    try {
+        compile();
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to compile model: " << e.what() << std::endl;
+        return false;
+    }
+
+    std::cout << "Compiled execution plan with " << plan_.size() << " steps" << std::endl;
     return true;
 }
 
-Tensor LiteCNNPro::get_weight(const std::string& name) const {
+const Tensor& LiteCNNPro::get_weight(const std::string& name) const {
     auto it = weights_.find(name);
     if (it == weights_.end()) {
         throw std::runtime_error("Weight not found: " + name);
@@ -36,113 +90,615 @@ bool LiteCNNPro::has_weight(const std::string& name) const {
     return weights_.find(name) != weights_.end();
 }
 
-Tensor LiteCNNPro::se_block(const Tensor& x, const std::string& prefix) {
-    int N = x.shape[0];
-    int C = x.shape[1];
-    
-    // Squeeze: AdaptiveAvgPool2d(1, 1)
-    Tensor squeezed = adaptive_avg_pool2d(x, 1, 1);
-    
-    // Flatten to [N, C]
-    Tensor flat = reshape(squeezed, {N, C});
-    
-    // Excitation: FC -> ReLU -> FC -> Sigmoid
-    std::string fc1_weight = prefix + ".excitation.0.weight";
-    std::string fc2_weight = prefix + ".excitation.2.weight";
-    
-    Tensor y = linear(flat, get_weight(fc1_weight));
-    relu6_inplace(y);
-    
-    y = linear(y, get_weight(fc2_weight));
-    sigmoid_inplace(y);
-    
-    // Reshape back to [N, C, 1, 1]
-    Tensor y_reshaped = reshape(y, {N, C, 1, 1});
-    
-    // Broadcast multiply
-    Tensor output = x;
-    for (int n = 0; n < N; ++n) {
-        for (int c = 0; c < C; ++c) {
-            float scale = y_reshaped.data[n * C + c];
-            for (int h = 0; h < x.shape[2]; ++h) {
-                for (int w = 0; w < x.shape[3]; ++w) {
-                    output.at(n, c, h, w) *= scale;
-                }
+void LiteCNNPro::set_precision(Precision precision) {
+    if (precompiled_) {
+        throw std::runtime_error("The precision of a compiled plan artifact is fixed");
+    }
+    precision_ = precision;
+    if (!plan_.empty()) {
+        compile();
+    }
+}
+
+void LiteCNNPro::set_channel_block(int block) {
+    if (precompiled_) {
+        throw std::runtime_error("The channel block of a compiled plan artifact is fixed");
+    }
+    if (block != 8 && block != 16) {
+        throw std::runtime_error("Unsupported channel block: " + std::to_string(block));
+    }
+    channel_block_ = block;
+    if (!plan_.empty()) {
+        compile();
+    }
+}
+
+// Calibrated scale of the activation consumed by an INT8 step
+float LiteCNNPro::input_scale(const std::string& step_name) const {
+    auto it = weights_.find(step_name + ".input_scale");
+    if (it != weights_.end() && it->second.size() > 0 && it->second.ptr()[0] > 0.0f) {
+        return it->second.ptr()[0];
+    }
+    // A guessed range silently changes predictions; refuse instead
+    throw std::runtime_error("No calibrated INT8 scale for " + step_name +
+                             "; create the weights with --calibrate DIR --out PATH");
+}
+
+// FP16 / BF16 plans keep a 16-bit copy of the (packed) weights and drop the
+// float one; no-op for the other precisions
+void LiteCNNPro::store_weights_16bit(PlanStep& step, const Tensor& weights) const {
+    if (precision_ != Precision::FP16 && precision_ != Precision::BF16) {
+        return;
+    }
+    std::vector<uint16_t> weight16(weights.size());
+    if (precision_ == Precision::FP16) {
+        convert_storage(weights.ptr(), weights.size(),
+                        reinterpret_cast<simd::fp16*>(weight16.data()));
+    } else {
+        convert_storage(weights.ptr(), weights.size(),
+                        reinterpret_cast<simd::bf16*>(weight16.data()));
+    }
+    step.weight16 = std::move(weight16);
+    if (&weights == &step.weight) {
+        step.weight = Tensor();
+    }
+}
+
+// Per-channel symmetric s8 weights, packed for the step's u8 kernel
+void LiteCNNPro::quantize_step(PlanStep& step, const float* weight, int rows, int cols) const {
+    std::vector<int8_t> q;
+    std::vector<float> scales;
+    quantize_per_channel(weight, rows, cols, q, scales);
+
+    switch (step.op) {
+    case OpType::PointwiseConv:
+    case OpType::Linear:
+        step.qweight = pack_pointwise_weight_nchwc_s8(q.data(), rows, cols, channel_block_);
+        break;
+    case OpType::DepthwiseConv:
+        step.qweight = pack_depthwise_weight_nchwc_s8(q.data(), rows, cols, channel_block_);
+        break;
+    default:
+        step.qweight = std::move(q);
+        break;
+    }
+
+    step.input_scale = input_scale(step.name);
+    int padded = round_up_channels(rows, channel_block_);
+    step.requant = Tensor({padded});
+    std::fill(step.requant.data.begin(), step.requant.data.end(), 0.0f);
+    for (int r = 0; r < rows; ++r) {
+        step.requant.data[r] = step.input_scale * scales[r];
+    }
+}
+
+// Conv followed by BatchNorm, folded into a single conv with bias:
+//   w' = w * gamma / sqrt(var + eps),  b' = beta - mean * gamma / sqrt(var + eps)
+PlanStep LiteCNNPro::compile_conv(const std::string& conv_name, const std::string& bn_name,
+                                  int stride, int padding, int groups, bool relu6) const {
+    const float eps = 1e-5f;
+    const Tensor& w = get_weight(conv_name + ".weight");
+    const Tensor& gamma = get_weight(bn_name + ".weight");
+    const Tensor& beta = get_weight(bn_name + ".bias");
+    const Tensor& mean = get_weight(bn_name + ".running_mean");
+    const Tensor& var = get_weight(bn_name + ".running_var");
+
+    int C_out = w.shape[0];
+    int K = w.shape[1] * w.shape[2] * w.shape[3];
+
+    PlanStep step;
+    step.name = conv_name;
+    step.stride = stride;
+    step.padding = padding;
+    step.kernel_h = w.shape[2];
+    step.kernel_w = w.shape[3];
+    step.relu6 = relu6;
+    step.weight = Tensor(w.shape);
+    step.bias = Tensor({C_out});
+
+    for (int oc = 0; oc < C_out; ++oc) {
+        float scale = gamma.ptr()[oc] / std::sqrt(var.ptr()[oc] + eps);
+        for (int k = 0; k < K; ++k) {
+            step.weight.data[oc * K + k] = w.ptr()[oc * K + k] * scale;
+        }
+        step.bias.data[oc] = beta.ptr()[oc] - mean.ptr()[oc] * scale;
+    }
+
+    step.out_channels = C_out;
+    bool pointwise = step.kernel_h == 1 && step.kernel_w == 1 && stride == 1 && padding == 0;
+    bool int8 = precision_ == Precision::INT8;
+
+    if (groups == 1 && pointwise) {
+        step.op = OpType::PointwiseConv;
+        if (int8) {
+            quantize_step(step, step.weight.ptr(), C_out, K);
+            step.weight = Tensor();
+        } else {
+            step.weight = pack_pointwise_weight_nchwc(step.weight, channel_block_);
+        }
+    } else if (groups == 1) {
+        step.op = OpType::Conv;
+        step.packed = gemm::PackedMatrix(step.weight.ptr(), C_out, K, K);
+    } else if (groups == C_out && w.shape[1] == 1 && step.kernel_h == step.kernel_w) {
+        step.op = OpType::DepthwiseConv;
+        if (int8 && step.kernel_h == 3) {
+            quantize_step(step, step.weight.ptr(), C_out, K);
+            step.weight = Tensor();
+        } else {
+            step.weight = pack_depthwise_weight_nchwc(step.weight, channel_block_);
+        }
+    } else {
+        throw std::runtime_error("Unsupported conv configuration: " + conv_name);
+    }
+    step.bias = pad_channels(step.bias, channel_block_);
+
+    if (step.op != OpType::Conv && step.qweight.empty()) {
+        store_weights_16bit(step, step.weight);
+    }
+    return step;
+}
+
+uint64_t LiteCNNPro::next_plan_id() {
+    static std::atomic<uint64_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LiteCNNPro::compile() {
+    if (precompiled_) {
+        throw std::runtime_error("A compiled plan artifact cannot be recompiled");
+    }
+    plan_.clear();
+    plan_id_ = next_plan_id();
+    calibration_max_.clear();
+
+    // Stem
+    plan_.push_back(compile_conv("stem.0", "stem.1", 2, 1, 1, true));
+
+    // Features: depthwise separable blocks with SE
+    const int strides[] = {2, 1, 2, 1, 2, 1, 2};
+    for (int i = 0; i < 7; ++i) {
+        std::string prefix = "features." + std::to_string(i);
+        int channels = get_weight(prefix + ".depthwise.weight").shape[0];
+
+        plan_.push_back(compile_conv(prefix + ".depthwise", prefix + ".bn1",
+                                     strides[i], 1, channels, true));
+        plan_.push_back(compile_conv(prefix + ".pointwise", prefix + ".bn2",
+                                     1, 0, 1, true));
+
+        PlanStep se;
+        se.op = OpType::SqueezeExcite;
+        se.name = prefix + ".se";
+        se.fc1 = &get_weight(prefix + ".se.excitation.0.weight");
+        se.fc2 = &get_weight(prefix + ".se.excitation.2.weight");
+        plan_.push_back(std::move(se));
+    }
+
+    // Global average pooling + flatten
+    PlanStep pool;
+    pool.op = OpType::GlobalAvgPool;
+    pool.name = "avgpool";
+    plan_.push_back(std::move(pool));
+
+    // Classifier (no dropout in inference)
+    const char* fc_names[] = {"classifier.2", "classifier.5"};
+    for (int i = 0; i < 2; ++i) {
+        PlanStep fc;
+        fc.op = OpType::Linear;
+        fc.name = fc_names[i];
+        fc.linear_weight = &get_weight(fc.name + ".weight");
+        fc.linear_bias = &get_weight(fc.name + ".bias");
+        fc.relu6 = i == 0;
+        if (precision_ == Precision::INT8) {
+            const Tensor& w = *fc.linear_weight;
+            quantize_step(fc, w.ptr(), w.shape[0], w.shape[1]);
+        } else {
+            store_weights_16bit(fc, *fc.linear_weight);
+        }
+        plan_.push_back(std::move(fc));
+    }
+
+    // Only the stem may consume the NCHW input through the GEMM path
+    for (size_t i = 1; i < plan_.size(); ++i) {
+        if (plan_[i].op == OpType::Conv) {
+            throw std::runtime_error("Dense conv is only supported as the stem: " + plan_[i].name);
+        }
+    }
+
+    // INT8 convs read u8 activations, so their producer quantizes its
+    // output with the consumer's scale instead of writing floats
+    for (size_t i = 0; i < plan_.size(); ++i) {
+        const PlanStep& step = plan_[i];
+        bool u8_input = step.input_scale > 0.0f &&
+                        (step.op == OpType::DepthwiseConv || step.op == OpType::PointwiseConv);
+        if (!u8_input) {
+            continue;
+        }
+        PlanStep* producer = i > 0 ? &plan_[i - 1] : nullptr;
+        bool can_emit = producer && (producer->op == OpType::Conv ||
+                                     producer->op == OpType::SqueezeExcite ||
+                                     (producer->op == OpType::DepthwiseConv && producer->input_scale > 0.0f));
+        if (!can_emit) {
+            throw std::runtime_error("INT8 layer has no quantizing producer: " + step.name);
+        }
+        producer->output_scale = step.input_scale;
+    }
+    for (const PlanStep& step : plan_) {
+        if (step.op == OpType::DepthwiseConv && step.input_scale > 0.0f && step.output_scale == 0.0f) {
+            throw std::runtime_error("INT8 depthwise conv must feed an INT8 pointwise conv: " + step.name);
+        }
+    }
+}
+
+// Walks the plan once for the given input shape, records every activation
+// with its lifetime and lets the memory planner pack them into one arena.
+void LiteCNNPro::prepare_workspace(Workspace& ws, int N, int C, int H, int W) const {
+    struct Value {
+        size_t size;
+        int first_use;
+        int last_use;
+    };
+    std::vector<Value> values;
+    std::vector<int> output_value(plan_.size());
+    std::vector<int> scratch_value(plan_.size(), -1);
+
+    ws.io.assign(plan_.size(), StepIO());
+
+    int c = C, h = H, w = W;
+    int current = -1; // value holding the current activation (-1: caller's input)
+    bool half_storage = precision_ == Precision::FP16 || precision_ == Precision::BF16;
+
+    for (size_t i = 0; i < plan_.size(); ++i) {
+        const PlanStep& step = plan_[i];
+        StepIO& io = ws.io[i];
+        int step_id = static_cast<int>(i);
+        io.in_c = c;
+        io.in_h = h;
+        io.in_w = w;
+
+        size_t scratch = 0;
+        bool in_place = false;
+
+        bool blocked = true;
+
+        switch (step.op) {
+        case OpType::Conv:
+            // im2col columns + NCHW GEMM output, re-blocked into the step output
+            scratch = conv2d_col_size(c, h, w, step.kernel_h, step.kernel_w,
+                                      step.stride, step.padding);
+            c = step.out_channels;
+            h = conv_out_size(h, step.kernel_h, step.stride, step.padding);
+            w = conv_out_size(w, step.kernel_w, step.stride, step.padding);
+            scratch += static_cast<size_t>(N) * c * h * w;
+            break;
+        case OpType::PointwiseConv:
+            c = step.out_channels;
+            break;
+        case OpType::DepthwiseConv:
+            h = conv_out_size(h, step.kernel_h, step.stride, step.padding);
+            w = conv_out_size(w, step.kernel_w, step.stride, step.padding);
+            break;
+        case OpType::SqueezeExcite:
+            scratch = se_block_nchwc_scratch_size(N, c, *step.fc1);
+            in_place = current >= 0 && step.output_scale == 0.0f;
+            break;
+        case OpType::GlobalAvgPool:
+            h = w = 1;
+            blocked = false;
+            break;
+        case OpType::Linear:
+            if (step.input_scale > 0.0f) {
+                scratch = linear_u8_scratch_size(N, c, step.linear_weight->shape[0]);
+            }
+            c = step.linear_weight->shape[0];
+            h = w = 1;
+            blocked = false;
+            break;
+        }
+
+        io.out_c = c;
+        io.out_h = h;
+        io.out_w = w;
+
+        if (current >= 0) {
+            values[current].last_use = step_id;
+        }
+        if (!in_place) {
+            int stored_c = blocked ? round_up_channels(c, kChannelBlock) : c;
+            size_t size = static_cast<size_t>(N) * stored_c * h * w;
+            if (step.output_scale > 0.0f) {
+                size = (size + 3) / 4; // u8 activations
+            } else if (blocked && half_storage) {
+                size = (size + 1) / 2; // fp16 / bf16 activations
             }
+            values.push_back({size, step_id, step_id});
+            current = static_cast<int>(values.size()) - 1;
+        }
+        output_value[i] = current;
+
+        if (scratch > 0) {
+            values.push_back({scratch, step_id, step_id});
+            scratch_value[i] = static_cast<int>(values.size()) - 1;
         }
     }
-    
+
+    MemoryPlanner planner;
+    for (const Value& v : values) {
+        planner.add(v.size, v.first_use, v.last_use);
+    }
+    ws.arena.reserve(planner.plan());
+
+    for (size_t i = 0; i < plan_.size(); ++i) {
+        StepIO& io = ws.io[i];
+        io.output = planner.offset(output_value[i]);
+        io.input = i > 0 ? ws.io[i - 1].output : 0;
+        io.scratch = scratch_value[i] >= 0 ? planner.offset(scratch_value[i]) : 0;
+    }
+
+    ws.batch = N;
+    ws.channels = C;
+    ws.height = H;
+    ws.width = W;
+}
+
+// Conv / linear weights in the plan's storage type
+template <class T>
+static const T* stored_weights(const PlanStep& step) {
+    if constexpr (std::is_same_v<T, float>) {
+        return step.op == OpType::Linear ? step.linear_weight->ptr() : step.weight.ptr();
+    } else {
+        return reinterpret_cast<const T*>(step.weight16.data());
+    }
+}
+
+void LiteCNNPro::execute(const Tensor& input, Tensor& output, Workspace& ws,
+                         std::vector<float>* observed_max, trace::Recorder* tracer) const {
+    switch (precision_) {
+    case Precision::FP16:
+        execute_steps<simd::fp16>(input, ws, observed_max, tracer);
+        break;
+    case Precision::BF16:
+        execute_steps<simd::bf16>(input, ws, observed_max, tracer);
+        break;
+    default:
+        execute_steps<float>(input, ws, observed_max, tracer);
+        break;
+    }
+
+    // Copy the logits out of the arena
+    int N = input.shape[0];
+    const float* logits = ws.arena.data() + ws.io.back().output;
+    int classes = ws.io.back().out_c;
+    if (output.shape.size() != 2 || output.shape[0] != N || output.shape[1] != classes) {
+        output.shape = {N, classes};
+    }
+    output.data.resize(static_cast<size_t>(N) * classes);
+    std::copy(logits, logits + output.data.size(), output.data.begin());
+}
+
+template <class T>
+void LiteCNNPro::execute_steps(const Tensor& input, Workspace& ws,
+                               std::vector<float>* observed_max, trace::Recorder* tracer) const {
+    int N = input.shape[0];
+    float* arena = ws.arena.data();
+
+    for (size_t i = 0; i < plan_.size(); ++i) {
+        const PlanStep& step = plan_[i];
+        const StepIO& io = ws.io[i];
+        const float* in = i == 0 ? input.ptr() : arena + io.input;
+        float* out = arena + io.output;
+        float* scratch = arena + io.scratch;
+        const uint8_t* in_u8 = reinterpret_cast<const uint8_t*>(in);
+        uint8_t* out_u8 = reinterpret_cast<uint8_t*>(out);
+        const T* in_t = reinterpret_cast<const T*>(in);
+        T* out_t = reinterpret_cast<T*>(out);
+        uint64_t begin_ns = tracer ? trace::now_ns() : 0;
+
+        switch (step.op) {
+        case OpType::Conv: {
+            // GEMM into NCHW scratch, then convert to the blocked layout once
+            size_t nchw_size = static_cast<size_t>(N) * io.out_c * io.out_h * io.out_w;
+            float* nchw = scratch;
+            float* col = scratch + nchw_size;
+            conv2d_packed_into(in, N, io.in_c, io.in_h, io.in_w, step.packed,
+                               step.kernel_h, step.kernel_w, step.stride, step.padding,
+                               step.bias.ptr(), step.relu6, nchw, col);
+            if (step.output_scale > 0.0f) {
+                quantize_nchw_to_nchwc_u8(nchw, N, io.out_c, io.out_h * io.out_w,
+                                          1.0f / step.output_scale, out_u8);
+            } else {
+                nchw_to_nchwc_into(nchw, N, io.out_c, io.out_h * io.out_w, out_t);
+            }
+            break;
+        }
+
+        case OpType::PointwiseConv:
+            if (step.input_scale > 0.0f) {
+                pointwise_conv_nchwc_u8_into(in_u8, N, io.in_c, io.out_c, io.in_h * io.in_w,
+                                             step.qweight.data(), step.requant.ptr(),
+                                             step.bias.ptr(), step.relu6, out);
+            } else {
+                pointwise_conv_nchwc_into(in_t, N, io.in_c, io.out_c, io.in_h * io.in_w,
+                                          stored_weights<T>(step), step.bias.ptr(), step.relu6, out_t);
+            }
+            break;
+
+        case OpType::DepthwiseConv:
+            if (step.input_scale > 0.0f) {
+                depthwise_conv_nchwc_u8_into(in_u8, N, io.in_c, io.in_h, io.in_w,
+                                             step.qweight.data(), step.kernel_h, step.stride,
+                                             step.padding, step.requant.ptr(), step.bias.ptr(),
+                                             step.relu6, 1.0f / step.output_scale, out_u8);
+            } else {
+                depthwise_conv_nchwc_into(in_t, N, io.in_c, io.in_h, io.in_w, stored_weights<T>(step),
+                                          step.kernel_h, step.stride, step.padding,
+                                          step.bias.ptr(), step.relu6, out_t);
+            }
+            break;
+
+        case OpType::SqueezeExcite:
+            if (step.output_scale > 0.0f) {
+                se_block_nchwc_quantize(in, N, io.in_c, io.in_h * io.in_w, *step.fc1, *step.fc2,
+                                        scratch, 1.0f / step.output_scale, out_u8);
+                break;
+            }
+            // In place on the block output
+            if (out != in) {
+                size_t count = static_cast<size_t>(N) * round_up_channels(io.in_c, kChannelBlock) *
+                               io.in_h * io.in_w;
+                std::copy(in_t, in_t + count, out_t);
+            }
+            se_block_nchwc_inplace(out_t, N, io.in_c, io.in_h * io.in_w,
+                                   *step.fc1, *step.fc2, scratch);
+            break;
+
+        case OpType::GlobalAvgPool:
+            global_avg_pool_nchwc_into(in_t, N, io.in_c, io.in_h * io.in_w, out);
+            break;
+
+        case OpType::Linear:
+            if (step.input_scale > 0.0f) {
+                linear_u8_into(in, N, io.in_c, step.qweight.data(), io.out_c, step.input_scale,
+                               step.requant.ptr(), step.linear_bias ? step.linear_bias->ptr() : nullptr,
+                               step.relu6, out, scratch);
+            } else {
+                linear_into(in, N, io.in_c, stored_weights<T>(step), io.out_c,
+                            step.linear_bias ? step.linear_bias->ptr() : nullptr,
+                            step.relu6, out);
+            }
+            break;
+        }
+
+        if (tracer) {
+            trace_step(*tracer, step, io, N, begin_ns);
+        }
+
+        if (std::is_same_v<T, float> && observed_max) {
+            bool blocked = step.op != OpType::GlobalAvgPool && step.op != OpType::Linear;
+            int stored_c = blocked ? round_up_channels(io.out_c, kChannelBlock) : io.out_c;
+            size_t count = static_cast<size_t>(N) * stored_c * io.out_h * io.out_w;
+            float& m = (*observed_max)[i];
+            for (size_t k = 0; k < count; ++k) {
+                m = std::max(m, out[k]);
+            }
+        }
+    }
+}
+
+static const char* op_name(OpType op) {
+    switch (op) {
+    case OpType::Conv: return "Conv";
+    case OpType::PointwiseConv: return "PointwiseConv";
+    case OpType::DepthwiseConv: return "DepthwiseConv";
+    case OpType::SqueezeExcite: return "SqueezeExcite";
+    case OpType::GlobalAvgPool: return "GlobalAvgPool";
+    default: return "Linear";
+    }
+}
+
+void LiteCNNPro::trace_step(trace::Recorder& tracer, const PlanStep& step, const StepIO& io,
+                            int N, uint64_t begin_ns) const {
+    uint64_t end_ns = trace::now_ns();
+    // Steps of an INT8 plan that are not quantized run in float
+    const char* precision = step.input_scale > 0.0f ? "int8"
+                          : precision_ == Precision::INT8 ? "fp32" : precision_name(precision_);
+    char args[256];
+    std::snprintf(args, sizeof(args),
+                  "\"op\":\"%s\",\"precision\":\"%s\",\"input\":[%d,%d,%d,%d],\"output\":[%d,%d,%d,%d]",
+                  op_name(step.op), precision, N, io.in_c, io.in_h, io.in_w,
+                  N, io.out_c, io.out_h, io.out_w);
+    tracer.add(step.name.c_str(), "layer", begin_ns, end_ns, args);
+}
+
+void LiteCNNPro::forward(const Tensor& input, Tensor& output, ExecutionContext& context) const {
+    run(input, output, context, nullptr);
+}
+
+void LiteCNNPro::forward(const Tensor& input, Tensor& output) const {
+    run(input, output, *contexts_.acquire(), nullptr);
+}
+
+void LiteCNNPro::run(const Tensor& input, Tensor& output, ExecutionContext& context,
+                     std::vector<float>* observed_max) const {
+    if (plan_.empty()) {
+        throw std::runtime_error("Model is not compiled");
+    }
+    if (channel_block_ != kChannelBlock) {
+        throw std::runtime_error("Plan is packed for channel block " + std::to_string(channel_block_) +
+                                 ", this build runs " + std::to_string(kChannelBlock));
+    }
+    if (input.shape.size() != 4 || input.layout != Layout::NCHW) {
+        throw std::runtime_error("Expected NCHW input");
+    }
+
+    Workspace& ws = context.workspace;
+    int N = input.shape[0], C = input.shape[1], H = input.shape[2], W = input.shape[3];
+    if (context.plan_id != plan_id_ ||
+        ws.batch != N || ws.channels != C || ws.height != H || ws.width != W) {
+        prepare_workspace(ws, N, C, H, W);
+        context.plan_id = plan_id_;
+    }
+
+    execute(input, output, ws, observed_max, context.trace);
+}
+
+Tensor LiteCNNPro::forward(const Tensor& input) const {
+    Tensor output;
+    forward(input, output);
     return output;
 }
 
-Tensor LiteCNNPro::depthwise_separable_conv(const Tensor& x, const std::string& prefix, 
-                                             int stride, bool use_se) {
-    // Depthwise conv
-    Tensor dw_out = conv2d(x, get_weight(prefix + ".depthwise.weight"), 
-                           stride, 1, x.shape[1]);
-    
-    // BatchNorm + ReLU6
-    dw_out = batchnorm2d(dw_out, 
-                         get_weight(prefix + ".bn1.weight"),
-                         get_weight(prefix + ".bn1.bias"),
-                         get_weight(prefix + ".bn1.running_mean"),
-                         get_weight(prefix + ".bn1.running_var"));
-    relu6_inplace(dw_out);
-    
-    // Pointwise conv (1x1)
-    Tensor pw_out = conv2d(dw_out, get_weight(prefix + ".pointwise.weight"), 
-                           1, 0, 1);
-    
-    // BatchNorm + ReLU6
-    pw_out = batchnorm2d(pw_out,
-                         get_weight(prefix + ".bn2.weight"),
-                         get_weight(prefix + ".bn2.bias"),
-                         get_weight(prefix + ".bn2.running_mean"),
-                         get_weight(prefix + ".bn2.running_var"));
-    relu6_inplace(pw_out);
-    
-    // SE block
-    if (use_se) {
-        pw_out = se_block(pw_out, prefix + ".se");
+void LiteCNNPro::calibrate(const Tensor& input) {
+    if (precision_ != Precision::FP32) {
+        throw std::runtime_error("Calibration requires the FP32 plan");
+    }
+    std::vector<float> observed(plan_.size(), 0.0f);
+    Tensor output;
+    run(input, output, *contexts_.acquire(), &observed);
+
+    calibration_max_.resize(plan_.size(), 0.0f);
+    for (size_t i = 0; i < observed.size(); ++i) {
+        calibration_max_[i] = std::max(calibration_max_[i], observed[i]);
     }
-    
-    return pw_out;
 }
 
-Tensor LiteCNNPro::forward(const Tensor& input) {
-    // Stem
-    Tensor x = conv2d(input, get_weight("stem.0.weight"), 2, 1, 1);
-    x = batchnorm2d(x,
-                    get_weight("stem.1.weight"),
-                    get_weight("stem.1.bias"),
-                    get_weight("stem.1.running_mean"),
-                    get_weight("stem.1.running_var"));
-    relu6_inplace(x);
-    
-    // Features
-    x = depthwise_separable_conv(x, "features.0", 2, true);
-    x = depthwise_separable_conv(x, "features.1", 1, true);
-    x = depthwise_separable_conv(x, "features.2", 2, true);
-    x = depthwise_separable_conv(x, "features.3", 1, true);
-    x = depthwise_separable_conv(x, "features.4", 2, true);
-    x = depthwise_separable_conv(x, "features.5", 1, true);
-    x = depthwise_separable_conv(x, "features.6", 2, true);
-    
-    // Global average pooling
-    x = adaptive_avg_pool2d(x, 1, 1);
-    
-    // Flatten
-    int N = x.shape[0];
-    int C = x.shape[1];
-    x = reshape(x, {N, C});
-    
-    // Classifier (no dropout in inference)
-    Tensor fc1_bias = get_weight("classifier.2.bias");
-    x = linear(x, get_weight("classifier.2.weight"), &fc1_bias);
-    relu6_inplace(x);
-    
-    Tensor fc2_bias = get_weight("classifier.5.bias");
-    x = linear(x, get_weight("classifier.5.weight"), &fc2_bias);
-    
-    return x;
+bool LiteCNNPro::save_calibrated_weights(const std::string& path) const {
+    if (precompiled_) {
+        std::cerr << "A compiled plan artifact holds no raw weights to calibrate" << std::endl;
+        return false;
+    }
+    if (calibration_max_.size() != plan_.size()) {
+        std::cerr << "No calibration data; run calibrate() first" << std::endl;
+        return false;
+    }
+
+    const std::string suffix = ".input_scale";
+    std::vector<std::pair<std::string, const Tensor*>> entries;
+    for (const auto& [name, tensor] : weights_) {
+        bool is_scale = name.size() > suffix.size() &&
+                        name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+        if (!is_scale) {
+            entries.push_back({name, &tensor});
+        }
+    }
+
+    // u8 activations cover [0, max] of the calibration set
+    std::vector<Tensor> scales;
+    scales.reserve(plan_.size());
+    for (size_t i = 1; i < plan_.size(); ++i) {
+        const PlanStep& step = plan_[i];
+        if (step.op != OpType::DepthwiseConv && step.op != OpType::PointwiseConv &&
+            step.op != OpType::Linear) {
+            continue;
+        }
+        float max = calibration_max_[i - 1];
+        scales.emplace_back(std::vector<int>{1});
+        scales.back().data[0] = max > 0.0f ? max / 255.0f : 6.0f / 255.0f;
+        entries.push_back({step.name + suffix, &scales.back()});
+    }
+
+    if (!WeightLoader::save(path, entries)) {
+        return false;
+    }
+    std::cout << "Saved weights with " << scales.size() << " activation scales to " << path << std::endl;
+    return true;
 }
@@ -0,0 +1,389 @@
+#include "model.h"
+#include <array>
+#include <fstream>
+#include <iostream>
+
+// Compiled plan artifact (LCNP v2, all little-endian)
+//
+//   "LCNP", u32 version = 2, u32 precision, u32 channel_block,
+//   u32 gemm_mr, u32 gemm_kc, u32 step_count, u32 blob_count, u64 table_size
+//   table:
+//     per step: u32 op, u32 name_len, name, i32 stride, padding, kernel_h,
+//               kernel_w, out_channels, u32 relu6, f32 input_scale,
+//               f32 output_scale, i32 blob index per BlobSlot (-1: none)
+//     per blob: u32 name_len, name, u32 type, u32 ndim, u32 dims[ndim],
+//               u64 offset (from file start), u64 element count
+//   payloads, each starting at a multiple of 64
+//
+// Blobs hold exactly what compile() leaves in the plan: BN-folded weights
+// already packed for the NCHWc kernels and the GEMM, 16-bit and s8 copies,
+// requantization factors and the SE / classifier tensors. The packing is
+// only valid for the channel block and GEMM tile it was made with, so a
+// build with other values rejects the file.
+
+namespace {
+
+// 2: INT8 classifier weights packed like pointwise convs
+constexpr uint32_t kPlanVersion = 2;
+constexpr uint64_t kPlanAlignment = WeightLoader::kAlignment;
+
+enum class BlobType : uint32_t {
+    F32 = 0,
+    U16 = 1,
+    S8 = 2
+};
+
+size_t element_size(BlobType type) {
+    return type == BlobType::F32 ? 4 : type == BlobType::U16 ? 2 : 1;
+}
+
+// Step fields stored as blob indices, in file order
+enum BlobSlot {
+    kWeight,
+    kBias,
+    kPacked,
+    kWeight16,
+    kQWeight,
+    kRequant,
+    kFc1,
+    kFc2,
+    kLinearWeight,
+    kLinearBias,
+    kSlotCount
+};
+
+struct Blob {
+    std::string name;
+    BlobType type = BlobType::F32;
+    std::vector<int> dims;
+    const void* data = nullptr;
+    uint64_t count = 0;
+};
+
+struct ByteWriter {
+    std::vector<uint8_t> bytes;
+
+    template <class T>
+    void put(T v) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+        bytes.insert(bytes.end(), p, p + sizeof(T));
+    }
+    void put(const std::string& s) {
+        put(static_cast<uint32_t>(s.size()));
+        bytes.insert(bytes.end(), s.begin(), s.end());
+    }
+};
+
+// Everything execute_steps() dereferences for the step is present
+bool has_operands(const PlanStep& step) {
+    size_t padded_channels = round_up_channels(step.out_channels, kChannelBlock);
+    bool has_weights = !step.weight.shape.empty() || !step.weight16.empty() || !step.qweight.empty();
+    switch (step.op) {
+    case OpType::Conv:
+        return !step.packed.empty() && step.bias.size() == padded_channels;
+    case OpType::PointwiseConv:
+    case OpType::DepthwiseConv:
+        return has_weights && step.bias.size() == padded_channels &&
+               (step.input_scale == 0.0f || step.requant.size() == padded_channels);
+    case OpType::SqueezeExcite:
+        return step.fc1 && step.fc2;
+    case OpType::Linear: {
+        if (!step.linear_weight || step.linear_weight->shape.size() != 2) {
+            return false;
+        }
+        // INT8: packed like a pointwise conv
+        size_t out_pad = round_up_channels(step.linear_weight->shape[0], kChannelBlock);
+        size_t in_pad = round_up_channels(step.linear_weight->shape[1], kChannelBlock);
+        return step.input_scale == 0.0f ||
+               (step.qweight.size() == out_pad * in_pad && step.requant.size() == out_pad);
+    }
+    default:
+        return true;
+    }
+}
+
+} // namespace
+
+bool LiteCNNPro::save_plan(const std::string& path) const {
+    if (plan_.empty()) {
+        std::cerr << "Model is not compiled" << std::endl;
+        return false;
+    }
+
+    // Loaded tensors the SE / Linear steps point at keep their names
+    std::map<const Tensor*, std::string> names;
+    for (const auto& [name, tensor] : weights_) {
+        names[&tensor] = name;
+    }
+
+    std::vector<Blob> blobs;
+    auto add = [&blobs](Blob blob) {
+        blobs.push_back(std::move(blob));
+        return static_cast<int32_t>(blobs.size() - 1);
+    };
+    auto add_tensor = [&](const std::string& name, const Tensor& t) -> int32_t {
+        return t.shape.empty() ? -1 : add({name, BlobType::F32, t.shape, t.ptr(), t.size()});
+    };
+    auto add_loaded = [&](const Tensor* t) -> int32_t {
+        return t ? add_tensor(names.at(t), *t) : -1;
+    };
+
+    ByteWriter table;
+    for (const PlanStep& step : plan_) {
+        int32_t slots[kSlotCount];
+        slots[kWeight] = add_tensor(step.name + ".weight", step.weight);
+        slots[kBias] = add_tensor(step.name + ".bias", step.bias);
+        slots[kPacked] = step.packed.empty() ? -1 :
+            add({step.name + ".packed", BlobType::F32, {step.packed.rows(), step.packed.cols()},
+                 step.packed.data(), step.packed.size()});
+        slots[kWeight16] = step.weight16.empty() ? -1 :
+            add({step.name + ".weight16", BlobType::U16, {static_cast<int>(step.weight16.size())},
+                 step.weight16.data(), step.weight16.size()});
+        slots[kQWeight] = step.qweight.empty() ? -1 :
+            add({step.name + ".qweight", BlobType::S8, {static_cast<int>(step.qweight.size())},
+                 step.qweight.data(), step.qweight.size()});
+        slots[kRequant] = add_tensor(step.name + ".requant", step.requant);
+        slots[kFc1] = add_loaded(step.fc1);
+        slots[kFc2] = add_loaded(step.fc2);
+        slots[kLinearWeight] = add_loaded(step.linear_weight);
+        slots[kLinearBias] = add_loaded(step.linear_bias);
+
+        table.put(static_cast<uint32_t>(step.op));
+        table.put(step.name);
+        table.put(static_cast<int32_t>(step.stride));
+        table.put(static_cast<int32_t>(step.padding));
+        table.put(static_cast<int32_t>(step.kernel_h));
+        table.put(static_cast<int32_t>(step.kernel_w));
+        table.put(static_cast<int32_t>(step.out_channels));
+        table.put(static_cast<uint32_t>(step.relu6));
+        table.put(step.input_scale);
+        table.put(step.output_scale);
+        for (int32_t slot : slots) {
+            table.put(slot);
+        }
+    }
+
+    // Lay out the payloads behind the table
+    auto align = [](uint64_t x) { return (x + kPlanAlignment - 1) / kPlanAlignment * kPlanAlignment; };
+    uint64_t table_size = table.bytes.size();
+    for (const Blob& blob : blobs) {
+        table_size += 4 + blob.name.size() + 8 + 4 * blob.dims.size() + 16;
+    }
+    std::vector<uint64_t> offsets;
+    uint64_t offset = align(40 + table_size);
+    for (const Blob& blob : blobs) {
+        offsets.push_back(offset);
+        offset = align(offset + blob.count * element_size(blob.type));
+    }
+    for (size_t i = 0; i < blobs.size(); ++i) {
+        table.put(blobs[i].name);
+        table.put(static_cast<uint32_t>(blobs[i].type));
+        table.put(static_cast<uint32_t>(blobs[i].dims.size()));
+        for (int dim : blobs[i].dims) {
+            table.put(static_cast<uint32_t>(dim));
+        }
+        table.put(offsets[i]);
+        table.put(blobs[i].count);
+    }
+
+    ByteWriter header;
+    header.bytes = {'L', 'C', 'N', 'P'};
+    header.put(kPlanVersion);
+    header.put(static_cast<uint32_t>(precision_));
+    header.put(static_cast<uint32_t>(channel_block_));
+    header.put(static_cast<uint32_t>(gemm::kMR));
+    header.put(static_cast<uint32_t>(gemm::kKC));
+    header.put(static_cast<uint32_t>(plan_.size()));
+    header.put(static_cast<uint32_t>(blobs.size()));
+    header.put(table_size);
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open plan file for writing: " << path << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(header.bytes.data()), header.bytes.size());
+    file.write(reinterpret_cast<const char*>(table.bytes.data()), table.bytes.size());
+
+    static const char zeros[kPlanAlignment] = {};
+    for (size_t i = 0; i < blobs.size(); ++i) {
+        file.write(zeros, offsets[i] - static_cast<uint64_t>(file.tellp()));
+        file.write(static_cast<const char*>(blobs[i].data), blobs[i].count * element_size(blobs[i].type));
+    }
+    if (!file.good()) {
+        std::cerr << "Failed to write plan file: " << path << std::endl;
+        return false;
+    }
+
+    std::cout << "Saved " << precision_name(precision_) << " plan (" << plan_.size() << " steps, "
+              << blobs.size() << " blobs, channel block " << channel_block_ << ") to " << path
+              << std::endl;
+    return true;
+}
+
+bool LiteCNNPro::load_plan(const std::string& path, const WeightLoadOptions& options) {
+    std::shared_ptr<MappedFile> mapping = MappedFile::map(path, options);
+    if (!mapping) {
+        return false;
+    }
+    std::shared_ptr<const void> storage = mapping;
+    const uint8_t* base = mapping->data();
+
+    ByteReader header{base + 4, base + mapping->size()};
+    uint32_t version = 0, precision = 0, block = 0, mr = 0, kc = 0, step_count = 0, blob_count = 0;
+    uint64_t table_size = 0;
+    if (!header.read(version) || !header.read(precision) || !header.read(block) ||
+        !header.read(mr) || !header.read(kc) || !header.read(step_count) ||
+        !header.read(blob_count) || !header.read(table_size) ||
+        version != kPlanVersion || precision > static_cast<uint32_t>(Precision::INT8) ||
+        table_size > header.remaining()) {
+        std::cerr << "Invalid LCNP plan header" << std::endl;
+        return false;
+    }
+    if (block != static_cast<uint32_t>(kChannelBlock) || mr != static_cast<uint32_t>(gemm::kMR) ||
+        kc != static_cast<uint32_t>(gemm::kKC)) {
+        std::cerr << "Plan was compiled for channel block " << block << " (GEMM " << mr << " x " << kc
+                  << "), this build needs " << kChannelBlock << " (GEMM " << gemm::kMR << " x "
+                  << gemm::kKC << "); recompile it with litecnn_compile" << std::endl;
+        return false;
+    }
+
+    ByteReader table{header.p, header.p + table_size};
+    std::vector<PlanStep> plan(step_count);
+    std::vector<std::array<int32_t, kSlotCount>> step_slots(step_count);
+    for (uint32_t i = 0; i < step_count; ++i) {
+        PlanStep& step = plan[i];
+        uint32_t op = 0, name_len = 0, relu6 = 0;
+        int32_t fields[5];
+        bool ok = table.read(op) && op <= static_cast<uint32_t>(OpType::Linear) &&
+                  table.read(name_len) && table.read(step.name, name_len);
+        for (int32_t& f : fields) {
+            ok = ok && table.read(f);
+        }
+        ok = ok && table.read(relu6) && table.read(step.input_scale) && table.read(step.output_scale);
+        for (int32_t& slot : step_slots[i]) {
+            ok = ok && table.read(slot) && slot >= -1 && slot < static_cast<int64_t>(blob_count);
+        }
+        if (!ok) {
+            std::cerr << "Invalid LCNP plan step " << i << std::endl;
+            return false;
+        }
+        step.op = static_cast<OpType>(op);
+        step.stride = fields[0];
+        step.padding = fields[1];
+        step.kernel_h = fields[2];
+        step.kernel_w = fields[3];
+        step.out_channels = fields[4];
+        step.relu6 = relu6 != 0;
+    }
+
+    std::vector<Blob> blobs(blob_count);
+    for (Blob& blob : blobs) {
+        uint32_t name_len = 0, type = 0, ndim = 0;
+        bool ok = table.read(name_len) && table.read(blob.name, name_len) && table.read(type) &&
+                  type <= static_cast<uint32_t>(BlobType::S8) && table.read(ndim) && ndim <= 8;
+        blob.type = static_cast<BlobType>(type);
+        blob.dims.resize(ok ? ndim : 0);
+        for (int& dim : blob.dims) {
+            uint32_t d = 0;
+            ok = ok && table.read(d);
+            dim = static_cast<int>(d);
+        }
+        uint64_t offset = 0;
+        ok = ok && table.read(offset) && table.read(blob.count) && offset % kPlanAlignment == 0 &&
+             offset <= mapping->size() &&
+             blob.count <= (mapping->size() - offset) / element_size(blob.type);
+        if (!ok) {
+            std::cerr << "Invalid LCNP plan blob: " << blob.name << std::endl;
+            return false;
+        }
+        blob.data = base + offset;
+    }
+
+    // Blobs are typed views; plain tensors must match their shape exactly
+    auto blob_of = [&](int32_t index, BlobType type) -> const Blob* {
+        if (index < 0) {
+            return nullptr;
+        }
+        const Blob& blob = blobs[index];
+        if (blob.type != type) {
+            throw std::runtime_error("Unexpected type of plan blob " + blob.name);
+        }
+        return &blob;
+    };
+    auto tensor_of = [&](int32_t index) {
+        const Blob* blob = blob_of(index, BlobType::F32);
+        if (!blob) {
+            return Tensor();
+        }
+        uint64_t elements = 1;
+        for (int dim : blob->dims) {
+            elements *= static_cast<uint32_t>(dim);
+        }
+        if (elements != blob->count) {
+            throw std::runtime_error("Shape mismatch of plan blob " + blob->name);
+        }
+        return Tensor::view_of(blob->dims, static_cast<const float*>(blob->data), storage);
+    };
+
+    std::map<std::string, Tensor> weights;
+    try {
+        for (uint32_t i = 0; i < step_count; ++i) {
+            PlanStep& step = plan[i];
+            const std::array<int32_t, kSlotCount>& slots = step_slots[i];
+            step.weight = tensor_of(slots[kWeight]);
+            step.bias = tensor_of(slots[kBias]);
+            step.requant = tensor_of(slots[kRequant]);
+            if (const Blob* packed = blob_of(slots[kPacked], BlobType::F32)) {
+                if (packed->dims.size() != 2 ||
+                    packed->count != gemm::PackedMatrix::packed_size(packed->dims[0], packed->dims[1])) {
+                    throw std::runtime_error("Shape mismatch of plan blob " + packed->name);
+                }
+                step.packed = gemm::PackedMatrix::view_of(static_cast<const float*>(packed->data),
+                                                          packed->dims[0], packed->dims[1], storage);
+            }
+            if (const Blob* w16 = blob_of(slots[kWeight16], BlobType::U16)) {
+                step.weight16 = PlanWeights<uint16_t>::view_of(
+                    static_cast<const uint16_t*>(w16->data), w16->count, storage);
+            }
+            if (const Blob* q = blob_of(slots[kQWeight], BlobType::S8)) {
+                step.qweight = PlanWeights<int8_t>::view_of(
+                    static_cast<const int8_t*>(q->data), q->count, storage);
+            }
+            const Tensor** loaded[] = {&step.fc1, &step.fc2, &step.linear_weight, &step.linear_bias};
+            for (int k = 0; k < 4; ++k) {
+                int32_t index = slots[kFc1 + k];
+                if (index >= 0) {
+                    Tensor& t = weights[blobs[index].name];
+                    t = tensor_of(index);
+                    *loaded[k] = &t;
+                }
+            }
+
+            if (!has_operands(step)) {
+                throw std::runtime_error("Incomplete plan step " + step.name);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid LCNP plan: " << e.what() << std::endl;
+        return false;
+    }
+
+    Precision loaded_precision = static_cast<Precision>(precision);
+    if (precision_ != loaded_precision) {
+        std::cout << "Using the " << precision_name(loaded_precision)
+                  << " precision the plan was compiled with" << std::endl;
+    }
+
+    weights_.swap(weights); // keeps the step pointers valid
+    plan_ = std::move(plan);
+    precision_ = loaded_precision;
+    channel_block_ = static_cast<int>(block);
+    precompiled_ = true;
+    plan_id_ = next_plan_id();
+    calibration_max_.clear();
+
+    std::cout << "Mapped compiled " << precision_name(precision_) << " plan with " << plan_.size()
+              << " steps" << std::endl;
+    return true;
+}
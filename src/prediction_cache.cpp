@@ -0,0 +1,222 @@
+#include "prediction_cache.h"
+#include <cstring>
+#include <random>
+
+namespace {
+
+// xxHash64 (XXH64), ~10 GB/s: hashing a multi-megabyte upload twice still
+// costs far less than receiving it
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t read64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t mix_round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    return rotl(acc, 31) * kPrime1;
+}
+
+inline uint64_t merge_round(uint64_t acc, uint64_t value) {
+    acc ^= mix_round(0, value);
+    return acc * kPrime1 + kPrime4;
+}
+
+uint64_t xxh64(const uint8_t* p, size_t size, uint64_t seed) {
+    const uint8_t* end = p + size;
+    uint64_t h;
+    if (size >= 32) {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = mix_round(v1, read64(p));
+            v2 = mix_round(v2, read64(p + 8));
+            v3 = mix_round(v3, read64(p + 16));
+            v4 = mix_round(v4, read64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge_round(h, v1);
+        h = merge_round(h, v2);
+        h = merge_round(h, v3);
+        h = merge_round(h, v4);
+    } else {
+        h = seed + kPrime5;
+    }
+    h += static_cast<uint64_t>(size);
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= mix_round(0, read64(p));
+        h = rotl(h, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+        h = rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= *p * kPrime5;
+        h = rotl(h, 11) * kPrime1;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+// List node + both hash map nodes, roughly
+constexpr size_t kEntryOverhead = 160;
+
+} // namespace
+
+PredictionCache::PredictionCache(const CacheOptions& options) : options_(options) {
+    std::random_device random;
+    for (uint64_t& seed : seeds_) {
+        seed = (static_cast<uint64_t>(random()) << 32) | random();
+    }
+}
+
+size_t PredictionCache::entry_bytes(const Entry& entry) {
+    return kEntryOverhead + entry.logits.size() * sizeof(float);
+}
+
+std::vector<float> PredictionCache::get_or_compute(const uint8_t* data, size_t size,
+                                                   const std::function<std::vector<float>()>& compute,
+                                                   Outcome* outcome) {
+    if (options_.max_bytes == 0) {
+        if (outcome) {
+            *outcome = Outcome::Miss;
+        }
+        return compute();
+    }
+
+    // Hashed outside the lock
+    Key key{{xxh64(data, size, seeds_[0]), xxh64(data, size, seeds_[1])}, size};
+
+    std::promise<std::vector<float>> promise;
+    uint64_t generation;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            Entry& entry = *it->second;
+            if (options_.ttl_s > 0 &&
+                Clock::now() - entry.stored > std::chrono::seconds(options_.ttl_s)) {
+                erase(it->second);
+            } else {
+                lru_.splice(lru_.begin(), lru_, it->second);
+                ++stats_.hits;
+                if (outcome) {
+                    *outcome = Outcome::Hit;
+                }
+                return entry.logits;
+            }
+        }
+
+        auto flight = in_flight_.find(key);
+        if (flight != in_flight_.end()) {
+            std::shared_future<std::vector<float>> result = flight->second;
+            ++stats_.coalesced;
+            lock.unlock();
+            if (outcome) {
+                *outcome = Outcome::Coalesced;
+            }
+            return result.get();
+        }
+
+        ++stats_.misses;
+        in_flight_.emplace(key, promise.get_future().share());
+        generation = generation_;
+    }
+    if (outcome) {
+        *outcome = Outcome::Miss;
+    }
+
+    std::vector<float> logits;
+    try {
+        logits = compute();
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (generation == generation_) {
+                in_flight_.erase(key);
+            }
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (generation == generation_) {
+            in_flight_.erase(key);
+            insert(key, logits);
+        }
+    }
+    promise.set_value(logits);
+    return logits;
+}
+
+void PredictionCache::insert(const Key& key, const std::vector<float>& logits) {
+    auto existing = entries_.find(key);
+    if (existing != entries_.end()) {
+        erase(existing->second);
+    }
+
+    lru_.push_front(Entry{key, logits, Clock::now()});
+    size_t bytes = entry_bytes(lru_.front());
+    if (bytes > options_.max_bytes) {
+        lru_.pop_front();
+        return;
+    }
+    entries_.emplace(key, lru_.begin());
+    stats_.bytes += bytes;
+    ++stats_.entries;
+
+    while (stats_.bytes > options_.max_bytes) {
+        erase(std::prev(lru_.end()));
+        ++stats_.evictions;
+    }
+}
+
+void PredictionCache::erase(std::list<Entry>::iterator it) {
+    stats_.bytes -= entry_bytes(*it);
+    --stats_.entries;
+    entries_.erase(it->key);
+    lru_.erase(it);
+}
+
+void PredictionCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    entries_.clear();
+    in_flight_.clear();
+    stats_.entries = 0;
+    stats_.bytes = 0;
+    ++generation_;
+}
+
+CacheStats PredictionCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
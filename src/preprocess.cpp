@@ -0,0 +1,190 @@
+#include "preprocess.h"
+#include "jpeg_decoder.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Include STB image (header-only)
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+namespace {
+
+// ImageNet normalization
+const float kMean[3] = {0.485f, 0.456f, 0.406f};
+const float kStd[3] = {0.229f, 0.224f, 0.225f};
+
+void check_image_size(int width, int height, int64_t limit = kMaxImagePixels) {
+    if (static_cast<int64_t>(width) * height > limit) {
+        throw std::runtime_error("Image too large: " + std::to_string(width) + "x" +
+                                 std::to_string(height));
+    }
+}
+
+// Resampling taps of one axis: output i is the weighted sum of count[i]
+// source pixels starting at first[i]
+struct Axis {
+    int taps = 0; // row stride of weights
+    std::vector<int> first;
+    std::vector<int> count;
+    std::vector<float> weights;
+};
+
+// Triangle filter; when shrinking its radius grows with the ratio so the
+// output averages every source pixel instead of skipping most of them
+void compute_axis(int in, int out, Axis& axis) {
+    double ratio = static_cast<double>(in) / out;
+    double radius = std::max(ratio, 1.0);
+    axis.taps = 2 * static_cast<int>(std::ceil(radius)) + 1;
+    axis.first.resize(out);
+    axis.count.resize(out);
+    axis.weights.resize(static_cast<size_t>(out) * axis.taps);
+
+    for (int i = 0; i < out; ++i) {
+        double center = (i + 0.5) * ratio;
+        int lo = std::max(0, static_cast<int>(center - radius + 0.5));
+        int hi = std::min({in, static_cast<int>(center + radius + 0.5), lo + axis.taps});
+        float* w = &axis.weights[static_cast<size_t>(i) * axis.taps];
+        double total = 0.0;
+        for (int x = lo; x < hi; ++x) {
+            double t = std::max(0.0, 1.0 - std::fabs((x + 0.5 - center) / radius));
+            w[x - lo] = static_cast<float>(t);
+            total += t;
+        }
+        for (int x = lo; x < hi; ++x) {
+            w[x - lo] = total > 0.0 ? static_cast<float>(w[x - lo] / total) : 1.0f / (hi - lo);
+        }
+        axis.first[i] = lo;
+        axis.count[i] = hi - lo;
+    }
+}
+
+// (v / 255 - mean) / std folded into v * scale + bias
+void normalization(float scale[3], float bias[3]) {
+    for (int c = 0; c < 3; ++c) {
+        scale[c] = 1.0f / (255.0f * kStd[c]);
+        bias[c] = -kMean[c] / kStd[c];
+    }
+}
+
+} // namespace
+
+DecodedImage decode_image(const uint8_t* data, size_t size) {
+    // Baseline JPEGs large enough for a reduced IDCT are decoded at the
+    // smallest scale that still covers the input size, everything else
+    // (small images, PNG, progressive JPEG, ...) through stb_image
+    DecodedImage image;
+    jpeg::Header header;
+    if (jpeg::read_header(data, size, header) && header.supported) {
+        check_image_size(header.width, header.height, kMaxSourcePixels);
+        int scale = jpeg::scale_for(header, kInputSize);
+        check_image_size(jpeg::scaled_size(header.width, scale), jpeg::scaled_size(header.height, scale));
+        auto reduced = std::make_shared<jpeg::Image>();
+        if (scale > 1 && jpeg::decode(data, size, scale, *reduced)) {
+            image.width = reduced->width;
+            image.height = reduced->height;
+            image.rgb = reduced->rgb.data();
+            image.storage = std::move(reduced);
+            return image;
+        }
+    }
+
+    int channels = 0;
+    if (!stbi_info_from_memory(data, static_cast<int>(size), &image.width, &image.height, &channels)) {
+        throw std::runtime_error("Failed to decode image");
+    }
+    check_image_size(image.width, image.height);
+    unsigned char* pixels = stbi_load_from_memory(
+        data, static_cast<int>(size),
+        &image.width, &image.height, &channels, 3
+    );
+    if (!pixels) {
+        throw std::runtime_error("Failed to decode image");
+    }
+    image.rgb = pixels;
+    image.storage = std::shared_ptr<const void>(pixels, stbi_image_free);
+    return image;
+}
+
+void resize_normalize_into(const DecodedImage& image, float* dst) {
+    // Filter taps depend only on the image size; the buffers are reused.
+    // Named references so pool threads read the caller's copies.
+    thread_local Axis col_taps, row_taps;
+    const Axis& cols = col_taps;
+    const Axis& rows = row_taps;
+    compute_axis(image.width, kInputSize, col_taps);
+    compute_axis(image.height, kInputSize, row_taps);
+
+    float scale[3], bias[3];
+    normalization(scale, bias);
+
+    const size_t row_len = static_cast<size_t>(image.width) * 3;
+    const size_t plane = static_cast<size_t>(kInputSize) * kInputSize;
+    const int width = simd::kWidth;
+
+    parallel::parallel_for(kInputSize, [&](int begin, int end) {
+        thread_local std::vector<float> acc;
+        if (acc.size() < row_len) {
+            acc.resize(row_len);
+        }
+
+        for (int oy = begin; oy < end; ++oy) {
+            // Vertical taps over whole interleaved rows
+            const float* wy = &rows.weights[static_cast<size_t>(oy) * rows.taps];
+            const uint8_t* src = image.rgb + rows.first[oy] * row_len;
+            int taps = rows.count[oy];
+            size_t i = 0;
+            for (; i + width <= row_len; i += width) {
+                simd::vfloat s = simd::zero();
+                for (int t = 0; t < taps; ++t) {
+                    s = simd::fmadd(simd::set1(wy[t]), simd::load_u8(src + t * row_len + i), s);
+                }
+                simd::store(acc.data() + i, s);
+            }
+            for (; i < row_len; ++i) {
+                float s = 0.0f;
+                for (int t = 0; t < taps; ++t) {
+                    s += wy[t] * src[t * row_len + i];
+                }
+                acc[i] = s;
+            }
+
+            // Horizontal taps, normalization and HWC -> CHW
+            float* out = dst + static_cast<size_t>(oy) * kInputSize;
+            for (int ox = 0; ox < kInputSize; ++ox) {
+                const float* wx = &cols.weights[static_cast<size_t>(ox) * cols.taps];
+                const float* p = acc.data() + static_cast<size_t>(cols.first[ox]) * 3;
+                float r = 0.0f, g = 0.0f, b = 0.0f;
+                for (int t = 0; t < cols.count[ox]; ++t) {
+                    r += wx[t] * p[3 * t];
+                    g += wx[t] * p[3 * t + 1];
+                    b += wx[t] * p[3 * t + 2];
+                }
+                out[ox] = r * scale[0] + bias[0];
+                out[plane + ox] = g * scale[1] + bias[1];
+                out[2 * plane + ox] = b * scale[2] + bias[2];
+            }
+        }
+    }, 8);
+}
+
+void normalize_into(const uint8_t* rgb, float* dst) {
+    float scale[3], bias[3];
+    normalization(scale, bias);
+    const size_t plane = static_cast<size_t>(kInputSize) * kInputSize;
+    for (size_t i = 0; i < plane; ++i) {
+        dst[i] = rgb[3 * i] * scale[0] + bias[0];
+        dst[plane + i] = rgb[3 * i + 1] * scale[1] + bias[1];
+        dst[2 * plane + i] = rgb[3 * i + 2] * scale[2] + bias[2];
+    }
+}
+
+Tensor preprocess_image(const uint8_t* data, size_t size) {
+    Tensor tensor({1, 3, kInputSize, kInputSize});
+    resize_normalize_into(decode_image(data, size), tensor.ptr());
+    return tensor;
+}
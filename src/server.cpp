@@ -1,108 +1,131 @@
 #include "server.h"
+#include "preprocess.h"
 #include <iostream>
 #include <sstream>
+#include <filesystem>
 #include <fstream>
 #include <vector>
 #include <algorithm>
+#include <cmath>
 #include "../third_party/json.hpp"
 
-// Include STB image (header-only)
-#define STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_RESIZE_IMPLEMENTATION
-#include "stb_image.h"
-#include "stb_image_resize2.h"
-
 // Include cpp-httplib (header-only)
 #include "httplib.h"
 
 using json = nlohmann::json;
 
-InferenceServer::InferenceServer(int port, const std::string& weights_path, const std::string& breeds_path)
-    : port_(port) {
-    model_ = std::make_unique<LiteCNNPro>();
-    
+namespace {
+
+// Peer address as both front-ends report it (numeric, IPv4 or IPv6)
+bool is_loopback(const std::string& addr) {
+    return addr.rfind("127.", 0) == 0 || addr == "::1" || addr.rfind("::ffff:127.", 0) == 0;
+}
+
+} // namespace
+
+InferenceServer::InferenceServer(int port, const std::string& weights_path, const std::string& breeds_path,
+                                 Precision precision, const BatchOptions& batching,
+                                 const WeightLoadOptions& loading, const CacheOptions& caching,
+                                 const TraceOptions& tracing)
+    : port_(port), weights_path_(weights_path), precision_(precision), loading_(loading),
+      warmup_batch_(batching.max_batch), tracing_(tracing) {
     std::cout << "Loading model weights..." << std::endl;
-    if (!model_->load_weights(weights_path)) {
-        throw std::runtime_error("Failed to load model weights");
-    }
+    batcher_ = std::make_unique<Batcher>(load_model(), batching);
     std::cout << "Model loaded successfully!" << std::endl;
+    cache_ = std::make_unique<PredictionCache>(caching);
     
     std::cout << "Loading breed classes..." << std::endl;
     load_breeds(breeds_path);
     std::cout << "Loaded " << breeds_.size() << " breed classes!" << std::endl;
+    
+    if (tracing_.sample_every > 0) {
+        std::filesystem::create_directories(tracing_.dir);
+    }
 }
 
-void InferenceServer::load_breeds(const std::string& breeds_path) {
-    std::ifstream f(breeds_path);
+std::map<int, BreedInfo> load_breed_classes(const std::string& path) {
+    std::ifstream f(path);
     if (!f.is_open()) {
-        throw std::runtime_error("Failed to open breeds file: " + breeds_path);
+        throw std::runtime_error("Failed to open breeds file: " + path);
     }
     
     json data = json::parse(f);
     
+    std::map<int, BreedInfo> breeds;
     for (auto& [key, value] : data.items()) {
         int class_id = std::stoi(key);
         BreedInfo info;
         info.en = value["en"].get<std::string>();
         info.ko = value["ko"].get<std::string>();
-        breeds_[class_id] = info;
+        breeds[class_id] = info;
     }
+    return breeds;
 }
 
-Tensor InferenceServer::preprocess_image(const std::vector<uint8_t>& image_data) {
-    // Decode image
-    int width, height, channels;
-    unsigned char* img = stbi_load_from_memory(
-        image_data.data(), image_data.size(), 
-        &width, &height, &channels, 3
-    );
-    
-    if (!img) {
-        throw std::runtime_error("Failed to decode image");
+std::shared_ptr<const LiteCNNPro> InferenceServer::load_model() {
+    auto model = std::make_shared<LiteCNNPro>();
+    model->set_precision(precision_);
+    if (!model->load_weights(weights_path_, loading_)) {
+        throw std::runtime_error("Failed to load model weights");
     }
     
-    // Resize to 224x224
-    const int target_size = 224;
-    std::vector<unsigned char> resized(target_size * target_size * 3);
-    
-    stbir_resize_uint8_linear(
-        img, width, height, 0,
-        resized.data(), target_size, target_size, 0,
-        STBIR_RGB
-    );
-    
-    stbi_image_free(img);
-    
-    // Convert to tensor [1, 3, 224, 224] and normalize
-    Tensor tensor({1, 3, target_size, target_size});
-    
-    // ImageNet normalization
-    float mean[3] = {0.485f, 0.456f, 0.406f};
-    float std[3] = {0.229f, 0.224f, 0.225f};
-    
-    for (int c = 0; c < 3; ++c) {
-        for (int h = 0; h < target_size; ++h) {
-            for (int w = 0; w < target_size; ++w) {
-                int src_idx = (h * target_size + w) * 3 + c;
-                int dst_idx = ((0 * 3 + c) * target_size + h) * target_size + w;
-                
-                float pixel = resized[src_idx] / 255.0f;
-                tensor.data[dst_idx] = (pixel - mean[c]) / std[c];
+    // Also pages in mmapped weights and sizes the model's pooled workspaces
+    std::vector<int> batches = {1};
+    if (warmup_batch_ > 1) {
+        batches.push_back(warmup_batch_);
+    }
+    for (int n : batches) {
+        Tensor input({n, 3, kInputSize, kInputSize});
+        Tensor output = model->forward(input);
+        if (output.shape.size() != 2 || output.shape[0] != n ||
+            (classes_ != 0 && static_cast<size_t>(output.shape[1]) != classes_)) {
+            throw std::runtime_error("Model output shape does not match the served model");
+        }
+        for (float logit : output.data) {
+            if (!std::isfinite(logit)) {
+                throw std::runtime_error("Model produces non-finite logits");
             }
         }
+        classes_ = output.shape[1];
+    }
+    return model;
+}
+
+uint64_t InferenceServer::reload_model() {
+    std::lock_guard<std::mutex> lock(reload_mutex_);
+    auto start = std::chrono::steady_clock::now();
+    std::cout << "Reloading model weights from " << weights_path_ << "..." << std::endl;
+    std::shared_ptr<const LiteCNNPro> model;
+    try {
+        model = load_model();
+    } catch (const std::exception& e) {
+        reload_failures_.fetch_add(1, std::memory_order_relaxed);
+        std::cerr << "Reload failed, keeping the current model: " << e.what() << std::endl;
+        throw;
     }
     
-    return tensor;
+    // Swap first, then drop cached results: a prediction cached after the
+    // clear was computed on the new model
+    batcher_->set_model(std::move(model));
+    cache_->clear();
+    uint64_t generation = model_generation_.fetch_add(1) + 1;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Model generation " << generation << " serving (loaded in " << ms << " ms)" << std::endl;
+    return generation;
 }
 
-std::string InferenceServer::create_response(const std::vector<float>& logits) {
-    // Find top-5 predictions
+void InferenceServer::load_breeds(const std::string& breeds_path) {
+    breeds_ = load_breed_classes(breeds_path);
+}
+
+std::vector<std::pair<int, float>> top_predictions(const std::vector<float>& logits, int k) {
+    k = std::min<int>(k, static_cast<int>(logits.size()));
     std::vector<std::pair<float, int>> scores;
     for (size_t i = 0; i < logits.size(); ++i) {
-        scores.emplace_back(logits[i], i);
+        scores.emplace_back(logits[i], static_cast<int>(i));
     }
     
-    std::partial_sort(scores.begin(), scores.begin() + 5, scores.end(),
+    std::partial_sort(scores.begin(), scores.begin() + k, scores.end(),
                      [](const auto& a, const auto& b) { return a.first > b.first; });
     
     // Softmax for probabilities
@@ -110,20 +133,26 @@ std::string InferenceServer::create_response(const std::vector<float>& logits) {
     float sum_exp = 0.0f;
     std::vector<float> probs;
     
-    for (int i = 0; i < 5; ++i) {
+    for (int i = 0; i < k; ++i) {
         float exp_val = std::exp(scores[i].first - max_logit);
         probs.push_back(exp_val);
         sum_exp += exp_val;
     }
     
+    std::vector<std::pair<int, float>> top;
+    for (int i = 0; i < k; ++i) {
+        top.emplace_back(scores[i].second, probs[i] / sum_exp);
+    }
+    return top;
+}
+
+std::string InferenceServer::create_response(const std::vector<float>& logits,
+                                             const trace::Recorder* trace) {
     // Create JSON response
     json response_json;
     json predictions = json::array();
     
-    for (int i = 0; i < 5; ++i) {
-        float prob = probs[i] / sum_exp;
-        int class_id = scores[i].second;
-        
+    for (const auto& [class_id, prob] : top_predictions(logits, 5)) {
         json pred;
         pred["class_id"] = class_id;
         pred["score"] = prob;
@@ -139,20 +168,37 @@ std::string InferenceServer::create_response(const std::vector<float>& logits) {
     }
     
     response_json["predictions"] = predictions;
+    if (trace) {
+        response_json["trace"] = json::parse(trace->to_json());
+    }
     return response_json.dump();
 }
 
-void InferenceServer::run() {
-    httplib::Server svr;
+std::vector<InferenceServer::Endpoint> InferenceServer::endpoints() {
+    std::vector<Endpoint> list;
     
     // Health check
-    svr.Get("/health", [](const httplib::Request&, httplib::Response& res) {
-        res.set_content("{\"status\":\"ok\"}", "application/json");
-    });
+    list.push_back({"GET", "/health", [this](const httplib::Request&, httplib::Response& res) {
+        CacheStats stats = cache_->stats();
+        json health;
+        health["status"] = "ok";
+        health["model_generation"] = model_generation_.load();
+        health["cache"] = {
+            {"hits", stats.hits},
+            {"misses", stats.misses},
+            {"coalesced", stats.coalesced},
+            {"evictions", stats.evictions},
+            {"entries", stats.entries},
+            {"bytes", stats.bytes},
+        };
+        res.set_content(health.dump(), "application/json");
+    }});
     
     // Inference endpoint
-    svr.Post("/predict", [this](const httplib::Request& req, httplib::Response& res) {
-        try {
+    list.push_back({"POST", "/predict", [this](const httplib::Request& req, httplib::Response& res) {
+        serve(req, res, stages_.total,
+              [this](const httplib::Request& req, httplib::Response& res, trace::Recorder* tracer,
+                     bool embed_trace) {
             // Get image data from multipart form
             auto it = req.form.files.find("image");
             if (it == req.form.files.end()) {
@@ -160,34 +206,332 @@ void InferenceServer::run() {
                 res.set_content("{\"error\":\"No image file provided\"}", "application/json");
                 return;
             }
-            
-            const auto& file = it->second;
-            std::vector<uint8_t> image_data(file.content.begin(), file.content.end());
-            
-            // Preprocess
-            auto start = std::chrono::high_resolution_clock::now();
-            Tensor input = preprocess_image(image_data);
-            
-            // Inference
-            Tensor output = model_->forward(input);
-            auto end = std::chrono::high_resolution_clock::now();
-            
-            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-            
-            // Create response
-            std::vector<float> logits(output.data.begin(), output.data.end());
-            std::string response = create_response(logits);
-            
-            std::cout << "Inference completed in " << duration.count() << "ms" << std::endl;
-            
+            PredictionCache::Outcome outcome;
+            std::string response = predict(it->second.content, outcome, tracer, embed_trace);
+            res.set_header("X-Cache", outcome == PredictionCache::Outcome::Hit ? "hit" :
+                                      outcome == PredictionCache::Outcome::Coalesced ? "coalesced" : "miss");
             res.set_content(response, "application/json");
+        });
+    }});
+    
+    // Pre-decoded input: the body is the model input, described by
+    //   X-Tensor-Dtype: uint8   X-Tensor-Shape: 224,224,3    (interleaved RGB)
+    //   X-Tensor-Dtype: float32 X-Tensor-Shape: 1,3,224,224  (normalized NCHW,
+    //                                                        little-endian)
+    list.push_back({"POST", "/predict_raw", [this](const httplib::Request& req, httplib::Response& res) {
+        serve(req, res, stages_.total_raw,
+              [this](const httplib::Request& req, httplib::Response& res, trace::Recorder* tracer,
+                     bool embed_trace) {
+            if (req.get_header_value("Content-Type") != "application/octet-stream") {
+                res.status = 415;
+                res.set_content("{\"error\":\"Expected Content-Type: application/octet-stream\"}",
+                                "application/json");
+                return;
+            }
+            std::string dtype = req.get_header_value("X-Tensor-Dtype");
+            std::string shape = req.get_header_value("X-Tensor-Shape");
+            shape.erase(std::remove(shape.begin(), shape.end(), ' '), shape.end());
+            const size_t pixels = static_cast<size_t>(kInputSize) * kInputSize;
+            size_t expected;
+            bool rgb8 = dtype == "uint8";
+            if (rgb8 && shape == "224,224,3") {
+                expected = pixels * 3;
+            } else if (dtype == "float32" && shape == "1,3,224,224") {
+                expected = pixels * 3 * sizeof(float);
+            } else {
+                res.status = 400;
+                res.set_content("{\"error\":\"Unsupported X-Tensor-Dtype / X-Tensor-Shape, expected "
+                                "uint8 224,224,3 or float32 1,3,224,224\"}", "application/json");
+                return;
+            }
+            if (req.body.size() != expected) {
+                res.status = 400;
+                res.set_content("{\"error\":\"Body is " + std::to_string(req.body.size()) +
+                                " bytes, expected " + std::to_string(expected) + "\"}", "application/json");
+                return;
+            }
+            res.set_content(predict_raw(req.body, rgb8, tracer, embed_trace), "application/json");
+        });
+    }});
+    
+    // Hot reload of the weights file (see reload_model). A reload loads,
+    // validates and warms up a whole model, so only local callers may ask
+    list.push_back({"POST", "/admin/reload", [this](const httplib::Request& req, httplib::Response& res) {
+        if (!is_loopback(req.remote_addr)) {
+            res.status = 403;
+            res.set_content("{\"error\":\"/admin/reload is only served to loopback clients\"}",
+                            "application/json");
+            return;
+        }
+        json body;
+        try {
+            body["status"] = "ok";
+            body["model_generation"] = reload_model();
         } catch (const std::exception& e) {
             res.status = 500;
-            res.set_content("{\"error\":\"" + std::string(e.what()) + "\"}", 
-                          "application/json");
+            body = {{"error", e.what()}, {"model_generation", model_generation_.load()}};
         }
-    });
+        res.set_content(body.dump(), "application/json");
+    }});
+    
+    // Prometheus scrape endpoint
+    list.push_back({"GET", "/metrics", [this](const httplib::Request&, httplib::Response& res) {
+        res.set_content(render_metrics(), "text/plain; version=0.0.4");
+    }});
+    
+    return list;
+}
+
+void InferenceServer::run() {
+    httplib::Server svr;
+    for (Endpoint& endpoint : endpoints()) {
+        if (endpoint.method == "GET") {
+            svr.Get(endpoint.path, std::move(endpoint.handle));
+        } else {
+            svr.Post(endpoint.path, std::move(endpoint.handle));
+        }
+    }
     
     std::cout << "Starting server on port " << port_ << "..." << std::endl;
     svr.listen("0.0.0.0", port_);
 }
+
+void InferenceServer::run_epoll(const EpollOptions& options) {
+    std::vector<Endpoint> list = endpoints();
+    EpollServer svr(options, [&list](const httplib::Request& req, httplib::Response& res) {
+        for (const Endpoint& endpoint : list) {
+            if (req.method == endpoint.method && req.path == endpoint.path) {
+                endpoint.handle(req, res);
+                return;
+            }
+        }
+        res.status = 404;
+    });
+    
+    std::cout << "Starting server on port " << port_ << " (epoll front-end)..." << std::endl;
+    svr.listen("0.0.0.0", port_);
+}
+
+void InferenceServer::listen_unix(const std::string& path) {
+    unix_server_ = std::make_unique<UnixSocketServer>(path,
+        [this](const std::string& image, int top_k, std::chrono::steady_clock::time_point received) {
+        using Clock = std::chrono::steady_clock;
+        stages_.receive.observe(Clock::now() - received);
+        requests_.fetch_add(1, std::memory_order_relaxed);
+        in_flight_.fetch_add(1, std::memory_order_relaxed);
+        
+        UnixSocketServer::Reply reply;
+        try {
+            PredictionCache::Outcome outcome;
+            std::vector<float> logits = infer(image, outcome, nullptr);
+            Clock::time_point start = Clock::now();
+            reply.predictions = top_predictions(logits, top_k);
+            stages_.serialize.observe(Clock::now() - start);
+        } catch (const std::exception& e) {
+            reply.status = unix_protocol::ServerError;
+            reply.error = e.what();
+        }
+        
+        if (reply.status != unix_protocol::Ok) {
+            errors_.fetch_add(1, std::memory_order_relaxed);
+        }
+        in_flight_.fetch_sub(1, std::memory_order_relaxed);
+        stages_.total_unix.observe(Clock::now() - received);
+        return reply;
+    });
+    std::cout << "Listening on Unix socket " << path << std::endl;
+}
+
+void InferenceServer::listen_shm(const ShmOptions& options) {
+    shm_server_ = std::make_unique<ShmServer>(options,
+        [this](const uint8_t* input, shm_protocol::Dtype dtype, int top_k,
+               std::chrono::steady_clock::time_point submitted) {
+        using Clock = std::chrono::steady_clock;
+        stages_.receive.observe(Clock::now() - submitted);
+        requests_.fetch_add(1, std::memory_order_relaxed);
+        in_flight_.fetch_add(1, std::memory_order_relaxed);
+        
+        std::vector<std::pair<int, float>> top;
+        try {
+            // Reads the producer's slot in place
+            std::vector<float> logits = infer_raw(input, dtype == shm_protocol::RGB8, nullptr);
+            Clock::time_point start = Clock::now();
+            top = top_predictions(logits, top_k);
+            stages_.serialize.observe(Clock::now() - start);
+        } catch (...) {
+            errors_.fetch_add(1, std::memory_order_relaxed);
+            in_flight_.fetch_sub(1, std::memory_order_relaxed);
+            throw;
+        }
+        in_flight_.fetch_sub(1, std::memory_order_relaxed);
+        stages_.total_shm.observe(Clock::now() - submitted);
+        return top;
+    });
+    std::cout << "Accepting shared-memory submissions on " << options.name << std::endl;
+}
+
+void InferenceServer::serve(const httplib::Request& req, httplib::Response& res,
+                            metrics::Histogram& total, const Handler& handler) {
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point handler_start = Clock::now();
+    stages_.receive.observe(handler_start - req.start_time_);
+    uint64_t seq = requests_.fetch_add(1, std::memory_order_relaxed) + 1;
+    in_flight_.fetch_add(1, std::memory_order_relaxed);
+    
+    // Traced on request (X-Trace: 1 or ?trace=1, returned in the body)
+    // or by sampling (written to the trace directory)
+    bool trace_requested = req.get_header_value("X-Trace") == "1" || req.get_param_value("trace") == "1";
+    bool trace_sampled = tracing_.sample_every > 0 && seq % tracing_.sample_every == 0;
+    std::unique_ptr<trace::Recorder> tracer;
+    if (trace_requested || trace_sampled) {
+        tracer = std::make_unique<trace::Recorder>();
+        tracer->add("receive", "stage", trace::to_ns(req.start_time_), trace::to_ns(handler_start));
+    }
+    
+    try {
+        handler(req, res, tracer.get(), trace_requested);
+    } catch (const std::exception& e) {
+        res.status = 500;
+        res.set_content("{\"error\":\"" + std::string(e.what()) + "\"}", 
+                      "application/json");
+    }
+    
+    if (res.status >= 400) {
+        errors_.fetch_add(1, std::memory_order_relaxed);
+    }
+    in_flight_.fetch_sub(1, std::memory_order_relaxed);
+    Clock::time_point end = Clock::now();
+    total.observe(end - req.start_time_);
+    
+    if (trace_sampled) {
+        tracer->add("request", "request", trace::to_ns(req.start_time_), trace::to_ns(end),
+                    "\"status\":" + std::to_string(res.status));
+        std::ofstream f(tracing_.dir + "/trace-" + std::to_string(seq) + ".json");
+        f << tracer->to_json();
+    }
+}
+
+std::string InferenceServer::predict(const std::string& content, PredictionCache::Outcome& outcome,
+                                     trace::Recorder* tracer, bool embed_trace) {
+    std::vector<float> logits = infer(content, outcome, tracer);
+    return serialize(logits, tracer, embed_trace);
+}
+
+std::vector<float> InferenceServer::infer(const std::string& content, PredictionCache::Outcome& outcome,
+                                          trace::Recorder* tracer) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(content.data());
+    trace::Scope span(tracer, "predict", "stage");
+    return cache_->get_or_compute(bytes, content.size(), [&] {
+        // Decode, resize and normalize on this thread; the batch worker
+        // only copies the result into the batch input
+        DecodedImage image;
+        {
+            metrics::ScopedTimer timer(stages_.decode);
+            trace::Scope decode_span(tracer, "decode", "stage");
+            image = decode_image(bytes, content.size());
+        }
+        
+        // Inference (batched with concurrent requests)
+        BatchTimings timings;
+        std::vector<float> result = batcher_->predict(
+            {1, 3, kInputSize, kInputSize},
+            [this, &image, tracer](float* slot) {
+                metrics::ScopedTimer timer(stages_.resize);
+                trace::Scope resize_span(tracer, "resize_normalize", "stage");
+                resize_normalize_into(image, slot);
+            },
+            &timings, tracer);
+        stages_.queue.observe(timings.queue);
+        stages_.forward.observe(timings.forward);
+        return result;
+    }, &outcome);
+}
+
+std::string InferenceServer::predict_raw(const std::string& body, bool rgb8, trace::Recorder* tracer,
+                                         bool embed_trace) {
+    std::vector<float> logits = infer_raw(reinterpret_cast<const uint8_t*>(body.data()), rgb8, tracer);
+    return serialize(logits, tracer, embed_trace);
+}
+
+std::vector<float> InferenceServer::infer_raw(const uint8_t* input, bool rgb8, trace::Recorder* tracer) {
+    trace::Scope span(tracer, "predict", "stage");
+    BatchTimings timings;
+    std::vector<float> logits;
+    if (rgb8) {
+        logits = batcher_->predict(
+            {1, 3, kInputSize, kInputSize},
+            [this, input, tracer](float* slot) {
+                metrics::ScopedTimer timer(stages_.resize);
+                trace::Scope normalize_span(tracer, "normalize", "stage");
+                normalize_into(input, slot);
+            },
+            &timings, tracer);
+    } else {
+        // Already the model input; the batch worker copies it into its slot
+        logits = batcher_->predict({1, 3, kInputSize, kInputSize},
+                                   reinterpret_cast<const float*>(input), &timings, tracer);
+    }
+    stages_.queue.observe(timings.queue);
+    stages_.forward.observe(timings.forward);
+    return logits;
+}
+
+std::string InferenceServer::serialize(const std::vector<float>& logits, trace::Recorder* tracer,
+                                       bool embed_trace) {
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    std::string response;
+    {
+        trace::Scope span(tracer, "serialize", "stage");
+        response = create_response(logits, embed_trace ? tracer : nullptr);
+    }
+    stages_.serialize.observe(Clock::now() - start);
+    return response;
+}
+
+std::string InferenceServer::render_metrics() {
+    std::string out;
+    metrics::write_histograms(out, "litecnn_stage_duration_seconds",
+                              "Time inference requests spend in each stage", "stage", {
+        {"receive", &stages_.receive},
+        {"decode", &stages_.decode},
+        {"resize_normalize", &stages_.resize},
+        {"queue", &stages_.queue},
+        {"forward", &stages_.forward},
+        {"serialize", &stages_.serialize},
+    });
+    metrics::write_histograms(out, "litecnn_request_duration_seconds",
+                              "End-to-end inference latency from the first request line", "endpoint",
+                              {{"predict", &stages_.total}, {"predict_raw", &stages_.total_raw},
+                               {"unix", &stages_.total_unix}, {"shm", &stages_.total_shm}});
+    metrics::write_counter(out, "litecnn_requests_total", "Inference requests over HTTP, the Unix socket and shared memory",
+                           static_cast<double>(requests_.load(std::memory_order_relaxed)));
+    metrics::write_counter(out, "litecnn_request_errors_total",
+                           "Failed inference requests (HTTP status >= 400 or an error reply)",
+                           static_cast<double>(errors_.load(std::memory_order_relaxed)));
+    metrics::write_gauge(out, "litecnn_requests_in_flight", "Inference requests being handled",
+                         in_flight_.load(std::memory_order_relaxed));
+    metrics::write_gauge(out, "litecnn_batch_queue_depth", "Requests waiting for a batch worker",
+                         static_cast<double>(batcher_->queue_depth()));
+    
+    metrics::write_gauge(out, "litecnn_model_generation", "Serving model, 1 at startup and +1 per reload",
+                         static_cast<double>(model_generation_.load()));
+    metrics::write_counter(out, "litecnn_model_reload_failures_total",
+                           "Reloads rejected because the new weights failed to load or validate",
+                           static_cast<double>(reload_failures_.load()));
+    
+    CacheStats cache = cache_->stats();
+    metrics::write_counter(out, "litecnn_cache_hits_total", "Prediction cache hits",
+                           static_cast<double>(cache.hits));
+    metrics::write_counter(out, "litecnn_cache_misses_total", "Prediction cache misses",
+                           static_cast<double>(cache.misses));
+    metrics::write_counter(out, "litecnn_cache_coalesced_total",
+                           "Requests that waited for an identical in-flight request",
+                           static_cast<double>(cache.coalesced));
+    metrics::write_gauge(out, "litecnn_cache_bytes", "Memory held by the prediction cache",
+                         static_cast<double>(cache.bytes));
+    
+    metrics::write_gauge(out, "process_resident_memory_bytes", "Resident memory size in bytes",
+                         static_cast<double>(metrics::resident_memory_bytes()));
+    return out;
+}
@@ -0,0 +1,176 @@
+#include "shm_server.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace shm_protocol;
+
+#if defined(__linux__)
+
+namespace {
+
+// Rejections the producer can fix, as opposed to inference failures
+struct BadInput : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// A single load the compiler may not repeat or defer
+template <typename T>
+T read_once(const T& field) {
+    return *static_cast<const volatile T*>(&field);
+}
+
+} // namespace
+
+ShmServer::ShmServer(const ShmOptions& options, Handler handler)
+    : name_(options.name), handler_(std::move(handler)) {
+    uint32_t slot_count = 2;
+    while (slot_count < static_cast<uint32_t>(std::max(options.slots, 1))) {
+        slot_count *= 2;
+    }
+    size_ = region_size(slot_count);
+    slot_count_ = slot_count;
+
+    // Replaces the region of a previous run; producers still mapping it
+    // must reconnect
+    ::shm_unlink(name_.c_str());
+    int fd = ::shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("shm_open " + name_ + ": " + std::strerror(errno));
+    }
+    if (::ftruncate(fd, static_cast<off_t>(size_)) < 0) {
+        std::string error = std::strerror(errno);
+        ::close(fd);
+        ::shm_unlink(name_.c_str());
+        throw std::runtime_error("ftruncate " + name_ + ": " + error);
+    }
+    void* region = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (region == MAP_FAILED) {
+        ::shm_unlink(name_.c_str());
+        throw std::runtime_error("mmap " + name_ + ": " + std::strerror(errno));
+    }
+
+    // ftruncate zero-fills: every slot starts Free, only the ring needs
+    // its sequence numbers. magic goes last, once the rest is valid
+    header_ = static_cast<Header*>(region);
+    header_->version = kVersion;
+    header_->slot_count = slot_count;
+    slots_ = slots(header_, slot_count);
+    Cell* ring = cells(header_);
+    for (uint32_t i = 0; i < slot_count; ++i) {
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = kMagic;
+
+    for (int i = 0; i < std::max(options.workers, 1); ++i) {
+        workers_.emplace_back(&ShmServer::worker_loop, this);
+    }
+}
+
+ShmServer::~ShmServer() {
+    stopping_.store(true);
+    header_->closed.store(1);
+    futex_wake(header_->submitted, INT_MAX);
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+    // Producers still waiting for a result give up
+    for (uint32_t i = 0; i < slot_count_; ++i) {
+        futex_wake(slots_[i].state, INT_MAX);
+    }
+    ::munmap(header_, size_);
+    ::shm_unlink(name_.c_str());
+}
+
+void ShmServer::worker_loop() {
+    while (!stopping_.load(std::memory_order_relaxed)) {
+        uint32_t index;
+        if (try_pop(header_, slot_count_, index)) {
+            take(index);
+            continue;
+        }
+        // Register as a sleeper, then re-check: a producer bumps
+        // `submitted` after its push and wakes only if sleepers > 0
+        header_->sleepers.fetch_add(1);
+        uint32_t seen = header_->submitted.load();
+        if (try_pop(header_, slot_count_, index)) {
+            header_->sleepers.fetch_sub(1);
+            take(index);
+            continue;
+        }
+        // Timeout so that stop() does not depend on the wake-up alone
+        futex_wait(header_->submitted, seen, 200);
+        header_->sleepers.fetch_sub(1);
+    }
+}
+
+void ShmServer::take(uint32_t index) {
+    // The ring lives in memory every producer can write: a bad index or a
+    // slot pushed twice must not reach a slot nobody submitted
+    if (index >= slot_count_) {
+        return;
+    }
+    Slot& slot = slots_[index];
+    uint32_t expected = Submitted;
+    if (slot.state.compare_exchange_strong(expected, Processing)) {
+        process(slot);
+    }
+}
+
+void ShmServer::process(Slot& slot) {
+    // Read each request field once: the producer can still write the slot,
+    // so validating one read and using another would check nothing
+    auto submitted = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(read_once(slot.submit_ns)));
+    uint32_t dtype = read_once(slot.dtype);
+    uint32_t top_k = read_once(slot.top_k);
+    try {
+        if (dtype != RGB8 && dtype != Float32) {
+            throw BadInput("Unknown dtype " + std::to_string(dtype));
+        }
+        if (top_k < 1 || top_k > static_cast<uint32_t>(kMaxTopK)) {
+            throw BadInput("top_k must be in [1, " + std::to_string(kMaxTopK) + "]");
+        }
+        std::vector<std::pair<int, float>> top =
+            handler_(slot.input, static_cast<Dtype>(dtype), static_cast<int>(top_k), submitted);
+        slot.count = static_cast<uint32_t>(top.size());
+        for (size_t i = 0; i < top.size(); ++i) {
+            slot.predictions[i] = {static_cast<uint32_t>(top[i].first), top[i].second};
+        }
+        slot.status = Ok;
+    } catch (const std::exception& e) {
+        size_t length = std::min(std::strlen(e.what()), kMaxError);
+        std::memcpy(slot.error, e.what(), length);
+        slot.count = static_cast<uint32_t>(length);
+        slot.status = dynamic_cast<const BadInput*>(&e) ? BadRequest : ServerError;
+    }
+    slot.state.store(Done);
+    if (slot.waiting.load()) {
+        futex_wake(slot.state, INT_MAX);
+    }
+}
+
+#else
+
+ShmServer::ShmServer(const ShmOptions&, Handler) {
+    throw std::runtime_error("The shared-memory interface requires Linux");
+}
+
+ShmServer::~ShmServer() = default;
+
+void ShmServer::worker_loop() {}
+
+void ShmServer::take(uint32_t) {}
+
+void ShmServer::process(Slot&) {}
+
+#endif
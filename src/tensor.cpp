@@ -1,27 +1,34 @@
 #include "tensor.h"
 #include <fstream>
 #include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-bool WeightLoader::load(const std::string& path, 
-                        std::vector<std::pair<std::string, Tensor>>& weights) {
-    std::ifstream file(path, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open weights file: " << path << std::endl;
-        return false;
-    }
-    
-    // Read magic number
-    char magic[4];
-    file.read(magic, 4);
-    if (std::strncmp(magic, "LCNN", 4) != 0) {
-        std::cerr << "Invalid magic number" << std::endl;
-        return false;
+namespace {
+
+// Rank and per-dimension limits for v2 tables of contents; anything larger
+// is a corrupt file, not a tensor
+constexpr uint32_t kMaxDims = 8;
+constexpr uint32_t kMaxDim = 1u << 30;
+
+void print_tensor_summary(const std::string& name, const std::vector<int>& shape,
+                          size_t i, size_t count) {
+    if (i < 5 || i + 5 >= count) {
+        std::cout << "  " << name << ": [";
+        for (size_t j = 0; j < shape.size(); ++j) {
+            std::cout << shape[j];
+            if (j < shape.size() - 1) std::cout << ", ";
+        }
+        std::cout << "]" << std::endl;
+    } else if (i == 5) {
+        std::cout << "  ..." << std::endl;
     }
-    
-    // Read version
-    uint32_t version;
-    file.read(reinterpret_cast<char*>(&version), sizeof(uint32_t));
-    
+}
+
+// v1: tensors are read straight into their own storage
+bool load_v1(std::ifstream& file, std::vector<std::pair<std::string, Tensor>>& weights) {
     // Read number of parameters
     uint32_t num_params;
     file.read(reinterpret_cast<char*>(&num_params), sizeof(uint32_t));
@@ -33,10 +40,8 @@ bool WeightLoader::load(const std::string& path,
         uint32_t name_len;
         file.read(reinterpret_cast<char*>(&name_len), sizeof(uint32_t));
         
-        std::vector<char> name_buf(name_len + 1);
-        file.read(name_buf.data(), name_len);
-        name_buf[name_len] = '\0';
-        std::string name(name_buf.data());
+        std::string name(name_len, '\0');
+        file.read(&name[0], name_len);
         
         // Read shape
         uint32_t ndim;
@@ -50,26 +55,255 @@ bool WeightLoader::load(const std::string& path,
         }
         
         // Read data
-        size_t total_size = 1;
-        for (int s : shape) total_size *= s;
-        
-        std::vector<float> data(total_size);
-        file.read(reinterpret_cast<char*>(data.data()), total_size * sizeof(float));
-        
-        Tensor tensor(shape, data);
-        weights.emplace_back(name, std::move(tensor));
-        
-        if (i < 5 || i >= num_params - 5) {
-            std::cout << "  " << name << ": [";
-            for (size_t j = 0; j < shape.size(); ++j) {
-                std::cout << shape[j];
-                if (j < shape.size() - 1) std::cout << ", ";
-            }
-            std::cout << "]" << std::endl;
-        } else if (i == 5) {
-            std::cout << "  ..." << std::endl;
+        Tensor tensor(shape);
+        file.read(reinterpret_cast<char*>(tensor.ptr()), tensor.data.size() * sizeof(float));
+        if (!file) {
+            std::cerr << "Truncated weights file at " << name << std::endl;
+            return false;
         }
+        
+        print_tensor_summary(name, shape, i, num_params);
+        weights.emplace_back(std::move(name), std::move(tensor));
     }
     
     return true;
 }
+
+// v2: map the file and hand out views into it
+bool load_v2(const std::string& path, const WeightLoadOptions& options,
+             std::vector<std::pair<std::string, Tensor>>& weights) {
+    std::shared_ptr<MappedFile> mapping = MappedFile::map(path, options);
+    if (!mapping) {
+        return false;
+    }
+
+    const uint8_t* base = mapping->data();
+    ByteReader header{base + 8, base + mapping->size()};
+    uint32_t count = 0, alignment = 0;
+    uint64_t toc_size = 0;
+    if (!header.read(count) || !header.read(alignment) || !header.read(toc_size) ||
+        alignment == 0 || alignment % alignof(float) != 0 ||
+        toc_size > header.remaining()) {
+        std::cerr << "Invalid LCNN v2 header" << std::endl;
+        return false;
+    }
+
+    std::cout << "Mapping " << count << " parameters..." << std::endl;
+
+    ByteReader toc{header.p, header.p + toc_size};
+    std::shared_ptr<const void> storage = mapping;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t name_len = 0, ndim = 0;
+        std::string name;
+        if (!toc.read(name_len) || !toc.read(name, name_len)) {
+            std::cerr << "Invalid LCNN v2 table of contents" << std::endl;
+            return false;
+        }
+
+        bool ok = toc.read(ndim) && ndim <= kMaxDims;
+        std::vector<int> shape(ok ? ndim : 0);
+        uint64_t elements = 1;
+        for (uint32_t j = 0; ok && j < ndim; ++j) {
+            uint32_t dim = 0;
+            ok = toc.read(dim) && dim <= kMaxDim &&
+                 (dim == 0 || elements <= mapping->size() / sizeof(float) / dim);
+            shape[j] = static_cast<int>(dim);
+            elements *= dim;
+        }
+        uint64_t offset = 0, stored = 0;
+        ok = ok && toc.read(offset) && toc.read(stored) && stored == elements &&
+             offset % alignment == 0 && offset <= mapping->size() &&
+             stored <= (mapping->size() - offset) / sizeof(float);
+        if (!ok) {
+            std::cerr << "Invalid LCNN v2 entry: " << name << std::endl;
+            return false;
+        }
+
+        print_tensor_summary(name, shape, i, count);
+        const float* data = reinterpret_cast<const float*>(base + offset);
+        weights.emplace_back(std::move(name), Tensor::view_of(shape, data, storage));
+    }
+
+    return true;
+}
+
+} // namespace
+
+std::shared_ptr<MappedFile> MappedFile::map(const std::string& path, const WeightLoadOptions& options) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open weights file: " << path << std::endl;
+        return nullptr;
+    }
+    struct stat st;
+    std::shared_ptr<MappedFile> mapping(new MappedFile());
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+        if (options.populate) flags |= MAP_POPULATE;
+#endif
+        void* base = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, flags, fd, 0);
+        if (base != MAP_FAILED) {
+            mapping->base_ = base;
+            mapping->size_ = static_cast<size_t>(st.st_size);
+        }
+    }
+    close(fd);
+    if (!mapping->base_) {
+        std::cerr << "Failed to map weights file: " << path << std::endl;
+        return nullptr;
+    }
+#ifdef MADV_HUGEPAGE
+    if (options.huge_pages) madvise(mapping->base_, mapping->size_, MADV_HUGEPAGE);
+#endif
+#ifdef MADV_WILLNEED
+    if (options.populate) madvise(mapping->base_, mapping->size_, MADV_WILLNEED);
+#endif
+    return mapping;
+}
+
+MappedFile::~MappedFile() {
+    if (base_) munmap(base_, size_);
+}
+
+bool WeightLoader::load(const std::string& path, 
+                        std::vector<std::pair<std::string, Tensor>>& weights,
+                        const WeightLoadOptions& options) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open weights file: " << path << std::endl;
+        return false;
+    }
+    
+    // Read magic number
+    char magic[4];
+    file.read(magic, 4);
+    if (!file || std::strncmp(magic, "LCNN", 4) != 0) {
+        std::cerr << "Invalid magic number" << std::endl;
+        return false;
+    }
+    
+    // Read version
+    uint32_t version = 0;
+    file.read(reinterpret_cast<char*>(&version), sizeof(uint32_t));
+    
+    if (version == 1) {
+        return load_v1(file, weights);
+    }
+    if (version == 2) {
+        file.close();
+        return load_v2(path, options, weights);
+    }
+    std::cerr << "Unsupported LCNN version: " << version << std::endl;
+    return false;
+}
+
+bool WeightLoader::save(const std::string& path,
+                        const std::vector<std::pair<std::string, const Tensor*>>& weights) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open weights file for writing: " << path << std::endl;
+        return false;
+    }
+
+    auto write_u32 = [&file](uint32_t v) {
+        file.write(reinterpret_cast<const char*>(&v), sizeof(uint32_t));
+    };
+    auto write_u64 = [&file](uint64_t v) {
+        file.write(reinterpret_cast<const char*>(&v), sizeof(uint64_t));
+    };
+    auto align = [](uint64_t x) { return (x + kAlignment - 1) / kAlignment * kAlignment; };
+
+    // Lay out the payloads behind the table of contents
+    uint64_t toc_size = 0;
+    for (const auto& [name, tensor] : weights) {
+        toc_size += 4 + name.size() + 4 + 4 * tensor->shape.size() + 16;
+    }
+    std::vector<uint64_t> offsets;
+    uint64_t offset = align(24 + toc_size);
+    for (const auto& entry : weights) {
+        offsets.push_back(offset);
+        offset = align(offset + entry.second->size() * sizeof(float));
+    }
+
+    file.write("LCNN", 4);
+    write_u32(2);
+    write_u32(static_cast<uint32_t>(weights.size()));
+    write_u32(kAlignment);
+    write_u64(toc_size);
+
+    for (size_t i = 0; i < weights.size(); ++i) {
+        const auto& [name, tensor] = weights[i];
+        write_u32(static_cast<uint32_t>(name.size()));
+        file.write(name.data(), name.size());
+
+        write_u32(static_cast<uint32_t>(tensor->shape.size()));
+        for (int dim : tensor->shape) {
+            write_u32(static_cast<uint32_t>(dim));
+        }
+        write_u64(offsets[i]);
+        write_u64(tensor->size());
+    }
+
+    static const char zeros[kAlignment] = {};
+    for (size_t i = 0; i < weights.size(); ++i) {
+        file.write(zeros, offsets[i] - static_cast<uint64_t>(file.tellp()));
+        file.write(reinterpret_cast<const char*>(weights[i].second->ptr()),
+                   weights[i].second->size() * sizeof(float));
+    }
+
+    return file.good();
+}
+
+void nchw_to_nchwc(const float* src, int N, int C, int HW, int block, float* dst) {
+    int blocks = round_up_channels(C, block) / block;
+    for (int n = 0; n < N; ++n) {
+        for (int cb = 0; cb < blocks; ++cb) {
+            float* out = dst + static_cast<size_t>(n * blocks + cb) * HW * block;
+            for (int j = 0; j < block; ++j) {
+                int c = cb * block + j;
+                if (c >= C) {
+                    for (int p = 0; p < HW; ++p) out[p * block + j] = 0.0f;
+                    continue;
+                }
+                const float* plane = src + static_cast<size_t>(n * C + c) * HW;
+                for (int p = 0; p < HW; ++p) {
+                    out[p * block + j] = plane[p];
+                }
+            }
+        }
+    }
+}
+
+void nchwc_to_nchw(const float* src, int N, int C, int HW, int block, float* dst) {
+    int blocks = round_up_channels(C, block) / block;
+    for (int n = 0; n < N; ++n) {
+        for (int c = 0; c < C; ++c) {
+            const float* in = src + static_cast<size_t>(n * blocks + c / block) * HW * block + c % block;
+            float* plane = dst + static_cast<size_t>(n * C + c) * HW;
+            for (int p = 0; p < HW; ++p) {
+                plane[p] = in[p * block];
+            }
+        }
+    }
+}
+
+Tensor to_nchwc(const Tensor& input, int block) {
+    if (input.layout == Layout::NCHWc) {
+        return input.block == block ? input : to_nchwc(to_nchw(input), block);
+    }
+    Tensor output(input.shape, Layout::NCHWc, block);
+    nchw_to_nchwc(input.ptr(), input.shape[0], input.shape[1],
+                  input.shape[2] * input.shape[3], block, output.ptr());
+    return output;
+}
+
+Tensor to_nchw(const Tensor& input) {
+    if (input.layout == Layout::NCHW) {
+        return input;
+    }
+    Tensor output(input.shape);
+    nchwc_to_nchw(input.ptr(), input.shape[0], input.shape[1],
+                  input.shape[2] * input.shape[3], input.block, output.ptr());
+    return output;
+}
@@ -0,0 +1,153 @@
+#include "thread_pool.h"
+#include <chrono>
+
+namespace parallel {
+
+namespace {
+
+// Queue of the pool thread running on this thread (external callers use 0)
+thread_local const ThreadPool* tls_pool = nullptr;
+thread_local int tls_queue = 0;
+
+// Layers issue parallel_for back to back, so idle threads spin this long
+// before sleeping
+constexpr auto kSpin = std::chrono::microseconds(100);
+
+std::unique_ptr<ThreadPool>& global_pool() {
+    static std::unique_ptr<ThreadPool> instance = std::make_unique<ThreadPool>(1);
+    return instance;
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(int threads) {
+    threads = std::max(threads, 1);
+    for (int i = 0; i < threads; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (int i = 1; i < threads; ++i) {
+        workers_.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& t : workers_) {
+        t.join();
+    }
+}
+
+void ThreadPool::push(int queue, const Task& task) {
+    Queue& q = *queues_[queue];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tail - q.head == q.ring.size()) {
+        std::vector<Task> grown(std::max<size_t>(16, 2 * q.ring.size()));
+        for (size_t i = q.head; i < q.tail; ++i) {
+            grown[i - q.head] = q.ring[i % q.ring.size()];
+        }
+        q.tail -= q.head;
+        q.head = 0;
+        q.ring.swap(grown);
+    }
+    q.ring[q.tail++ % q.ring.size()] = task;
+    queued_.fetch_add(1, std::memory_order_release);
+}
+
+bool ThreadPool::run_one(int home) {
+    int n = threads();
+    Task task;
+    bool found = false;
+    for (int i = 0; i < n && !found; ++i) {
+        Queue& q = *queues_[(home + i) % n];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.head == q.tail) {
+            continue;
+        }
+        task = i == 0 ? q.ring[--q.tail % q.ring.size()] : q.ring[q.head++ % q.ring.size()];
+        found = true;
+    }
+    if (!found) {
+        return false;
+    }
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    Job* job = task.job;
+    job->fn(job->ctx, task.begin, task.end);
+    job->pending.fetch_sub(task.end - task.begin, std::memory_order_release);
+    return true;
+}
+
+void ThreadPool::run(int count, int grain, void (*fn)(void*, int, int), void* ctx) {
+    Job job;
+    job.fn = fn;
+    job.ctx = ctx;
+    job.pending.store(count, std::memory_order_relaxed);
+
+    // A few chunks per thread leaves room for stealing; each queue gets a
+    // contiguous run of them so neighbouring tiles stay on one thread
+    int n = threads();
+    int chunks = std::min((count + grain - 1) / grain, 4 * n);
+    int size = (count + chunks - 1) / chunks;
+    chunks = (count + size - 1) / size;
+    int per_queue = (chunks + n - 1) / n;
+    unsigned first = next_queue_.fetch_add(1, std::memory_order_relaxed);
+    for (int c = 0; c < chunks; ++c) {
+        int q = static_cast<int>((first + c / per_queue) % n);
+        push(q, {&job, c * size, std::min(count, (c + 1) * size)});
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    wake_.notify_all();
+
+    int home = tls_pool == this ? tls_queue : static_cast<int>(first % n);
+    while (job.pending.load(std::memory_order_acquire) > 0) {
+        if (!run_one(home)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ThreadPool::worker_loop(int index) {
+    tls_pool = this;
+    tls_queue = index;
+
+    while (true) {
+        if (run_one(index)) {
+            continue;
+        }
+        auto spin_end = std::chrono::steady_clock::now() + kSpin;
+        while (queued_.load(std::memory_order_acquire) == 0 &&
+               std::chrono::steady_clock::now() < spin_end) {
+            std::this_thread::yield();
+        }
+        if (queued_.load(std::memory_order_acquire) > 0) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        wake_.wait(lock, [this] { return stopping_ || queued_.load(std::memory_order_acquire) > 0; });
+        if (stopping_ && queued_.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+void set_num_threads(int threads) {
+    if (threads != num_threads()) {
+        global_pool() = std::make_unique<ThreadPool>(threads);
+    }
+}
+
+int num_threads() {
+    return pool().threads();
+}
+
+ThreadPool& pool() {
+    return *global_pool();
+}
+
+} // namespace parallel
@@ -0,0 +1,71 @@
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+namespace trace {
+
+uint64_t now_ns() {
+    return to_ns(std::chrono::steady_clock::now());
+}
+
+int thread_id() {
+    static std::atomic<int> next{1};
+    thread_local int id = next.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+void Recorder::add(const char* name, const char* category, uint64_t begin_ns, uint64_t end_ns,
+                   std::string args, int tid) {
+    events_.push_back(Event{name, category, begin_ns, end_ns, tid, std::move(args)});
+}
+
+void Recorder::append(const Recorder& other) {
+    events_.insert(events_.end(), other.events_.begin(), other.events_.end());
+}
+
+static void append_escaped(std::string& out, const std::string& s) {
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+}
+
+std::string Recorder::to_json() const {
+    uint64_t origin = UINT64_MAX;
+    for (const Event& e : events_) {
+        origin = std::min(origin, e.begin_ns);
+    }
+
+    std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    char buf[128];
+    for (size_t i = 0; i < events_.size(); ++i) {
+        const Event& e = events_[i];
+        out += i ? ",{\"name\":\"" : "{\"name\":\"";
+        append_escaped(out, e.name);
+        out += "\",\"cat\":\"";
+        out += e.category;
+        // Complete events; ts / dur in microseconds
+        std::snprintf(buf, sizeof(buf), "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d",
+                      (e.begin_ns - origin) * 1e-3, (e.end_ns - e.begin_ns) * 1e-3, e.tid);
+        out += buf;
+        if (!e.args.empty()) {
+            out += ",\"args\":{";
+            out += e.args;
+            out += "}";
+        }
+        out += "}";
+    }
+    out += "]}";
+    return out;
+}
+
+} // namespace trace
@@ -0,0 +1,220 @@
+#include "unix_server.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+using namespace unix_protocol;
+
+// Reads exactly size bytes; false on EOF or error
+bool read_full(int fd, void* data, size_t size) {
+    auto* p = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        ssize_t n = ::read(fd, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool write_full(int fd, const void* data, size_t size) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t n = ::send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::string encode(const UnixSocketServer::Reply& reply) {
+    bool ok = reply.status == Ok;
+    size_t count = ok ? reply.predictions.size() : reply.error.size();
+    std::string frame(kResponseHeaderSize + (ok ? count * kPredictionSize : count), '\0');
+    auto* p = reinterpret_cast<uint8_t*>(&frame[0]);
+    put_u32(p, reply.status);
+    put_u32(p + 4, static_cast<uint32_t>(count));
+    p += kResponseHeaderSize;
+    if (ok) {
+        for (const auto& [class_id, score] : reply.predictions) {
+            uint32_t bits;
+            std::memcpy(&bits, &score, sizeof(bits));
+            put_u32(p, static_cast<uint32_t>(class_id));
+            put_u32(p + 4, bits);
+            p += kPredictionSize;
+        }
+    } else {
+        std::memcpy(p, reply.error.data(), count);
+    }
+    return frame;
+}
+
+UnixSocketServer::Reply failure(Status status, std::string message) {
+    UnixSocketServer::Reply reply;
+    reply.status = status;
+    reply.error = std::move(message);
+    return reply;
+}
+
+} // namespace
+
+UnixSocketServer::UnixSocketServer(const std::string& path, Handler handler)
+    : path_(path), handler_(std::move(handler)) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Invalid Unix socket path: " + path);
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    listener_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener_ < 0) {
+        throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    }
+    // A socket file left by a previous run would make bind fail
+    ::unlink(path.c_str());
+    if (::bind(listener_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(listener_, SOMAXCONN) < 0) {
+        std::string error = std::strerror(errno);
+        ::close(listener_);
+        throw std::runtime_error("Cannot listen on " + path + ": " + error);
+    }
+    acceptor_ = std::thread(&UnixSocketServer::accept_loop, this);
+}
+
+UnixSocketServer::~UnixSocketServer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_.store(true);
+    }
+    closed_.notify_all();
+    // shutdown wakes the threads blocked in accept / read
+    ::shutdown(listener_, SHUT_RDWR);
+    acceptor_.join();
+    std::vector<std::pair<int, std::thread>> connections;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connections.swap(connections_);
+    }
+    for (auto& [fd, thread] : connections) {
+        ::shutdown(fd, SHUT_RDWR);
+    }
+    for (auto& [fd, thread] : connections) {
+        thread.join();
+        ::close(fd);
+    }
+    ::close(listener_);
+    ::unlink(path_.c_str());
+}
+
+void UnixSocketServer::accept_loop() {
+    while (!stopping_.load()) {
+        // Leave clients over the cap in the backlog rather than spawning
+        // a thread per connection without bound
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            closed_.wait(lock, [this] { return stopping_.load() || active_ < kMaxConnections; });
+            if (stopping_.load()) {
+                return;
+            }
+        }
+        int fd = ::accept4(listener_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (stopping_.load()) {
+                return;
+            }
+            // Out of descriptors or memory: back off instead of spinning
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_.load()) {
+            ::close(fd);
+            return;
+        }
+        // Threads of closed connections are reaped here rather than detached,
+        // so the destructor can wait for every handler to return
+        for (auto it = connections_.begin(); it != connections_.end();) {
+            if (it->first < 0) {
+                it->second.join();
+                it = connections_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        connections_.emplace_back(fd, std::thread(&UnixSocketServer::serve, this, fd));
+        ++active_;
+    }
+}
+
+void UnixSocketServer::serve(int fd) {
+    std::string image;
+    uint8_t header[kRequestHeaderSize];
+    while (read_full(fd, header, 1)) {
+        auto received = std::chrono::steady_clock::now();
+        if (!read_full(fd, header + 1, sizeof(header) - 1)) {
+            break;
+        }
+        uint32_t size = get_u32(header);
+        int top_k = get_u16(header + 4);
+        // An oversized frame cannot be skipped safely: answer, then hang up
+        if (size > kMaxImageSize) {
+            std::string frame = encode(failure(BadRequest, "Image exceeds " +
+                                               std::to_string(kMaxImageSize) + " bytes"));
+            write_full(fd, frame.data(), frame.size());
+            break;
+        }
+        image.resize(size);
+        if (!read_full(fd, &image[0], size)) {
+            break;
+        }
+
+        Reply reply;
+        if (size == 0) {
+            reply = failure(BadRequest, "Empty image");
+        } else if (top_k < 1 || top_k > kMaxTopK) {
+            reply = failure(BadRequest, "top_k must be in [1, " + std::to_string(kMaxTopK) + "]");
+        } else {
+            try {
+                reply = handler_(image, top_k, received);
+            } catch (const std::exception& e) {
+                reply = failure(ServerError, e.what());
+            }
+        }
+        std::string frame = encode(reply);
+        if (!write_full(fd, frame.data(), frame.size())) {
+            break;
+        }
+    }
+
+    // Close and mark for reaping; once the destructor has taken the list,
+    // it closes the fd itself after joining
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& connection : connections_) {
+        if (connection.first == fd) {
+            ::close(fd);
+            connection.first = -1;
+        }
+    }
+    --active_;
+    closed_.notify_one();
+}
@@ -0,0 +1,186 @@
+// Corrupt-stream regression tests for the baseline JPEG decoder.
+// Every case must be rejected (or decoded) without reading or writing out
+// of bounds; build with -fsanitize=address to check the mutation sweep.
+#include "jpeg_decoder.h"
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+int failures = 0;
+
+void check(bool ok, const char* what) {
+    if (!ok) {
+        std::fprintf(stderr, "FAIL: %s\n", what);
+        ++failures;
+    }
+}
+
+void append(Bytes& out, std::initializer_list<int> bytes) {
+    for (int b : bytes) out.push_back(static_cast<uint8_t>(b));
+}
+
+Bytes dqt(int id, int length) {
+    Bytes s = {0xFF, 0xDB, static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length)};
+    s.push_back(static_cast<uint8_t>(id));
+    s.resize(2 + length, 1);
+    return s;
+}
+
+Bytes sof(int width, int height, int length = 11) {
+    Bytes s = {0xFF, 0xC0, static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length)};
+    append(s, {8, height >> 8, height & 0xFF, width >> 8, width & 0xFF, 1, 1, 0x11, 0});
+    s.resize(2 + length);
+    return s;
+}
+
+// `counts` are the code counts of lengths 1..16, symbols are all zero
+Bytes dht(int cls_id, const std::vector<int>& counts) {
+    int total = 0;
+    for (int c : counts) total += c;
+    int length = 2 + 17 + total;
+    Bytes s = {0xFF, 0xC4, static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length)};
+    s.push_back(static_cast<uint8_t>(cls_id));
+    for (int i = 0; i < 16; ++i) {
+        s.push_back(static_cast<uint8_t>(i < static_cast<int>(counts.size()) ? counts[i] : 0));
+    }
+    s.resize(s.size() + total, 0);
+    return s;
+}
+
+// 8x8 grayscale baseline JPEG of flat 128: one 1-bit code per table, DC
+// difference 0 then end-of-block, padded with ones. Each zero bit pair of
+// `scan` is one such block
+Bytes build(const Bytes& quant, const Bytes& frame, const Bytes& dc, const Bytes& ac,
+            const Bytes& scan = {0x3F}) {
+    Bytes out = {0xFF, 0xD8};
+    for (const Bytes* segment : {&quant, &frame, &dc, &ac}) {
+        for (uint8_t b : *segment) out.push_back(b);
+    }
+    append(out, {0xFF, 0xDA, 0x00, 0x08, 1, 1, 0x00, 0, 63, 0});
+    for (uint8_t b : scan) out.push_back(b);
+    append(out, {0xFF, 0xD9});
+    return out;
+}
+
+Bytes valid() {
+    return build(dqt(0, 67), sof(8, 8), dht(0x00, {1}), dht(0x10, {1}));
+}
+
+bool decodes(const Bytes& data, int scale = 1) {
+    jpeg::Image image;
+    return jpeg::decode(data.data(), data.size(), scale, image);
+}
+
+bool header_ok(const Bytes& data) {
+    jpeg::Header header;
+    return jpeg::read_header(data.data(), data.size(), header);
+}
+
+// An APP0 segment declaring `length`, inserted after SOI
+Bytes with_app0_length(int length) {
+    Bytes data = valid();
+    Bytes app = {0xFF, 0xE0, static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length)};
+    data.insert(data.begin() + 2, app.begin(), app.end());
+    return data;
+}
+
+void test_valid() {
+    Bytes data = valid();
+    jpeg::Header header;
+    check(jpeg::read_header(data.data(), data.size(), header) && header.width == 8 &&
+              header.height == 8 && header.supported,
+          "valid header");
+    for (int scale : {1, 2, 4, 8}) {
+        jpeg::Image image;
+        bool ok = jpeg::decode(data.data(), data.size(), scale, image);
+        int side = jpeg::scaled_size(8, scale);
+        check(ok && image.width == side && image.height == side, "valid decode size");
+        bool flat = ok;
+        for (uint8_t v : image.rgb) flat = flat && v == 128;
+        check(flat, "valid decode pixels");
+    }
+}
+
+void test_huffman() {
+    // 255 one-bit codes: overflowed the fast lookup table
+    check(!decodes(build(dqt(0, 67), sof(8, 8), dht(0x00, {255}), dht(0x10, {1}))),
+          "DHT with 255 codes of length 1");
+    check(!decodes(build(dqt(0, 67), sof(8, 8), dht(0x00, {1}), dht(0x10, {0, 5}))),
+          "DHT with 5 codes of length 2");
+    check(!decodes(build(dqt(0, 67), sof(8, 8), dht(0x00, {2, 1}), dht(0x10, {1}))),
+          "DHT over-full after a complete length 1");
+    check(!decodes(build(dqt(0, 67), sof(8, 8), dht(0x04, {1}), dht(0x10, {1}))),
+          "DHT table id 4");
+    check(!decodes(build(dqt(0, 67), sof(8, 8), dht(0x20, {1}), dht(0x10, {1}))),
+          "DHT class 2");
+}
+
+void test_quant() {
+    check(!decodes(build(dqt(4, 67), sof(8, 8), dht(0x00, {1}), dht(0x10, {1}))), "DQT table id 4");
+    check(!decodes(build(dqt(0x20, 67), sof(8, 8), dht(0x00, {1}), dht(0x10, {1}))),
+          "DQT precision 2");
+    check(!decodes(build(dqt(0, 12), sof(8, 8), dht(0x00, {1}), dht(0x10, {1}))), "truncated DQT");
+}
+
+void test_frame() {
+    check(!decodes(build(dqt(0, 67), sof(0, 8), dht(0x00, {1}), dht(0x10, {1}))), "SOF width 0");
+    check(!decodes(build(dqt(0, 67), sof(8, 8, 6), dht(0x00, {1}), dht(0x10, {1}))), "truncated SOF");
+    check(!header_ok(build(dqt(0, 67), sof(8, 8, 5), dht(0x00, {1}), dht(0x10, {1}))),
+          "header of truncated SOF");
+    // Entropy data for 4 of the declared blocks: used to decode the rest
+    // from zero padding
+    check(decodes(build(dqt(0, 67), sof(16, 16), dht(0x00, {1}), dht(0x10, {1}), {0x00})),
+          "entropy data for every block");
+    check(!decodes(build(dqt(0, 67), sof(64, 64), dht(0x00, {1}), dht(0x10, {1}), {0x00})),
+          "entropy data shorter than the frame");
+    check(!decodes(build(dqt(0, 67), sof(50000, 50000), dht(0x00, {1}), dht(0x10, {1}), {0x00}), 8),
+          "entropy data shorter than a huge frame");
+}
+
+void test_segment_lengths() {
+    for (int length : {0, 1}) {
+        check(!header_ok(with_app0_length(length)), "header with segment length < 2");
+        check(!decodes(with_app0_length(length)), "decode with segment length < 2");
+    }
+    check(!header_ok(with_app0_length(0xFFFF)), "header with segment past the end");
+    check(!decodes(with_app0_length(0xFFFF)), "decode with segment past the end");
+}
+
+// Every prefix and single-byte mutation must be handled without a crash
+void test_mutations() {
+    Bytes data = valid();
+    for (size_t size = 0; size < data.size(); ++size) {
+        Bytes prefix(data.begin(), data.begin() + size);
+        header_ok(prefix);
+        decodes(prefix);
+    }
+    for (size_t i = 0; i < data.size(); ++i) {
+        for (int value : {0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF}) {
+            Bytes mutated = data;
+            mutated[i] = static_cast<uint8_t>(value);
+            header_ok(mutated);
+            decodes(mutated, 1);
+            decodes(mutated, 8);
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    test_valid();
+    test_huffman();
+    test_quant();
+    test_frame();
+    test_segment_lengths();
+    test_mutations();
+    if (failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("jpeg_decoder_test: all checks passed\n");
+    return 0;
+}